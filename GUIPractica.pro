@@ -5,27 +5,10 @@
 # Compatible desde Qt5.3 en adelante
 #-------------------------------------------------
 
-QT       += core gui serialport widgets
-QT       += svg
-CONFIG   += qwt analogwidgets qmqtt ColorWidgets embeddeduma
-
 TARGET = GUIPanel
 TEMPLATE = app
 
+# Fuentes del panel, compartidas con herramientas/benchgui
+include(guipanel.pri)
 
-SOURCES += main.cpp\
-        guipanel.cpp \
-    crc.c \
-    serial2USBprotocol.c
-
-HEADERS  += guipanel.h \
-    crc.h \
-    serial2USBprotocol.h \
-    usb_messages_table.h
-
-FORMS    += guipanel.ui
-
-RESOURCES += \
-    images.qrc
-
-
+SOURCES += main.cpp
@@ -0,0 +1,319 @@
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "cajanegra.h"
+
+// Cada entrada: u8 tipo (TipoRegistro) | u16 longitud | u64 instante | datos, en el orden de la maquina (no sale
+// de la memoria; el fichero lo escribe GrabadorVuelo en su formato)
+static const size_t TAM_ENTRADA=1+2+8;
+
+CajaNegra::CajaNegra()
+    : memoria(new uint8_t[NUM_BLOQUES*TAM_BLOQUE]), actual(-1), secuencia(0),
+      historia(HISTORIA_POR_DEFECTO), posterior(POSTERIOR_POR_DEFECTO), directorio("."), nDescartadas(0),
+      hayFotograma(false), ultimoFotograma(0), ultimoInstante(0), disparado(false), instanteDisparo(0),
+      horaDisparo(0), pendientes(0), fin(false)
+{
+    for (int i=0;i<NUM_BLOQUES;i++)
+    {
+        bloques[i].estado.store(BLOQUE_LIBRE, std::memory_order_relaxed);
+        bloques[i].secuencia=0;
+        bloques[i].tFin=0;
+        bloques[i].uso=0;
+        bloques[i].datos=memoria+(size_t)i*TAM_BLOQUE;
+    }
+    escritor=std::thread(&CajaNegra::hilo,this);
+}
+
+CajaNegra::~CajaNegra()
+{
+    if (disparado) revisar(UINT64_MAX);
+    {
+        std::lock_guard<std::mutex> bloqueo(cerrojo);
+        fin=true;
+    }
+    aviso.notify_one();
+    escritor.join();
+    delete[] memoria;
+}
+
+void CajaNegra::anadirDatos(uint64_t instante, const uint8_t *datos, size_t n)
+{
+    revisar(instante);
+    while (n)
+    {
+        size_t trozo=std::min(n,(size_t)GrabadorVuelo::MAX_DATOS_REGISTRO);
+        anadir(REGISTRO_DATOS,instante,datos,trozo);
+        datos+=trozo;
+        n-=trozo;
+    }
+}
+
+void CajaNegra::anadirMuestra(uint64_t instante, uint8_t tipo, const uint8_t *parametro, size_t n)
+{
+    revisar(instante);
+    if (n>=(size_t)GrabadorVuelo::MAX_DATOS_REGISTRO) return;
+    uint8_t datos[GrabadorVuelo::MAX_DATOS_REGISTRO];
+    datos[0]=tipo;
+    if (n) memcpy(datos+1,parametro,n);
+    anadir(REGISTRO_MUESTRA,instante,datos,n+1);
+}
+
+void CajaNegra::anadirConsigna(uint64_t instante, float consigna)
+{
+    revisar(instante);
+    anadir(REGISTRO_CONSIGNA,instante,(const uint8_t *)&consigna,sizeof(consigna));
+}
+
+void CajaNegra::anadirFotograma(uint64_t instante, const EstadoInstrumentos &estado)
+{
+    revisar(instante);
+    anadir(REGISTRO_FOTOGRAMA,instante,(const uint8_t *)&estado,sizeof(estado));
+    hayFotograma=true;
+    ultimoFotograma=instante;
+}
+
+void CajaNegra::anadirSincronizacion(uint64_t instante, uint32_t secuencia, uint64_t t1)
+{
+    revisar(instante);
+    uint8_t datos[4+8];
+    memcpy(datos,&secuencia,4);
+    memcpy(datos+4,&t1,8);
+    anadir(REGISTRO_SINCRONIZACION,instante,datos,sizeof(datos));
+}
+
+void CajaNegra::anadir(uint8_t tipo, uint64_t instante, const uint8_t *datos, size_t n)
+{
+    // Los instantes de una grabacion no decrecen (ver LectorVuelo): una muestra, que lleva el de la TIVA, puede ser
+    // algo anterior a los bytes de los que sale, ya guardados con el de llegada
+    if (instante<ultimoInstante) instante=ultimoInstante;
+    ultimoInstante=instante;
+
+    size_t tam=TAM_ENTRADA+n;
+    if ((actual>=0)&&(bloques[actual].uso+tam>TAM_BLOQUE))
+    {
+        bloques[actual].estado.store(BLOQUE_LLENO,std::memory_order_release);
+        actual=-1;
+    }
+    if ((actual<0)&&!siguienteBloque())
+    {
+        nDescartadas++;
+        return;
+    }
+
+    Bloque &b=bloques[actual];
+    uint8_t *p=b.datos+b.uso;
+    uint16_t longitud=(uint16_t)n;
+    p[0]=tipo;
+    memcpy(p+1,&longitud,2);
+    memcpy(p+3,&instante,8);
+    if (n) memcpy(p+TAM_ENTRADA,datos,n);
+    b.uso+=tam;
+    if (instante>b.tFin) b.tFin=instante;
+}
+
+// Pasa a un bloque sin usar o, si no hay, al lleno mas antiguo. Los fijados se saltan: al liberarlos quedan fuera
+// del orden circular, por eso se busca por secuencia y no se toma el siguiente
+bool CajaNegra::siguienteBloque()
+{
+    int elegido=-1;
+    for (int i=0;i<NUM_BLOQUES;i++)
+    {
+        // El acquire empareja con el release del hilo de escritura al soltarlo: ya ha terminado de leerlo
+        int estado=bloques[i].estado.load(std::memory_order_acquire);
+        if (estado==BLOQUE_LIBRE)
+        {
+            elegido=i;
+            break;
+        }
+        if ((estado==BLOQUE_LLENO)&&((elegido<0)||(bloques[i].secuencia<bloques[elegido].secuencia))) elegido=i;
+    }
+    if (elegido<0) return false;
+
+    Bloque &b=bloques[elegido];
+    b.estado.store(BLOQUE_ESCRIBIENDO,std::memory_order_relaxed);
+    b.secuencia=++secuencia;
+    b.tFin=0;
+    b.uso=0;
+    actual=elegido;
+    return true;
+}
+
+bool CajaNegra::disparar(const std::string &motivo, uint64_t ahora)
+{
+    if (ocupada()) return false;
+    disparado=true;
+    instanteDisparo=ahora;
+    motivoDisparo=motivo;
+    horaDisparo=time(nullptr);
+    return true;
+}
+
+bool CajaNegra::ocupada() const
+{
+    if (disparado) return true;
+    std::lock_guard<std::mutex> bloqueo(cerrojo);
+    return pendientes>0;
+}
+
+void CajaNegra::revisar(uint64_t ahora)
+{
+    if (!disparado || (ahora<instanteDisparo) || (ahora-instanteDisparo<posterior)) return;
+    disparado=false;
+
+    // El bloque a medias se cierra: tambien hay que volcarlo
+    if (actual>=0)
+    {
+        bloques[actual].estado.store(BLOQUE_LLENO,std::memory_order_release);
+        actual=-1;
+    }
+
+    // Se fijan los bloques de la ventana, y un segundo mas para tener el fotograma del que parte
+    Trabajo trabajo;
+    trabajo.desde=(instanteDisparo>historia) ? instanteDisparo-historia : 0;
+    trabajo.motivo=motivoDisparo;
+    trabajo.hora=horaDisparo;
+    uint64_t limite=(trabajo.desde>GrabadorVuelo::PERIODO_FOTOGRAMAS)
+                    ? trabajo.desde-GrabadorVuelo::PERIODO_FOTOGRAMAS : 0;
+    for (int i=0;i<NUM_BLOQUES;i++)
+    {
+        if ((bloques[i].estado.load(std::memory_order_relaxed)!=BLOQUE_LLENO)||(bloques[i].tFin<limite)) continue;
+        bloques[i].estado.store(BLOQUE_FIJADO,std::memory_order_relaxed);
+        trabajo.bloques.push_back(i);
+    }
+    std::sort(trabajo.bloques.begin(),trabajo.bloques.end(),
+              [this](int a, int b) { return bloques[a].secuencia<bloques[b].secuencia; });
+
+    {
+        std::lock_guard<std::mutex> bloqueo(cerrojo);
+        trabajos.push_back(trabajo);
+        pendientes++;
+    }
+    aviso.notify_one();
+}
+
+bool CajaNegra::terminado(VolcadoCajaNegra &volcado)
+{
+    std::lock_guard<std::mutex> bloqueo(cerrojo);
+    if (resultados.empty()) return false;
+    volcado=resultados.front();
+    resultados.pop_front();
+    return true;
+}
+
+void CajaNegra::hilo()
+{
+    std::unique_lock<std::mutex> bloqueo(cerrojo);
+    while (true)
+    {
+        aviso.wait(bloqueo,[this]() { return fin || !trabajos.empty(); });
+        if (trabajos.empty()) return;
+        Trabajo trabajo=trabajos.front();
+        trabajos.pop_front();
+        bloqueo.unlock();
+
+        // Los bloques vuelven a estar llenos, con su secuencia: se reutilizan cuando les toque por antiguedad, y si
+        // hay otro disparo pronto su ventana tambien los tiene
+        VolcadoCajaNegra volcado=volcar(trabajo);
+        for (int b : trabajo.bloques) bloques[b].estado.store(BLOQUE_LLENO,std::memory_order_release);
+
+        bloqueo.lock();
+        resultados.push_back(volcado);
+        pendientes--;
+    }
+}
+
+// Recorre las entradas de un bloque
+template <class Funcion>
+static void recorrer(const uint8_t *p, size_t uso, Funcion f)
+{
+    size_t i=0;
+    while (i+TAM_ENTRADA<=uso)
+    {
+        uint16_t n;
+        uint64_t instante;
+        memcpy(&n,p+i+1,2);
+        memcpy(&instante,p+i+3,8);
+        f(p[i],instante,p+i+TAM_ENTRADA,(size_t)n);
+        i+=TAM_ENTRADA+n;
+    }
+}
+
+VolcadoCajaNegra CajaNegra::volcar(const Trabajo &trabajo)
+{
+    VolcadoCajaNegra volcado;
+    char hora[32];
+    struct tm t;
+    localtime_r(&trabajo.hora,&t);
+    strftime(hora,sizeof(hora),"%Y%m%d-%H%M%S",&t);
+    volcado.fichero=directorio+"/cajanegra-"+hora+"-"+trabajo.motivo+".gpv";
+    volcado.motivo=trabajo.motivo;
+    volcado.registros=0;
+    volcado.segundos=0;
+
+    GrabadorVuelo grabador;
+    volcado.ok=grabador.abrir(volcado.fichero);
+    if (!volcado.ok) return volcado;
+
+    // Se empieza en el ultimo fotograma anterior a la ventana, para que la reproduccion parta de un estado completo
+    uint64_t inicio=trabajo.desde;
+    uint64_t fotograma=0;
+    bool hayAnterior=false;
+    for (int b : trabajo.bloques)
+        recorrer(bloques[b].datos,bloques[b].uso,[&](uint8_t tipo, uint64_t instante, const uint8_t *, size_t) {
+            if ((tipo==REGISTRO_FOTOGRAMA)&&(instante<=trabajo.desde)&&(!hayAnterior||(instante>fotograma)))
+            {
+                fotograma=instante;
+                hayAnterior=true;
+            }
+        });
+    if (hayAnterior) inicio=fotograma;
+
+    uint64_t primero=UINT64_MAX, ultimo=0;
+    for (int b : trabajo.bloques)
+        recorrer(bloques[b].datos,bloques[b].uso,[&](uint8_t tipo, uint64_t instante, const uint8_t *datos, size_t n) {
+            if (instante<inicio) return;
+            switch (tipo)
+            {
+            case REGISTRO_DATOS:
+                grabador.anadirDatos(instante,datos,n);
+                break;
+            case REGISTRO_FOTOGRAMA:
+            {
+                EstadoInstrumentos estado;
+                memcpy(&estado,datos,sizeof(estado));
+                grabador.anadirFotograma(instante,estado);
+            }
+                break;
+            case REGISTRO_CONSIGNA:
+            {
+                float consigna;
+                memcpy(&consigna,datos,sizeof(consigna));
+                grabador.anadirConsigna(instante,consigna);
+            }
+                break;
+            case REGISTRO_MUESTRA:
+                grabador.anadirMuestra(instante,datos[0],datos+1,n-1);
+                break;
+            case REGISTRO_SINCRONIZACION:
+            {
+                uint32_t secuencia;
+                uint64_t t1;
+                memcpy(&secuencia,datos,4);
+                memcpy(&t1,datos+4,8);
+                grabador.anadirSincronizacion(instante,secuencia,t1);
+            }
+                break;
+            default:
+                return;
+            }
+            volcado.registros++;
+            primero=std::min(primero,instante);
+            ultimo=std::max(ultimo,instante);
+        });
+    volcado.ok=grabador.cerrar();
+
+    if (volcado.registros) volcado.segundos=(double)(ultimo-primero)/1e6;
+    return volcado;
+}
@@ -0,0 +1,133 @@
+// Caja negra: guarda siempre en memoria los ultimos segundos de vuelo (bytes recibidos por el puerto serie,
+// muestras ya decodificadas, fotogramas de los instrumentos, la consigna de la palanca y las peticiones de
+// sincronizacion del reloj) y, al dispararse (colision,
+// fin del combustible o a mano), los vuelca a disco como una grabacion normal (grabacion.h) que se puede
+// reproducir. Asi se tiene lo que paso antes del accidente con toda la resolucion sin grabar todos los vuelos.
+//
+// La memoria es fija y se reserva al crearla: NUM_BLOQUES bloques de TAM_BLOQUE bytes que se van llenando y
+// reutilizando del mas antiguo al mas reciente. Solo escribe un hilo (el del GUI) y no usa cerrojos: cada bloque
+// tiene un estado atomico, y al dispararse los bloques que caen en la ventana se fijan (no se sobrescriben) y se
+// pasan a un hilo que escribe el fichero y los suelta, otra vez llenos y en su sitio en el orden. Mientras tanto el
+// GUI sigue reutilizando los no fijados; si se le acaban (todos fijados), lo que llega se descarta y se cuenta.
+//
+// El volcado espera a tener tambien los segundos que siguen al disparo (ver revisar). Mientras hay uno pendiente o
+// escribiendose se ignoran los demas disparos: el primero ya cubre lo que ha pasado.
+// No depende de Qt.
+
+#ifndef CAJANEGRA_H
+#define CAJANEGRA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grabacion.h"
+
+// Resultado de un volcado ya terminado
+struct VolcadoCajaNegra {
+    std::string fichero;
+    std::string motivo;
+    bool ok;                   // false si no se ha podido escribir el fichero (o no entero)
+    uint64_t registros;        // Registros escritos
+    double segundos;           // Tiempo de vuelo que cubre
+};
+
+class CajaNegra
+{
+public:
+    static const size_t TAM_BLOQUE=64*1024;
+    static const int NUM_BLOQUES=64;                     // 4 MB: unos 3 minutos a 115200 baudios
+    static const uint64_t HISTORIA_POR_DEFECTO=30000000;  // us antes del disparo
+    static const uint64_t POSTERIOR_POR_DEFECTO=2000000;  // us despues del disparo
+
+    CajaNegra();
+    ~CajaNegra();      // Vuelca el disparo pendiente, si lo hay, y espera a que se escriba
+
+    // Directorio de los volcados (por defecto el actual)
+    void setDirectorio(const std::string &dir) { directorio=dir; }
+    const std::string &getDirectorio() const { return directorio; }
+    void setVentana(uint64_t historiaUs, uint64_t posteriorUs) { historia=historiaUs; posterior=posteriorUs; }
+
+    // Lo que se guarda. Solo desde un hilo
+    void anadirDatos(uint64_t instante, const uint8_t *datos, size_t n);
+    void anadirMuestra(uint64_t instante, uint8_t tipo, const uint8_t *parametro, size_t n);
+    void anadirConsigna(uint64_t instante, float consigna);
+    void anadirFotograma(uint64_t instante, const EstadoInstrumentos &estado);
+    void anadirSincronizacion(uint64_t instante, uint32_t secuencia, uint64_t t1);
+    bool tocaFotograma(uint64_t instante) const
+    { return !hayFotograma || (instante-ultimoFotograma>=GrabadorVuelo::PERIODO_FOTOGRAMAS); }
+
+    // Pide un volcado de lo anterior a 'ahora'. 'motivo' va en el nombre del fichero. Devuelve false si se ignora
+    // porque ya hay uno en curso
+    bool disparar(const std::string &motivo, uint64_t ahora);
+    bool ocupada() const;
+
+    // Hay que llamarla periodicamente (tambien la llaman los anadir*): pasado el tiempo posterior al disparo, fija
+    // los bloques y se los pasa al hilo de escritura
+    void revisar(uint64_t ahora);
+
+    // Saca el resultado del siguiente volcado terminado. Devuelve false si no hay ninguno
+    bool terminado(VolcadoCajaNegra &volcado);
+
+    uint64_t descartadas() const { return nDescartadas; }
+
+private:
+    enum EstadoBloque { BLOQUE_LIBRE, BLOQUE_ESCRIBIENDO, BLOQUE_LLENO, BLOQUE_FIJADO };
+
+    struct Bloque {
+        std::atomic<int> estado;   // EstadoBloque
+        uint64_t secuencia;        // Orden de llenado
+        uint64_t tFin;             // Instante mas reciente de las entradas
+        size_t uso;
+        uint8_t *datos;
+    };
+
+    struct Trabajo {
+        std::vector<int> bloques;  // Por orden de llenado
+        std::string motivo;
+        uint64_t desde;            // Primer instante que se quiere
+        time_t hora;               // Hora del disparo, para el nombre del fichero
+    };
+
+    void anadir(uint8_t tipo, uint64_t instante, const uint8_t *datos, size_t n);
+    bool siguienteBloque();
+    void hilo();
+    VolcadoCajaNegra volcar(const Trabajo &trabajo);
+
+    uint8_t *memoria;
+    Bloque bloques[NUM_BLOQUES];
+    int actual;                    // Bloque que se esta llenando (-1 si ninguno)
+    uint64_t secuencia;
+    uint64_t historia;
+    uint64_t posterior;
+    std::string directorio;
+    uint64_t nDescartadas;
+    bool hayFotograma;
+    uint64_t ultimoFotograma;
+    uint64_t ultimoInstante;
+
+    // Disparo esperando a los datos posteriores
+    bool disparado;
+    uint64_t instanteDisparo;
+    std::string motivoDisparo;
+    time_t horaDisparo;
+
+    // Comunicacion con el hilo de escritura
+    mutable std::mutex cerrojo;
+    std::condition_variable aviso;
+    std::deque<Trabajo> trabajos;
+    std::deque<VolcadoCajaNegra> resultados;
+    int pendientes;                // Volcados en cola o escribiendose
+    bool fin;
+    std::thread escritor;
+};
+
+#endif // CAJANEGRA_H
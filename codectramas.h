@@ -0,0 +1,377 @@
+// Codec de tramas generico: stuffing, checksum y delimitadores del protocolo serie, parametrizados en tiempo de
+// compilacion por una clase de rasgos ("traits") del protocolo. Cada variante (otra placa con otros caracteres
+// especiales, otro CRC u otro tamaño maximo) es solo una estructura de rasgos; el compilador genera para ella un
+// codec especializado, con las constantes y el checksum en linea, sin punteros a funcion ni ramas por protocolo.
+//
+// Un protocolo se describe asi:
+//
+//   struct ProtocoloX {
+//       static constexpr uint8_t INICIO=...;          // Caracter de inicio de trama
+//       static constexpr uint8_t FIN=...;             // Caracter de fin de trama
+//       static constexpr uint8_t ESCAPE=...;          // Precede a los bytes especiales dentro de la trama
+//       typedef EscapeXor<0x20> Escape;               // Como se codifica el byte que sigue al ESCAPE
+//       typedef CrcMsb<uint16_t,0x1021,0xFFFF> Checksum;   // Checksum (tipo = anchura; se envia little endian)
+//       static constexpr int32_t MAX_TRAMA=...;       // Tamaño maximo de la trama, delimitadores incluidos
+//   };
+//
+// Formato: INICIO | stuffing(tipo | parametro | checksum) | FIN, con el checksum calculado sobre tipo y parametro.
+// La API en C de serial2USBprotocol.h es la instanciacion para la TIVA (ProtocoloTiva).
+
+#ifndef CODECTRAMAS_H
+#define CODECTRAMAS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <utility>
+
+extern "C" {
+#include "serial2USBprotocol.h"    // Codigos de error (PROT_ERROR_*) y constantes del protocolo de la TIVA
+}
+
+namespace codec {
+
+// ---------------------------------------------------------------------------------------------------------------
+// Checksums. Cada uno define 'tipo' (su anchura), calcular(datos, n) y calcularLote(datos, n, cuantos, resultado),
+// que calcula el de 'cuantos' bloques independientes (datos[i], de n[i] bytes) y lo deja en resultado[i]
+
+// Tabla de un CRC sin reflejar, calculada al compilar
+template <typename T>
+struct TablaCrc
+{
+    T v[256];
+};
+
+template <typename T, T POLINOMIO>
+constexpr TablaCrc<T> generar_tabla_crc()
+{
+    constexpr int BITS=8*(int)sizeof(T);
+    TablaCrc<T> t={};
+    for (int i=0;i<256;i++)
+    {
+        T crc=(T)((T)i<<(BITS-8));
+        for (int b=0;b<8;b++)
+            crc=(T)((crc>>(BITS-1)) ? (T)((T)(crc<<1)^POLINOMIO) : (T)(crc<<1));
+        t.v[i]=crc;
+    }
+    return t;
+}
+
+// Tabla para avanzar dos bytes de una vez: la de un byte seguido de un cero (el CRC es lineal, asi que dos bytes
+// son la suma de cada uno por separado)
+template <typename T>
+constexpr TablaCrc<T> generar_tabla_crc_doble(const TablaCrc<T> &simple)
+{
+    constexpr int BITS=8*(int)sizeof(T);
+    TablaCrc<T> t={};
+    for (int i=0;i<256;i++)
+    {
+        T v=simple.v[i];
+        t.v[i]=(T)((BITS>8 ? (T)(v<<8) : (T)0)^simple.v[(uint8_t)(v>>(BITS-8))]);
+    }
+    return t;
+}
+
+// CRC sin reflejar (el bit mas significativo primero), de 8, 16 o 32 bits
+template <typename T, T POLINOMIO, T INICIAL, T XOR_FINAL=0>
+struct CrcMsb
+{
+    typedef T tipo;
+    static constexpr int BITS=8*(int)sizeof(T);
+    static constexpr TablaCrc<T> tabla=generar_tabla_crc<T,POLINOMIO>();
+    static constexpr TablaCrc<T> tablaDoble=generar_tabla_crc_doble(tabla);
+
+    // Bloques que se calculan a la vez en calcularLote
+    static constexpr size_t CARRILES=4;
+
+    static constexpr T paso(T crc, uint8_t b)
+    {
+        return (T)((BITS>8 ? (T)(crc<<8) : (T)0)^tabla.v[(uint8_t)((crc>>(BITS-8))^b)]);
+    }
+
+    // Dos bytes: dos consultas independientes en lugar de una detras de otra
+    static constexpr T pasoDoble(T crc, const uint8_t *b)
+    {
+        if constexpr (BITS==8)
+            return (T)(tablaDoble.v[(uint8_t)(crc^b[0])]^tabla.v[b[1]]);
+        else
+        {
+            T x=(T)(crc^(T)((T)((b[0]<<8)|b[1])<<(BITS-16)));
+            T desplazado=0;
+            if constexpr (BITS>16) desplazado=(T)(crc<<16);
+            return (T)(desplazado^tablaDoble.v[(uint8_t)(x>>(BITS-8))]^tabla.v[(uint8_t)(x>>(BITS-16))]);
+        }
+    }
+
+    static constexpr T calcular(const uint8_t *datos, size_t n)
+    {
+        T crc=INICIAL;
+        for (size_t i=0;i<n;i++) crc=paso(crc,datos[i]);
+        return (T)(crc^XOR_FINAL);
+    }
+
+    // Cada paso depende del CRC del anterior, asi que un bloque solo avanza al ritmo de la latencia de la consulta a
+    // la tabla. Aqui se avanzan CARRILES bloques a la vez, dos bytes por paso: son cadenas independientes y sus
+    // consultas se solapan. Conviene que los bloques de cada grupo de CARRILES tengan tamaños parecidos: lo que
+    // uno tiene de mas que los otros se calcula ya sin intercalar
+    static void calcularLote(const uint8_t *const *datos, const size_t *n, size_t cuantos, T *resultado)
+    {
+        size_t base=0;
+        for (;base+CARRILES<=cuantos;base+=CARRILES)
+        {
+            const uint8_t *const *d=datos+base;
+            const size_t *m=n+base;
+            T crc[CARRILES];
+            size_t comun=m[0];
+            for (size_t c=0;c<CARRILES;c++)
+            {
+                crc[c]=INICIAL;
+                if (m[c]<comun) comun=m[c];
+            }
+
+            size_t i=0;
+            for (;i+2<=comun;i+=2) pasoCarriles(crc,d,i,std::make_index_sequence<CARRILES>());
+            for (size_t c=0;c<CARRILES;c++) resultado[base+c]=terminar(crc[c],d[c],i,m[c]);
+        }
+        for (;base<cuantos;base++) resultado[base]=terminar(INICIAL,datos[base],0,n[base]);
+    }
+
+private:
+    // Un paso en todos los carriles, desenrollado para que los CRC vayan en registros
+    template <size_t... C>
+    static void pasoCarriles(T *crc, const uint8_t *const *d, size_t i, std::index_sequence<C...>)
+    {
+        ((crc[C]=pasoDoble(crc[C],d[C]+i)),...);
+    }
+
+    // Lo que queda de un bloque a partir del byte 'i'
+    static T terminar(T crc, const uint8_t *datos, size_t i, size_t n)
+    {
+        for (;i+2<=n;i+=2) crc=pasoDoble(crc,datos+i);
+        if (i<n) crc=paso(crc,datos[i]);
+        return (T)(crc^XOR_FINAL);
+    }
+};
+
+// Suma de los bytes en complemento a uno (checksums sencillos de algunas placas)
+template <typename T>
+struct SumaComplemento
+{
+    typedef T tipo;
+
+    static constexpr T calcular(const uint8_t *datos, size_t n)
+    {
+        T suma=0;
+        for (size_t i=0;i<n;i++) suma=(T)(suma+datos[i]);
+        return (T)~suma;
+    }
+
+    static void calcularLote(const uint8_t *const *datos, const size_t *n, size_t cuantos, T *resultado)
+    {
+        for (size_t i=0;i<cuantos;i++) resultado[i]=calcular(datos[i],n[i]);
+    }
+};
+
+typedef CrcMsb<uint16_t, 0x1021, 0xFFFF> Crc16Ccitt;          // CRC-16/CCITT-FALSE (el de la TIVA)
+typedef CrcMsb<uint8_t, 0x07, 0x00> Crc8;                     // CRC-8 (SMBus)
+typedef CrcMsb<uint32_t, 0x04C11DB7, 0xFFFFFFFF> Crc32Mpeg2;  // CRC-32/MPEG-2
+
+// ---------------------------------------------------------------------------------------------------------------
+// Esquemas de escape: como se transmite un byte especial despues del caracter de ESCAPE
+
+template <uint8_t MASCARA>
+struct EscapeXor
+{
+    static constexpr uint8_t codificar(uint8_t b) { return (uint8_t)(b^MASCARA); }
+    static constexpr uint8_t decodificar(uint8_t b) { return (uint8_t)(b^MASCARA); }
+};
+
+// ---------------------------------------------------------------------------------------------------------------
+// Codec
+
+template <class Protocolo>
+class CodecTramas
+{
+public:
+    typedef typename Protocolo::Checksum Checksum;
+    typedef typename Checksum::tipo TipoChecksum;
+    typedef typename Protocolo::Escape Escape;
+
+    static constexpr uint8_t INICIO=Protocolo::INICIO;
+    static constexpr uint8_t FIN=Protocolo::FIN;
+    static constexpr uint8_t ESCAPE=Protocolo::ESCAPE;
+    static constexpr int32_t TAM_CHECKSUM=(int32_t)sizeof(TipoChecksum);
+    static constexpr int32_t TAM_MINIMO=1+1+TAM_CHECKSUM+1;   // Inicio, tipo, checksum y fin
+    static constexpr int32_t MAX_TRAMA=Protocolo::MAX_TRAMA;
+
+    static_assert((INICIO!=FIN)&&(INICIO!=ESCAPE)&&(FIN!=ESCAPE), "Los caracteres especiales deben ser distintos");
+    static_assert(MAX_TRAMA>=TAM_MINIMO, "Tamaño maximo de trama insuficiente");
+
+    static constexpr bool especial(uint8_t b) { return (b==INICIO)||(b==FIN)||(b==ESCAPE); }
+
+    static TipoChecksum checksum(const uint8_t *datos, size_t n) { return Checksum::calcular(datos,n); }
+
+    // Crea la trama completa (con delimitadores) en 'trama', de como mucho 'max' bytes.
+    // Devuelve su tamaño o PROT_ERROR_MESSAGE_TOO_LONG / PROT_ERROR_STUFFED_FRAME_TOO_LONG
+    static int32_t crear(uint8_t *trama, uint8_t tipo, const void *parametro, int32_t tamParametro, int32_t max);
+
+    // Quita el stuffing de una trama recibida (sin delimitadores) en su sitio y comprueba el checksum.
+    // Devuelve el tamaño resultante (tipo, parametro y checksum) o PROT_ERROR_BAD_CHECKSUM
+    static int32_t desempaquetar(uint8_t *trama, int32_t tam);
+
+    // Lo mismo en dos pasos, para comprobar muchas tramas a la vez: quitarStuffing no mira el checksum (devuelve
+    // el tamaño, o PROT_ERROR_BAD_CHECKSUM si la trama acaba en un escape), y verificarLote comprueba el de
+    // 'cuantas' tramas ya sin stuffing con Checksum::calcularLote. Deja un bit por trama en 'correctas' (el de la
+    // trama i es el i%64 de la palabra i/64), a 1 si el checksum es correcto, y devuelve cuantas lo son
+    static int32_t quitarStuffing(uint8_t *trama, int32_t tam);
+    static size_t verificarLote(const uint8_t *const *tramas, const int32_t *tams, size_t cuantas, uint64_t *correctas);
+
+private:
+    static TipoChecksum checksumRecibido(const uint8_t *trama, int32_t tamDatos)
+    {
+        TipoChecksum recibido=0;
+        for (int32_t i=TAM_CHECKSUM-1;i>=0;i--) recibido=(TipoChecksum)((recibido<<8)|trama[tamDatos+i]);
+        return recibido;
+    }
+};
+
+template <class Protocolo>
+int32_t CodecTramas<Protocolo>::crear(uint8_t *trama, uint8_t tipo, const void *parametro, int32_t tamParametro,
+                                      int32_t max)
+{
+    static_assert(!especial(Escape::codificar(INICIO))&&!especial(Escape::codificar(FIN))&&
+                  !especial(Escape::codificar(ESCAPE)), "El escape no puede producir caracteres especiales");
+
+    if (TAM_MINIMO+tamParametro>=max) return PROT_ERROR_MESSAGE_TOO_LONG;
+
+    // Tipo, parametro y checksum (little endian) sin stuffing, a continuacion del caracter de inicio
+    uint8_t *cuerpo=trama+1;
+    cuerpo[0]=tipo;
+    if (tamParametro>0) memcpy(cuerpo+1,parametro,(size_t)tamParametro);
+    int32_t tam=1+tamParametro;
+    TipoChecksum suma=checksum(cuerpo,(size_t)tam);
+    for (int32_t i=0;i<TAM_CHECKSUM;i++) cuerpo[tam++]=(uint8_t)(suma>>(8*i));
+
+    // Stuffing en el propio buffer, de atras hacia delante, una vez conocido el tamaño final
+    int32_t especiales=0;
+    for (int32_t i=0;i<tam;i++) especiales+=especial(cuerpo[i]);
+    int32_t tamFinal=tam+especiales;
+    if (tamFinal>max-2) return PROT_ERROR_STUFFED_FRAME_TOO_LONG;
+    for (int32_t i=tam-1,j=tamFinal-1;especiales>0;i--)
+    {
+        uint8_t b=cuerpo[i];
+        if (especial(b))
+        {
+            cuerpo[j--]=Escape::codificar(b);
+            cuerpo[j--]=ESCAPE;
+            especiales--;
+        }
+        else cuerpo[j--]=b;
+    }
+
+    trama[0]=INICIO;
+    trama[1+tamFinal]=FIN;
+    return tamFinal+2;
+}
+
+template <class Protocolo>
+int32_t CodecTramas<Protocolo>::desempaquetar(uint8_t *trama, int32_t tam)
+{
+    int32_t j=quitarStuffing(trama,tam);
+    if (j<TAM_CHECKSUM) return PROT_ERROR_BAD_CHECKSUM;
+
+    int32_t tamDatos=j-TAM_CHECKSUM;
+    if (checksumRecibido(trama,tamDatos)!=checksum(trama,(size_t)tamDatos)) return PROT_ERROR_BAD_CHECKSUM;
+    return j;
+}
+
+template <class Protocolo>
+int32_t CodecTramas<Protocolo>::quitarStuffing(uint8_t *trama, int32_t tam)
+{
+    int32_t j=0;
+    for (int32_t i=0;i<tam;i++)
+    {
+        uint8_t b=trama[i];
+        if (b==ESCAPE)
+        {
+            if (++i>=tam) return PROT_ERROR_BAD_CHECKSUM;   // Escape sin byte detras
+            if (trama[i]==ESCAPE) continue;                 // Secuencia de escape: se ignora
+            b=Escape::decodificar(trama[i]);
+        }
+        trama[j++]=b;
+    }
+    return j;
+}
+
+template <class Protocolo>
+size_t CodecTramas<Protocolo>::verificarLote(const uint8_t *const *tramas, const int32_t *tams, size_t cuantas,
+                                             uint64_t *correctas)
+{
+    // De 64 en 64: una palabra del mapa de bits por grupo, y los datos del grupo en la pila. Dentro del grupo se
+    // ordenan por tamaño (por cubetas; son como mucho MAX_TRAMA) para que los carriles de calcularLote vayan parejos
+    size_t total=0;
+    for (size_t base=0;base<cuantas;base+=64)
+    {
+        size_t n=(cuantas-base<64) ? cuantas-base : 64;
+        size_t tamDatos[64];
+        uint8_t cubeta[MAX_TRAMA+2]={};
+        for (size_t i=0;i<n;i++)
+        {
+            int32_t t=tams[base+i]-TAM_CHECKSUM;
+            tamDatos[i]=(t>0) ? (size_t)t : 0;
+            cubeta[((tamDatos[i]<(size_t)MAX_TRAMA) ? tamDatos[i] : (size_t)MAX_TRAMA)+1]++;
+        }
+        for (int32_t c=1;c<MAX_TRAMA+2;c++) cubeta[c]=(uint8_t)(cubeta[c]+cubeta[c-1]);
+
+        uint8_t orden[64];
+        const uint8_t *datos[64];
+        size_t tamOrdenado[64];
+        TipoChecksum calculado[64];
+        for (size_t i=0;i<n;i++)
+            orden[cubeta[(tamDatos[i]<(size_t)MAX_TRAMA) ? tamDatos[i] : (size_t)MAX_TRAMA]++]=(uint8_t)i;
+        for (size_t k=0;k<n;k++)
+        {
+            datos[k]=tramas[base+orden[k]];
+            tamOrdenado[k]=tamDatos[orden[k]];
+        }
+        Checksum::calcularLote(datos,tamOrdenado,n,calculado);
+
+        uint64_t bits=0;
+        for (size_t k=0;k<n;k++)
+        {
+            size_t i=orden[k];
+            bool ok=(tams[base+i]>=TAM_CHECKSUM)&&
+                    (checksumRecibido(tramas[base+i],(int32_t)tamDatos[i])==calculado[k]);
+            bits|=(uint64_t)ok<<i;
+            total+=ok;
+        }
+        correctas[base/64]=bits;
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Protocolo de la TIVA, a partir de las constantes de serial2USBprotocol.h
+
+struct ProtocoloTiva
+{
+    static constexpr uint8_t INICIO=START_FRAME_CHAR;
+    static constexpr uint8_t FIN=STOP_FRAME_CHAR;
+    static constexpr uint8_t ESCAPE=ESCAPE_CHAR;
+    typedef EscapeXor<STUFFING_MASK> Escape;
+    typedef Crc16Ccitt Checksum;
+    static constexpr int32_t MAX_TRAMA=MAX_FRAME_SIZE;
+};
+
+typedef CodecTramas<ProtocoloTiva> CodecTiva;
+
+static_assert(CodecTiva::TAM_CHECKSUM==CHECKSUM_SIZE, "El checksum de la TIVA no coincide con CHEKSUM_TYPE");
+
+// Valor de comprobacion del CRC-16/CCITT-FALSE ("123456789")
+constexpr uint8_t PRUEBA_CRC[]={'1','2','3','4','5','6','7','8','9'};
+static_assert(Crc16Ccitt::calcular(PRUEBA_CRC,sizeof(PRUEBA_CRC))==0x29B1, "Tabla del CRC-16 incorrecta");
+
+} // namespace codec
+
+#endif // CODECTRAMAS_H
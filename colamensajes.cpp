@@ -0,0 +1,74 @@
+#include "colamensajes.h"
+
+ColaMensajes::ColaMensajes(size_t umbralRetraso)
+    : siguienteOrden(0), umbral(umbralRetraso)
+{
+    memset(&contadores,0,sizeof(contadores));
+    for (int p=0;p<NUM_PRIORIDADES;p++) colas[p].reserve(32);
+}
+
+PrioridadMensaje ColaMensajes::prioridad(const MensajeDecodificado &mensaje)
+{
+    if (mensaje.error) return PRIORIDAD_EVENTO;
+
+    switch (mensaje.tipo)
+    {
+    case MENSAJE_COLISION:
+        return PRIORIDAD_CRITICA;
+    case MENSAJE_COMBUSTIBLE:
+        // El combustible agotado es critico; el resto de muestras son telemetria normal
+        if (mensaje.parametroValido && (mensaje.vista<VistaCombustible>().combustible()<=0))
+            return PRIORIDAD_CRITICA;
+        return PRIORIDAD_PERIODICA;
+    case MENSAJE_POTENCIOMETRO:
+    case MENSAJE_VELOCIDAD:
+    case MENSAJE_RELOJ:
+    case MENSAJE_ALTURA:
+        return PRIORIDAD_PERIODICA;
+    default:
+        return PRIORIDAD_EVENTO;
+    }
+}
+
+void ColaMensajes::encolar(const MensajeDecodificado &mensaje)
+{
+    std::vector<Entrada> &cola=colas[prioridad(mensaje)];
+    cola.resize(cola.size()+1);
+    Entrada &e=cola.back();
+
+    e.orden=siguienteOrden++;
+    e.error=mensaje.error;
+    e.tipo=mensaje.error ? 0 : mensaje.tipo;
+    e.parametroValido=!mensaje.error && mensaje.parametroValido;
+    e.tamParametro=0;
+    e.tieneMarca=!mensaje.error && mensaje.tieneMarca;
+    e.marcaDispositivo=mensaje.marcaDispositivo;
+    e.instante=mensaje.instante;
+    e.descartado=false;
+    if (e.parametroValido && (mensaje.tamParametro>0))
+    {
+        e.tamParametro=(mensaje.tamParametro<MAX_PARAMETRO) ? mensaje.tamParametro : MAX_PARAMETRO;
+        memcpy(e.parametro,mensaje.parametro,(size_t)e.tamParametro);
+    }
+}
+
+size_t ColaMensajes::pendientes() const
+{
+    size_t n=0;
+    for (int p=0;p<NUM_PRIORIDADES;p++) n+=colas[p].size();
+    return n;
+}
+
+MensajeDecodificado ColaMensajes::mensajeDe(const Entrada &e)
+{
+    MensajeDecodificado m;
+    m.error=e.error;
+    m.tipo=e.tipo;
+    m.parametroValido=e.parametroValido;
+    m.tamParametro=e.tamParametro;
+    m.parametro=e.parametro;
+    m.tieneMarca=e.tieneMarca;
+    m.marcaDispositivo=e.marcaDispositivo;
+    m.instante=e.instante;
+    return m;
+}
@@ -0,0 +1,148 @@
+// Cola de mensajes decodificados con prioridades. Todo lo que llega en una lectura del puerto serie se decodifica
+// primero a esta cola y despues se despacha por clases: los eventos criticos (colision, fin de combustible) antes
+// que nada, luego el resto de eventos y por ultimo la telemetria periodica. Asi un evento critico llega a la
+// pantalla en cuanto se lee, por muchas tramas de potenciometros que tenga delante.
+//
+// Cuando la cola va retrasada (mas mensajes periodicos que el umbral) cada tipo periodico se reduce a su ultima
+// muestra, y los periodicos anteriores a un evento critico ya despachado se descartan siempre, porque describen
+// un estado que el evento ya ha dejado atras. Los descartes se cuentan en las estadisticas.
+// Lo descartado no se despacha: la cola es solo para lo que se muestra. Lo que tenga que ver todas las muestras
+// (historiales, MQTT, memoria compartida...) hay que hacerlo al encolar (ver GUIPanel::registrarMensaje).
+// Como el decodificador, no depende de Qt.
+
+#ifndef COLAMENSAJES_H
+#define COLAMENSAJES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include "telemetria.h"
+
+enum PrioridadMensaje {
+    PRIORIDAD_CRITICA,         // Colision, combustible agotado
+    PRIORIDAD_EVENTO,          // Radio, ping, control de flujo, tramas erroneas...
+    PRIORIDAD_PERIODICA,       // Potenciometros, altura, combustible, reloj, velocidad
+    NUM_PRIORIDADES
+};
+
+struct EstadisticasCola {
+    uint64_t despachados[NUM_PRIORIDADES];
+    uint64_t adelantados;      // Mensajes criticos despachados antes que otros que habian llegado antes
+    uint64_t colapsados;       // Periodicos sustituidos por otro posterior del mismo tipo
+    uint64_t obsoletos;        // Periodicos anteriores a un evento critico
+};
+
+class ColaMensajes
+{
+public:
+    explicit ColaMensajes(size_t umbralRetraso=8);
+
+    void setUmbralRetraso(size_t mensajes) { umbral=mensajes; }
+
+    static PrioridadMensaje prioridad(const MensajeDecodificado &mensaje);
+
+    // Copia el mensaje (el parametro incluido, ya que el del decodificador solo es valido durante la llamada)
+    void encolar(const MensajeDecodificado &mensaje);
+
+    // Despacha todos los mensajes pendientes por orden de prioridad y vacia la cola. Devuelve los despachados
+    template <class Funcion>
+    size_t despachar(Funcion &&procesar);
+
+    size_t pendientes() const;
+    const EstadisticasCola &estadisticas() const { return contadores; }
+
+private:
+    static const int MAX_PARAMETRO=MAX_FRAME_SIZE;
+
+    struct Entrada {
+        uint64_t orden;        // Orden de llegada
+        int32_t error;
+        uint8_t tipo;
+        bool parametroValido;
+        int32_t tamParametro;
+        bool tieneMarca;
+        uint32_t marcaDispositivo;
+        int64_t instante;
+        bool descartado;       // Colapsado u obsoleto (solo durante despachar)
+        uint8_t parametro[MAX_PARAMETRO];
+    };
+
+    static MensajeDecodificado mensajeDe(const Entrada &e);
+
+    std::vector<Entrada> colas[NUM_PRIORIDADES];
+    uint64_t siguienteOrden;
+    size_t umbral;
+    EstadisticasCola contadores;
+};
+
+template <class Funcion>
+size_t ColaMensajes::despachar(Funcion &&procesar)
+{
+    size_t despachados=0;
+    uint64_t ordenCritico=0;   // Orden de llegada (+1) del ultimo evento critico despachado
+
+    // 1. Eventos criticos
+    std::vector<Entrada> &criticos=colas[PRIORIDAD_CRITICA];
+    for (size_t i=0;i<criticos.size();i++)
+    {
+        const Entrada &e=criticos[i];
+        bool adelantado=(!colas[PRIORIDAD_EVENTO].empty()&&(colas[PRIORIDAD_EVENTO].front().orden<e.orden))||
+                        (!colas[PRIORIDAD_PERIODICA].empty()&&(colas[PRIORIDAD_PERIODICA].front().orden<e.orden));
+        if (adelantado) contadores.adelantados++;
+        ordenCritico=e.orden+1;
+        procesar(mensajeDe(e));
+        despachados++;
+    }
+    contadores.despachados[PRIORIDAD_CRITICA]+=criticos.size();
+    criticos.clear();
+
+    // 2. Resto de eventos, en orden de llegada
+    std::vector<Entrada> &eventos=colas[PRIORIDAD_EVENTO];
+    for (size_t i=0;i<eventos.size();i++)
+    {
+        procesar(mensajeDe(eventos[i]));
+        despachados++;
+    }
+    contadores.despachados[PRIORIDAD_EVENTO]+=eventos.size();
+    eventos.clear();
+
+    // 3. Telemetria periodica. Si va retrasada, de cada tipo solo se despacha la ultima muestra: se recorre la
+    // cola hacia atras marcando los tipos ya vistos
+    std::vector<Entrada> &periodicos=colas[PRIORIDAD_PERIODICA];
+    bool retrasada=(periodicos.size()>umbral);
+    bool visto[256];
+    memset(visto,0,sizeof(visto));
+    size_t quedan=0;
+    for (size_t i=periodicos.size();i-->0;)
+    {
+        Entrada &e=periodicos[i];
+        e.descartado=true;
+        if (e.orden<ordenCritico)
+        {
+            contadores.obsoletos++;
+            continue;
+        }
+        if (retrasada&&visto[e.tipo])
+        {
+            contadores.colapsados++;
+            continue;
+        }
+        e.descartado=false;
+        visto[e.tipo]=true;
+        quedan++;
+    }
+    for (size_t i=0;i<periodicos.size();i++)
+    {
+        if (periodicos[i].descartado) continue;
+        procesar(mensajeDe(periodicos[i]));
+        despachados++;
+    }
+    contadores.despachados[PRIORIDAD_PERIODICA]+=quedan;
+    periodicos.clear();
+
+    return despachados;
+}
+
+#endif // COLAMENSAJES_H
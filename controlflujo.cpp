@@ -0,0 +1,72 @@
+#include "controlflujo.h"
+
+// Periodo minimo entre mensajes de un mismo canal que se pide en cada nivel
+static const uint16_t periodoNivel[] = { 0, 100, 500 };
+
+static const char *nombresNiveles[] = { "normal", "reducido", "resumen" };
+
+ControlFlujo::ControlFlujo(size_t marcaAlta, size_t marcaBaja, int64_t permanenciaMs)
+    : alta(marcaAlta), baja(marcaBaja), permanencia(permanenciaMs)
+{
+    reiniciar();
+}
+
+void ControlFlujo::setMarcas(size_t a, size_t b)
+{
+    alta=a;
+    baja=(b<a) ? b : a;
+}
+
+void ControlFlujo::reiniciar()
+{
+    nivelPedido=FLUJO_NORMAL;
+    nivelAplicado=-1;
+    ultimoCambio=INT64_MIN/2;
+    inicioHolgura=-1;
+}
+
+bool ControlFlujo::actualizar(size_t ocupacion, int64_t ms)
+{
+    if (ocupacion>=alta)
+    {
+        inicioHolgura=-1;
+        // Se baja un nivel cada vez, dejando a la TIVA un tiempo para reaccionar antes de volver a bajar
+        if ((nivelPedido<FLUJO_RESUMEN)&&(ms-ultimoCambio>=permanencia/4))
+        {
+            nivelPedido++;
+            ultimoCambio=ms;
+            return true;
+        }
+        return false;
+    }
+
+    if (ocupacion>baja)
+    {
+        inicioHolgura=-1;       // Entre las dos marcas no se cambia nada (histeresis)
+        return false;
+    }
+
+    if (inicioHolgura<0) inicioHolgura=ms;
+    if ((nivelPedido>FLUJO_NORMAL)&&(ms-inicioHolgura>=permanencia)&&(ms-ultimoCambio>=permanencia))
+    {
+        nivelPedido--;
+        ultimoCambio=ms;
+        inicioHolgura=ms;       // El siguiente nivel tiene que volver a ganarse
+        return true;
+    }
+    return false;
+}
+
+PARAM_MENSAJE_CONTROL_FLUJO ControlFlujo::mensaje() const
+{
+    PARAM_MENSAJE_CONTROL_FLUJO m;
+    m.nivel=nivelPedido;
+    m.periodo_ms=periodoNivel[nivelPedido];
+    return m;
+}
+
+const char *ControlFlujo::nombreNivel(int nivel)
+{
+    if ((nivel<0)||(nivel>FLUJO_RESUMEN)) return "?";
+    return nombresNiveles[nivel];
+}
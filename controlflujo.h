@@ -0,0 +1,50 @@
+// Control de flujo hacia el microcontrolador. Cuando el GUI no da abasto los bytes se acumulan (en el buffer del
+// sistema operativo y en el del decodificador) y lo que se muestra va cada vez mas retrasado. Esta clase vigila
+// la ocupacion de esa cola con dos marcas: al superar la alta se pide a la TIVA un nivel de telemetria mas bajo
+// (ver nivelesFlujo en usb_messages_table.h), y cuando la cola se mantiene por debajo de la baja durante un
+// tiempo se vuelve a subir. Asi el retraso queda acotado en lugar de crecer sin limite.
+// No depende de Qt: el GUI le pasa la ocupacion y el instante, y envia el mensaje si el nivel cambia.
+
+#ifndef CONTROLFLUJO_H
+#define CONTROLFLUJO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "usb_messages_table.h"
+
+class ControlFlujo
+{
+public:
+    // Por defecto la marca alta equivale a medio segundo de datos a 9600 bps
+    ControlFlujo(size_t marcaAlta=512, size_t marcaBaja=64, int64_t permanenciaMs=2000);
+
+    void setMarcas(size_t alta, size_t baja);
+
+    // Actualiza con la ocupacion de la cola (bytes sin procesar) en el instante 'ms'. Devuelve true si cambia el
+    // nivel que hay que pedir al microcontrolador
+    bool actualizar(size_t ocupacion, int64_t ms);
+
+    // Nivel pedido y parametro del mensaje MENSAJE_CONTROL_FLUJO correspondiente
+    uint8_t nivel() const { return nivelPedido; }
+    PARAM_MENSAJE_CONTROL_FLUJO mensaje() const;
+
+    // Respuesta del microcontrolador con el nivel que ha aplicado (-1 mientras no ha respondido)
+    void confirmar(uint8_t nivel) { nivelAplicado=nivel; }
+    int aplicado() const { return nivelAplicado; }
+
+    void reiniciar();
+
+    static const char *nombreNivel(int nivel);
+
+private:
+    size_t alta;
+    size_t baja;
+    int64_t permanencia;           // Tiempo por debajo de la marca baja antes de subir un nivel
+    uint8_t nivelPedido;
+    int nivelAplicado;
+    int64_t ultimoCambio;          // Instante del ultimo cambio de nivel
+    int64_t inicioHolgura;         // Desde cuando la cola esta por debajo de la marca baja (-1 si no lo esta)
+};
+
+#endif // CONTROLFLUJO_H
@@ -0,0 +1,100 @@
+// Codificacion compacta de la telemetria (MENSAJE_*_COMPACTO de usb_messages_table.h), comun al GUI y a la TIVA.
+// Los tres potenciometros van empaquetados a 12 bits cada uno (5 bytes en lugar de 6) y los valores reales en
+// coma fija de 16 bits con una escala por campo (2 bytes en lugar de 4): los parametros ocupan entre un 17% y un
+// 50% menos y las tramas completas (con delimitadores y CRC) entre un 9% y un 22% menos.
+//
+// Todo es little endian y no usa coma flotante mas que para escalar (ni libm), asi que se compila igual en el
+// microcontrolador. La codificacion se negocia con MENSAJE_CODIFICACION: el PC pide CODIFICACION_COMPACTA y el
+// microcontrolador responde con la que aplica. Un microcontrolador antiguo responde MENSAJE_NO_IMPLEMENTADO y
+// sigue enviando los mensajes normales, que el GUI entiende siempre.
+
+#ifndef EMPAQUETADO_H
+#define EMPAQUETADO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Escalas de los campos en coma fija (unidades por cuenta) y su rango
+#define ESCALA_VELOCIDAD_COMPACTA 0.1f      // km/h, int16: +-3276.7 km/h
+#define ESCALA_COMBUSTIBLE_COMPACTO 0.01f   // int16: +-327.67
+#define ESCALA_ALTURA_COMPACTA 0.5f         // m, uint16: de 0 a 32767.5 m
+
+#define TAM_ANGULOS_COMPACTOS 5             // 3x12 bits (los 4 ultimos a 0)
+
+// roll en los bits 0-11, pitch en los 12-23 y yaw en los 24-35
+static inline void empaquetar_angulos(uint8_t *p, uint16_t roll, uint16_t pitch, uint16_t yaw)
+{
+    uint64_t v=(uint64_t)(roll&0xFFF)|((uint64_t)(pitch&0xFFF)<<12)|((uint64_t)(yaw&0xFFF)<<24);
+    int i;
+
+    for (i=0;i<TAM_ANGULOS_COMPACTOS;i++) p[i]=(uint8_t)(v>>(8*i));
+}
+
+static inline void desempaquetar_angulos(const uint8_t *p, uint16_t *roll, uint16_t *pitch, uint16_t *yaw)
+{
+    uint64_t v=0;
+    int i;
+
+    for (i=TAM_ANGULOS_COMPACTOS-1;i>=0;i--) v=(v<<8)|p[i];
+    *roll=(uint16_t)(v&0xFFF);
+    *pitch=(uint16_t)((v>>12)&0xFFF);
+    *yaw=(uint16_t)((v>>24)&0xFFF);
+}
+
+// Valor real a coma fija, redondeando al mas cercano y saturando en los extremos del tipo
+static inline int16_t a_fijo_s16(float valor, float escala)
+{
+    float x=valor/escala;
+
+    if (!(x>-32768.0f)) return (x!=x) ? 0 : INT16_MIN;   // Tambien NaN
+    if (x>=32767.0f) return INT16_MAX;
+    return (int16_t)((x>=0.0f) ? x+0.5f : x-0.5f);
+}
+
+// Como a_fijo_s16, pero un valor positivo nunca queda en 0: el combustible se redondea hacia arriba para que una
+// reserva pequena no se lea como deposito vacio (y salte sin_combustible antes de tiempo)
+static inline int16_t a_fijo_combustible(float valor)
+{
+    float x=valor/ESCALA_COMBUSTIBLE_COMPACTO;
+    int16_t r;
+
+    if (!(x>0.0f)) return a_fijo_s16(valor,ESCALA_COMBUSTIBLE_COMPACTO);
+    if (x>=32767.0f) return INT16_MAX;
+    r=(int16_t)x;
+    return ((float)r<x) ? (int16_t)(r+1) : r;
+}
+
+static inline uint16_t a_fijo_u16(float valor, float escala)
+{
+    float x=valor/escala;
+
+    if (!(x>0.0f)) return 0;                             // Tambien NaN
+    if (x>=65535.0f) return UINT16_MAX;
+    return (uint16_t)(x+0.5f);
+}
+
+static inline float desde_fijo(int32_t valor, float escala)
+{
+    return (float)valor*escala;
+}
+
+// Campos de 16 bits little endian
+static inline void escribir_u16_le(uint8_t *p, uint16_t v)
+{
+    p[0]=(uint8_t)v;
+    p[1]=(uint8_t)(v>>8);
+}
+
+static inline uint16_t leer_u16_le(const uint8_t *p)
+{
+    return (uint16_t)(p[0]|(p[1]<<8));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EMPAQUETADO_H
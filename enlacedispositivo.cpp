@@ -0,0 +1,190 @@
+#include "enlacedispositivo.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void Tarea::promise_type::unhandled_exception()
+{
+    abort();    // El panel no usa excepciones
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Transaccion
+
+Transaccion::Transaccion(EnlaceDispositivo *origen, uint8_t tipo, const void *parametro, int32_t tamParametro,
+                         uint8_t tipoRespuesta, int32_t posicionSecuencia, uint64_t plazoUs)
+    : enlace(nullptr)
+{
+    respuesta.estado=TRANSACCION_EN_CURSO;
+    respuesta.tipo=tipoRespuesta;
+    respuesta.idaVuelta=0;
+    origen->registrar(this,tipo,parametro,tamParametro,tipoRespuesta,posicionSecuencia,plazoUs);
+}
+
+Transaccion::~Transaccion()
+{
+    if (enlace) enlace->olvidar(this);
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Enlace
+
+EnlaceDispositivo::EnlaceDispositivo(std::function<bool(const uint8_t *, size_t)> escribir,
+                                     std::function<uint64_t()> reloj)
+    : escribir(escribir), reloj(reloj), siguienteSecuencia(1)
+{
+}
+
+// Las corrutinas que siguen esperando no se pueden reanudar (lo que usan puede estar destruyendose): se destruyen
+EnlaceDispositivo::~EnlaceDispositivo()
+{
+    std::vector<std::coroutine_handle<>> marcos;
+    marcos.swap(listas);
+    for (Pendiente &p : enCurso)
+    {
+        p.transaccion->enlace=nullptr;
+        if (p.transaccion->espera) marcos.push_back(p.transaccion->espera);
+    }
+    enCurso.clear();
+    for (std::coroutine_handle<> h : marcos) h.destroy();
+}
+
+Transaccion EnlaceDispositivo::peticion(uint8_t tipo, const void *parametro, int32_t tamParametro,
+                                        uint8_t tipoRespuesta, uint64_t plazoUs)
+{
+    return Transaccion(this,tipo,parametro,tamParametro,tipoRespuesta,-1,plazoUs);
+}
+
+Transaccion EnlaceDispositivo::peticionNumerada(uint8_t tipo, const void *parametro, int32_t tamParametro,
+                                                uint8_t tipoRespuesta, int32_t posicionSecuencia, uint64_t plazoUs)
+{
+    return Transaccion(this,tipo,parametro,tamParametro,tipoRespuesta,posicionSecuencia,plazoUs);
+}
+
+void EnlaceDispositivo::registrar(Transaccion *t, uint8_t tipo, const void *parametro, int32_t tamParametro,
+                                  uint8_t tipoRespuesta, int32_t posicionSecuencia, uint64_t plazoUs)
+{
+    if ((tamParametro<0)||(tamParametro>MAX_FRAME_SIZE)||
+        ((posicionSecuencia>=0)&&(posicionSecuencia+(int32_t)sizeof(uint32_t)>tamParametro)))
+    {
+        t->respuesta.estado=TRANSACCION_ERROR_ENVIO;
+        return;
+    }
+
+    // El parametro se copia para poder escribir en el la secuencia (y porque create_frame no lo admite const)
+    uint8_t copia[MAX_FRAME_SIZE];
+    if (tamParametro>0) memcpy(copia,parametro,(size_t)tamParametro);
+    uint32_t secuencia=0;
+    if (posicionSecuencia>=0)
+    {
+        secuencia=siguienteSecuencia++;
+        for (int i=0;i<4;i++) copia[posicionSecuencia+i]=(uint8_t)(secuencia>>(8*i));
+    }
+
+    uint8_t trama[MAX_FRAME_SIZE];
+    int32_t tam=create_frame(trama,tipo,copia,tamParametro,MAX_FRAME_SIZE);
+    if ((tam<=0)||!escribir(trama,(size_t)tam))
+    {
+        t->respuesta.estado=TRANSACCION_ERROR_ENVIO;
+        return;
+    }
+
+    Pendiente p;
+    p.transaccion=t;
+    p.tipoPeticion=tipo;
+    p.tipoRespuesta=tipoRespuesta;
+    p.posicionSecuencia=posicionSecuencia;
+    p.secuencia=secuencia;
+    p.enviada=reloj();
+    p.plazo=p.enviada+plazoUs;
+    enCurso.push_back(p);
+    t->enlace=this;
+}
+
+// La transaccion 'indice' termina: se quita de la lista y, si hay una corrutina esperandola, queda para reanudar
+void EnlaceDispositivo::terminar(size_t indice, EstadoTransaccion estado)
+{
+    Transaccion *t=enCurso[indice].transaccion;
+    t->respuesta.estado=estado;
+    t->enlace=nullptr;
+    if (t->espera) listas.push_back(t->espera);
+    enCurso.erase(enCurso.begin()+indice);
+}
+
+void EnlaceDispositivo::olvidar(Transaccion *t)
+{
+    for (size_t i=0;i<enCurso.size();i++)
+        if (enCurso[i].transaccion==t)
+        {
+            enCurso.erase(enCurso.begin()+i);
+            return;
+        }
+}
+
+bool EnlaceDispositivo::entregar(const MensajeDecodificado &mensaje)
+{
+    // Una respuesta con el parametro mal formado no termina la transaccion (acabara por plazo agotado)
+    if (mensaje.error||!mensaje.parametroValido||enCurso.empty()) return false;
+
+    // Rechazo de la TIVA: el parametro es el tipo de mensaje que no entiende
+    if (mensaje.tipo==MENSAJE_NO_IMPLEMENTADO)
+    {
+        uint8_t rechazado=mensaje.parametro[0];
+        for (size_t i=0;i<enCurso.size();i++)
+            if (enCurso[i].tipoPeticion==rechazado)
+            {
+                terminar(i,TRANSACCION_RECHAZADA);
+                return true;
+            }
+        return false;
+    }
+
+    for (size_t i=0;i<enCurso.size();i++)
+    {
+        const Pendiente &p=enCurso[i];
+        if (p.tipoRespuesta!=mensaje.tipo) continue;
+        if (p.posicionSecuencia>=0)
+        {
+            if (p.posicionSecuencia+(int32_t)sizeof(uint32_t)>mensaje.tamParametro) continue;
+            const uint8_t *s=mensaje.parametro+p.posicionSecuencia;
+            uint32_t secuencia=(uint32_t)s[0]|((uint32_t)s[1]<<8)|((uint32_t)s[2]<<16)|((uint32_t)s[3]<<24);
+            if (secuencia!=p.secuencia) continue;
+        }
+
+        RespuestaDispositivo &r=p.transaccion->respuesta;
+        r.tipo=mensaje.tipo;
+        r.parametro.assign(mensaje.parametro,mensaje.parametro+mensaje.tamParametro);
+        r.idaVuelta=reloj()-p.enviada;
+        terminar(i,TRANSACCION_OK);
+        return true;
+    }
+    return false;
+}
+
+void EnlaceDispositivo::revisarPlazos()
+{
+    if (enCurso.empty()) return;
+
+    uint64_t ahora=reloj();
+    for (size_t i=0;i<enCurso.size();)
+    {
+        if (enCurso[i].plazo<=ahora) terminar(i,TRANSACCION_PLAZO_AGOTADO);
+        else i++;
+    }
+}
+
+void EnlaceDispositivo::cancelar()
+{
+    while (!enCurso.empty()) terminar(enCurso.size()-1,TRANSACCION_CANCELADA);
+}
+
+void EnlaceDispositivo::reanudar()
+{
+    // Una corrutina reanudada puede crear transacciones nuevas, que terminan (y se añaden a 'listas') mas tarde
+    while (!listas.empty())
+    {
+        std::vector<std::coroutine_handle<>> ahora;
+        ahora.swap(listas);
+        for (std::coroutine_handle<> h : ahora) h.resume();
+    }
+}
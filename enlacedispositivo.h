@@ -0,0 +1,163 @@
+// Transacciones peticion/respuesta con la TIVA como corrutinas de C++20. En lugar de enviar una trama y esperar a
+// que la respuesta aparezca en el switch de procesarMensaje, una corrutina hace
+//
+//   Tarea GUIPanel::comprobarEnlace()
+//   {
+//       RespuestaDispositivo r=co_await enlace.ping();
+//       if (!r.ok()) ...                                     // Plazo agotado, rechazada o cancelada
+//   }
+//
+// La trama se envia al crear la transaccion, no al esperarla, asi que se pueden tener muchas en curso a la vez y
+// esperarlas despues (auto a=enlace.ping(); auto b=enlace.enviar(...); co_await a; co_await b;).
+//
+// Cada respuesta se asigna a la transaccion pendiente mas antigua de su tipo, o a la de su numero de secuencia si
+// la peticion es numerada (el enlace escribe la secuencia en el parametro y la busca en el mismo sitio de la
+// respuesta). Un MENSAJE_NO_IMPLEMENTADO de la TIVA termina como rechazada la mas antigua del tipo que indica.
+//
+// No depende de Qt: quien lo usa le da la funcion de escritura y el reloj, le entrega los mensajes recibidos
+// (entregar), revisa los plazos periodicamente (revisarPlazos) y reanuda las corrutinas desde el bucle de eventos
+// (reanudar), nunca desde dentro del despacho de mensajes.
+
+#ifndef ENLACEDISPOSITIVO_H
+#define ENLACEDISPOSITIVO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <coroutine>
+#include <functional>
+#include <vector>
+
+#include "telemetria.h"
+
+// Plazo por defecto de una transaccion (us)
+#define PLAZO_TRANSACCION_US 1000000
+
+enum EstadoTransaccion {
+    TRANSACCION_EN_CURSO,
+    TRANSACCION_OK,
+    TRANSACCION_PLAZO_AGOTADO,
+    TRANSACCION_RECHAZADA,     // La TIVA ha respondido MENSAJE_NO_IMPLEMENTADO
+    TRANSACCION_ERROR_ENVIO,   // No se ha podido crear o escribir la trama (p.ej. sin conexion)
+    TRANSACCION_CANCELADA      // Se ha cerrado el enlace con la transaccion en curso
+};
+
+struct RespuestaDispositivo {
+    EstadoTransaccion estado;
+    uint8_t tipo;
+    std::vector<uint8_t> parametro;    // Sin la marca de tiempo
+    uint64_t idaVuelta;                // us desde el envio hasta la respuesta
+
+    bool ok() const { return estado==TRANSACCION_OK; }
+
+    template <class Vista>
+    Vista vista() const { return Vista(parametro.data()); }
+};
+
+// Tipo de retorno de las corrutinas que usan el enlace. Empiezan a ejecutarse al llamarlas y nadie las espera: el
+// marco se libera solo al terminar (o lo destruye el enlace si se destruye con la corrutina suspendida en el)
+struct Tarea {
+    struct promise_type {
+        Tarea get_return_object() { return Tarea(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+    };
+};
+
+class EnlaceDispositivo;
+
+// Transaccion en curso. Se crea (y se envia la peticion) con los metodos de EnlaceDispositivo y se espera con
+// co_await, que devuelve la respuesta. No se puede copiar ni mover: el enlace guarda su direccion. Si se destruye
+// sin esperarla, la respuesta que llegue despues se ignora
+class Transaccion
+{
+public:
+    ~Transaccion();
+    Transaccion(const Transaccion &)=delete;
+    Transaccion &operator=(const Transaccion &)=delete;
+
+    bool await_ready() const { return respuesta.estado!=TRANSACCION_EN_CURSO; }
+    void await_suspend(std::coroutine_handle<> h) { espera=h; }
+    RespuestaDispositivo await_resume() { return std::move(respuesta); }
+
+private:
+    friend class EnlaceDispositivo;
+    Transaccion(EnlaceDispositivo *origen, uint8_t tipo, const void *parametro, int32_t tamParametro,
+                uint8_t tipoRespuesta, int32_t posicionSecuencia, uint64_t plazoUs);
+
+    EnlaceDispositivo *enlace;         // nullptr cuando ya ha terminado
+    std::coroutine_handle<> espera;    // Corrutina suspendida en co_await
+    RespuestaDispositivo respuesta;
+};
+
+class EnlaceDispositivo
+{
+public:
+    // 'escribir' envia una trama completa y devuelve false si no puede; 'reloj' da el instante actual en us
+    EnlaceDispositivo(std::function<bool(const uint8_t *, size_t)> escribir, std::function<uint64_t()> reloj);
+    ~EnlaceDispositivo();
+
+    // Peticion con respuesta del tipo 'tipoRespuesta', que se asigna a la pendiente mas antigua de ese tipo
+    Transaccion peticion(uint8_t tipo, const void *parametro, int32_t tamParametro, uint8_t tipoRespuesta,
+                         uint64_t plazoUs=PLAZO_TRANSACCION_US);
+    // Peticion numerada: el enlace escribe su numero de secuencia (uint32 little endian) en la posicion indicada
+    // del parametro, y la respuesta se asigna por el numero que trae en la misma posicion
+    Transaccion peticionNumerada(uint8_t tipo, const void *parametro, int32_t tamParametro, uint8_t tipoRespuesta,
+                                 int32_t posicionSecuencia, uint64_t plazoUs=PLAZO_TRANSACCION_US);
+
+    Transaccion ping(uint64_t plazoUs=PLAZO_TRANSACCION_US)
+    {
+        return peticion(MENSAJE_PING, nullptr, 0, MENSAJE_PING, plazoUs);
+    }
+
+    // Orden que la TIVA confirma respondiendo con el mismo tipo de mensaje (p.ej. MENSAJE_CONTROL_FLUJO)
+    template <class Parametro>
+    Transaccion enviar(uint8_t tipo, const Parametro &parametro, uint64_t plazoUs=PLAZO_TRANSACCION_US)
+    {
+        return peticion(tipo, &parametro, (int32_t)sizeof(parametro), tipo, plazoUs);
+    }
+
+    // Asigna un mensaje recibido a su transaccion. Devuelve true si era la respuesta de alguna (ya no hay que
+    // procesarlo como mensaje espontaneo)
+    bool entregar(const MensajeDecodificado &mensaje);
+
+    // Termina con plazo agotado las transacciones vencidas
+    void revisarPlazos();
+
+    // Termina todas las transacciones en curso como canceladas (al cerrar o cambiar de puerto)
+    void cancelar();
+
+    // Reanuda las corrutinas cuyas transacciones han terminado. Hay que llamarla despues de entregar, revisarPlazos
+    // o cancelar, fuera de cualquier bucle que no admita que la corrutina envie o reciba mas mensajes
+    void reanudar();
+
+    size_t pendientes() const { return enCurso.size(); }
+
+private:
+    friend class Transaccion;
+
+    struct Pendiente {
+        Transaccion *transaccion;
+        uint8_t tipoPeticion;
+        uint8_t tipoRespuesta;
+        int32_t posicionSecuencia;     // -1 si no es numerada
+        uint32_t secuencia;
+        uint64_t enviada;
+        uint64_t plazo;                // Instante limite (us)
+    };
+
+    void registrar(Transaccion *t, uint8_t tipo, const void *parametro, int32_t tamParametro, uint8_t tipoRespuesta,
+                   int32_t posicionSecuencia, uint64_t plazoUs);
+    void terminar(size_t indice, EstadoTransaccion estado);
+    void olvidar(Transaccion *t);
+
+    std::function<bool(const uint8_t *, size_t)> escribir;
+    std::function<uint64_t()> reloj;
+    std::vector<Pendiente> enCurso;                    // Por orden de envio
+    std::vector<std::coroutine_handle<>> listas;       // Corrutinas pendientes de reanudar
+    uint32_t siguienteSecuencia;
+};
+
+#endif // ENLACEDISPOSITIVO_H
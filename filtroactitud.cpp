@@ -0,0 +1,102 @@
+#include "filtroactitud.h"
+
+#include <string.h>
+
+// Rangos nominales de los indicadores (los mismos que usaba GUIPanel::convertScale)
+static const CalibracionEje calibracionNominal[NUM_EJES] = {
+    { 2048.0f, 1.0f, -180.0f, 180.0f },    // Roll
+    { 2048.0f, 1.0f, -90.0f, 90.0f },      // Pitch
+    { 2048.0f, 1.0f, -180.0f, 180.0f }     // Yaw
+};
+
+// Mediana de tres sin saltos (min/max), para que el bucle se pueda vectorizar
+static inline float mediana3(float a, float b, float c)
+{
+    float menor=(a<b) ? a : b;
+    float mayor=(a<b) ? b : a;
+    float m=(mayor<c) ? mayor : c;
+    return (menor>m) ? menor : m;
+}
+
+FiltroActitud::FiltroActitud()
+    : alfa(0.35f)
+{
+    for (int e=0;e<NUM_EJES;e++) setCalibracion((EjeActitud)e,calibracionNominal[e]);
+    reiniciar();
+}
+
+void FiltroActitud::setCalibracion(EjeActitud eje, const CalibracionEje &cal)
+{
+    calibraciones[eje]=cal;
+    calcularTabla(eje);
+}
+
+void FiltroActitud::setSuavizado(float a)
+{
+    if (a>1.0f) a=1.0f;
+    if (a<0.01f) a=0.01f;
+    alfa=a;
+}
+
+void FiltroActitud::reiniciar()
+{
+    iniciado=false;
+    memset(anterior1,0,sizeof(anterior1));
+    memset(anterior2,0,sizeof(anterior2));
+    memset(salida,0,sizeof(salida));
+}
+
+void FiltroActitud::calcularTabla(EjeActitud eje)
+{
+    const CalibracionEje &c=calibraciones[eje];
+    float centro=(c.minimo+c.maximo)/2;
+    float escala=c.ganancia*(c.maximo-c.minimo)/CUENTAS_ADC;
+
+    for (int i=0;i<CUENTAS_ADC;i++)
+    {
+        float g=centro+((float)i-c.cero)*escala;
+        if (g<c.minimo) g=c.minimo;
+        if (g>c.maximo) g=c.maximo;
+        tablas[eje][i]=g;
+    }
+}
+
+void FiltroActitud::procesar(const MuestraAdc *muestras, size_t n)
+{
+    float x[CARRILES];
+    float a1[CARRILES], a2[CARRILES], y[CARRILES];
+    float k=alfa;
+
+    if (!n) return;
+
+    // El estado se copia a variables locales para que el compilador lo mantenga en registros durante el lote
+    memcpy(a1,anterior1,sizeof(a1));
+    memcpy(a2,anterior2,sizeof(a2));
+    memcpy(y,salida,sizeof(y));
+
+    for (size_t i=0;i<n;i++)
+    {
+        for (int e=0;e<NUM_EJES;e++) x[e]=tablas[e][muestras[i].eje[e]&(CUENTAS_ADC-1)];
+        x[NUM_EJES]=0.0f;
+
+        if (!iniciado)
+        {
+            // La primera muestra arranca los filtros, para que la aguja no venga barriendo desde 0
+            for (int c=0;c<CARRILES;c++) a1[c]=a2[c]=y[c]=x[c];
+            iniciado=true;
+            continue;
+        }
+
+        for (int c=0;c<CARRILES;c++)
+        {
+            float m=mediana3(a2[c],a1[c],x[c]);
+            a2[c]=a1[c];
+            a1[c]=x[c];
+            y[c]+=k*(m-y[c]);
+        }
+    }
+
+    memcpy(anterior1,a1,sizeof(a1));
+    memcpy(anterior2,a2,sizeof(a2));
+    memcpy(salida,y,sizeof(y));
+}
@@ -0,0 +1,74 @@
+// Etapa de procesado de los potenciometros (roll, pitch, yaw) entre la decodificacion y los indicadores.
+// Las cuentas del ADC (12 bits) se pasan a grados con una tabla de 4096 entradas por eje, calculada al cambiar la
+// calibracion, y despues se filtran: mediana de 3 para quitar picos sueltos y paso bajo de primer orden para
+// estabilizar las agujas. Se procesan lotes (todas las muestras que llegan en una lectura del puerto serie) y
+// los tres ejes a la vez, uno por carril, de forma que el compilador vectoriza el filtrado.
+
+#ifndef FILTROACTITUD_H
+#define FILTROACTITUD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum EjeActitud {
+    EJE_ROLL,
+    EJE_PITCH,
+    EJE_YAW,
+    NUM_EJES
+};
+
+// Muestra de los tres potenciometros, en cuentas del ADC tal como llegan de la TIVA
+struct MuestraAdc {
+    uint16_t eje[NUM_EJES];
+};
+
+// Calibracion de un eje: grados = centro del rango + (cuentas-cero)*ganancia*(maximo-minimo)/4096, limitado al
+// rango [minimo,maximo]. Una ganancia negativa invierte el sentido del eje
+struct CalibracionEje {
+    float cero;                // Cuentas con el mando centrado (nominal 2048)
+    float ganancia;            // Sobre la escala nominal (1.0)
+    float minimo;              // Rango del indicador en grados
+    float maximo;
+};
+
+class FiltroActitud
+{
+public:
+    static const int CUENTAS_ADC=4096;
+
+    FiltroActitud();
+
+    void setCalibracion(EjeActitud eje, const CalibracionEje &cal);
+    const CalibracionEje &calibracion(EjeActitud eje) const { return calibraciones[eje]; }
+
+    // Coeficiente del paso bajo (0-1]: 1 no filtra, valores pequeños suavizan mas pero retrasan la aguja
+    void setSuavizado(float alfa);
+
+    // Olvida las muestras anteriores (la siguiente se toma como valor inicial de los filtros)
+    void reiniciar();
+
+    // Filtra un lote de muestras. El resultado tras la ultima muestra queda en grados()
+    void procesar(const MuestraAdc *muestras, size_t n);
+
+    // Conversion directa, sin filtrar
+    float convertir(EjeActitud eje, uint16_t cuentas) const { return tablas[eje][cuentas&(CUENTAS_ADC-1)]; }
+
+    float grados(EjeActitud eje) const { return salida[eje]; }
+    bool hayDatos() const { return iniciado; }
+
+private:
+    static const int CARRILES=4;    // Un carril por eje, mas uno de relleno para que el bucle sea de 4 floats
+
+    void calcularTabla(EjeActitud eje);
+
+    CalibracionEje calibraciones[NUM_EJES];
+    float tablas[NUM_EJES][CUENTAS_ADC];
+    float alfa;
+    bool iniciado;
+    // Estado de los filtros: las dos muestras anteriores (mediana) y la salida del paso bajo
+    float anterior1[CARRILES];
+    float anterior2[CARRILES];
+    float salida[CARRILES];
+};
+
+#endif // FILTROACTITUD_H
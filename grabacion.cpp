@@ -0,0 +1,434 @@
+#include "grabacion.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+static const char MAGICO_CABECERA[8]={'G','P','V','U','E','L','O','\0'};
+static const char MAGICO_PIE[8]={'G','P','I','N','D','I','C','E'};
+static const uint32_t VERSION_GRABACION=1;
+
+static const size_t TAM_CABECERA=16;
+static const size_t TAM_CABECERA_REGISTRO=12;
+static const size_t TAM_PIE=16;
+static const size_t TAM_FOTOGRAMA=4*4+4+3*2+2+41;
+
+// Escritura y lectura little endian campo a campo, independiente del relleno de las estructuras
+
+static uint8_t *poner_u16(uint8_t *p, uint16_t v)
+{
+    p[0]=(uint8_t)v; p[1]=(uint8_t)(v>>8);
+    return p+2;
+}
+
+static uint8_t *poner_u32(uint8_t *p, uint32_t v)
+{
+    for (int i=0;i<4;i++) p[i]=(uint8_t)(v>>(8*i));
+    return p+4;
+}
+
+static uint8_t *poner_u64(uint8_t *p, uint64_t v)
+{
+    for (int i=0;i<8;i++) p[i]=(uint8_t)(v>>(8*i));
+    return p+8;
+}
+
+static uint8_t *poner_f32(uint8_t *p, float v)
+{
+    uint32_t bits;
+    memcpy(&bits,&v,sizeof(bits));
+    return poner_u32(p,bits);
+}
+
+static uint16_t leer_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0]|(p[1]<<8));
+}
+
+static uint32_t leer_u32(const uint8_t *p)
+{
+    uint32_t v=0;
+    for (int i=3;i>=0;i--) v=(v<<8)|p[i];
+    return v;
+}
+
+static uint64_t leer_u64(const uint8_t *p)
+{
+    uint64_t v=0;
+    for (int i=7;i>=0;i--) v=(v<<8)|p[i];
+    return v;
+}
+
+static float leer_f32(const uint8_t *p)
+{
+    uint32_t bits=leer_u32(p);
+    float v;
+    memcpy(&v,&bits,sizeof(v));
+    return v;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// GrabadorVuelo
+
+GrabadorVuelo::GrabadorVuelo()
+    : f(nullptr), errorEscritura(false), hayFotograma(false), ultimoFotograma(0)
+{
+}
+
+GrabadorVuelo::~GrabadorVuelo()
+{
+    cerrar();
+}
+
+bool GrabadorVuelo::abrir(const std::string &fichero)
+{
+    cerrar();
+    f=fopen(fichero.c_str(),"wb");
+    if (!f) return false;
+
+    uint8_t cabecera[TAM_CABECERA];
+    memcpy(cabecera,MAGICO_CABECERA,8);
+    poner_u32(cabecera+8,VERSION_GRABACION);
+    poner_u32(cabecera+12,0);
+    errorEscritura=(fwrite(cabecera,1,sizeof(cabecera),f)!=sizeof(cabecera));
+
+    indice.clear();
+    hayFotograma=false;
+    ultimoFotograma=0;
+    return true;
+}
+
+bool GrabadorVuelo::cerrar()
+{
+    if (!f) return true;
+
+    uint64_t desplazamientoIndice=(uint64_t)ftell(f);
+    uint8_t buffer[16];
+    poner_u32(buffer,(uint32_t)indice.size());
+    escribir(buffer,4);
+    for (const EntradaIndice &e : indice)
+    {
+        poner_u64(buffer,e.instante);
+        poner_u64(buffer+8,e.desplazamiento);
+        escribir(buffer,16);
+    }
+    poner_u64(buffer,desplazamientoIndice);
+    memcpy(buffer+8,MAGICO_PIE,8);
+    escribir(buffer,TAM_PIE);
+
+    // fclose vacia el buffer: es donde suelen aparecer los errores de las ultimas escrituras
+    if (fflush(f)!=0) errorEscritura=true;
+    if (fclose(f)!=0) errorEscritura=true;
+    f=nullptr;
+    return !errorEscritura;
+}
+
+void GrabadorVuelo::escribir(const uint8_t *datos, size_t n)
+{
+    if (n && (fwrite(datos,1,n,f)!=n)) errorEscritura=true;
+}
+
+void GrabadorVuelo::escribirRegistro(uint8_t tipo, uint64_t instante, const uint8_t *datos, uint16_t n)
+{
+    uint8_t cabecera[TAM_CABECERA_REGISTRO];
+    cabecera[0]=tipo;
+    cabecera[1]=0;
+    poner_u16(cabecera+2,n);
+    poner_u64(cabecera+4,instante);
+    escribir(cabecera,sizeof(cabecera));
+    escribir(datos,n);
+}
+
+void GrabadorVuelo::anadirDatos(uint64_t instante, const uint8_t *datos, size_t n)
+{
+    if (!f) return;
+    while (n>0)
+    {
+        size_t trozo=std::min(n,(size_t)MAX_DATOS_REGISTRO);
+        escribirRegistro(REGISTRO_DATOS,instante,datos,(uint16_t)trozo);
+        datos+=trozo;
+        n-=trozo;
+    }
+}
+
+void GrabadorVuelo::anadirConsigna(uint64_t instante, float consigna)
+{
+    if (!f) return;
+    uint8_t datos[4];
+    poner_f32(datos,consigna);
+    escribirRegistro(REGISTRO_CONSIGNA,instante,datos,sizeof(datos));
+}
+
+void GrabadorVuelo::anadirFotograma(uint64_t instante, const EstadoInstrumentos &estado)
+{
+    if (!f) return;
+
+    uint8_t datos[TAM_FOTOGRAMA];
+    uint8_t *p=datos;
+    p=poner_f32(p,estado.altura);
+    p=poner_f32(p,estado.combustible);
+    p=poner_f32(p,estado.velocidad);
+    p=poner_f32(p,estado.consigna);
+    p=poner_u32(p,estado.reloj);
+    p=poner_u16(p,estado.roll);
+    p=poner_u16(p,estado.pitch);
+    p=poner_u16(p,estado.yaw);
+    *p++=estado.colision;
+    *p++=estado.sinCombustible;
+    memcpy(p,estado.radio,sizeof(estado.radio));
+    p[sizeof(estado.radio)-1]='\0';
+
+    escribirRegistro(REGISTRO_FOTOGRAMA,instante,datos,sizeof(datos));
+
+    // El indice apunta al registro que sigue al fotograma: al saltar, el fotograma se aplica desde el indice
+    EntradaIndice e;
+    e.instante=instante;
+    e.desplazamiento=(uint64_t)ftell(f);
+    indice.push_back(e);
+    hayFotograma=true;
+    ultimoFotograma=instante;
+}
+
+void GrabadorVuelo::anadirMuestra(uint64_t instante, uint8_t tipo, const uint8_t *parametro, size_t n)
+{
+    if (!f || (n>=(size_t)MAX_DATOS_REGISTRO)) return;
+    uint8_t datos[MAX_DATOS_REGISTRO];
+    datos[0]=tipo;
+    if (n) memcpy(datos+1,parametro,n);
+    escribirRegistro(REGISTRO_MUESTRA,instante,datos,(uint16_t)(n+1));
+}
+
+void GrabadorVuelo::anadirSincronizacion(uint64_t instante, uint32_t secuencia, uint64_t t1)
+{
+    if (!f) return;
+    uint8_t datos[4+8];
+    poner_u32(datos,secuencia);
+    poner_u64(datos+4,t1);
+    escribirRegistro(REGISTRO_SINCRONIZACION,instante,datos,sizeof(datos));
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// LectorVuelo
+
+LectorVuelo::LectorVuelo()
+    : f(nullptr), finDatos(0), tInicial(0), tFinal(0), hayMirado(false)
+{
+}
+
+LectorVuelo::~LectorVuelo()
+{
+    cerrar();
+}
+
+void LectorVuelo::cerrar()
+{
+    if (f) fclose(f);
+    f=nullptr;
+    indice.clear();
+    fotogramas.clear();
+    hayMirado=false;
+}
+
+bool LectorVuelo::abrir(const std::string &fichero)
+{
+    cerrar();
+    f=fopen(fichero.c_str(),"rb");
+    if (!f) return false;
+
+    uint8_t cabecera[TAM_CABECERA];
+    if ((fread(cabecera,1,sizeof(cabecera),f)!=sizeof(cabecera))||memcmp(cabecera,MAGICO_CABECERA,8)||
+        (leer_u32(cabecera+8)!=VERSION_GRABACION))
+    {
+        cerrar();
+        return false;
+    }
+
+    fseek(f,0,SEEK_END);
+    finDatos=(uint64_t)ftell(f);
+    if (!cargarIndice()) reconstruirIndice();
+
+    // Instantes inicial y final: primer registro, y el mayor entre el ultimo fotograma y lo que queda tras el
+    fseek(f,(long)TAM_CABECERA,SEEK_SET);
+    RegistroVuelo registro;
+    tInicial=tFinal=0;
+    if (leerRegistro(registro)) tInicial=tFinal=registro.instante;
+    if (!indice.empty())
+    {
+        tFinal=std::max(tFinal,indice.back().instante);
+        fseek(f,(long)indice.back().desplazamiento,SEEK_SET);
+    }
+    while (leerRegistro(registro)) tFinal=std::max(tFinal,registro.instante);
+
+    fseek(f,(long)TAM_CABECERA,SEEK_SET);
+    hayMirado=false;
+    return true;
+}
+
+bool LectorVuelo::cargarIndice()
+{
+    if (finDatos<TAM_CABECERA+4+TAM_PIE) return false;
+
+    uint8_t pie[TAM_PIE];
+    fseek(f,(long)(finDatos-TAM_PIE),SEEK_SET);
+    if ((fread(pie,1,sizeof(pie),f)!=sizeof(pie))||memcmp(pie+8,MAGICO_PIE,8)) return false;
+    uint64_t desplazamientoIndice=leer_u64(pie);
+    if ((desplazamientoIndice<TAM_CABECERA)||(desplazamientoIndice+4+TAM_PIE>finDatos)) return false;
+
+    uint8_t buffer[16];
+    fseek(f,(long)desplazamientoIndice,SEEK_SET);
+    if (fread(buffer,1,4,f)!=4) return false;
+    uint32_t n=leer_u32(buffer);
+    if (desplazamientoIndice+4+(uint64_t)n*16+TAM_PIE!=finDatos) return false;
+
+    indice.resize(n);
+    for (uint32_t i=0;i<n;i++)
+    {
+        if (fread(buffer,1,16,f)!=16) return false;
+        indice[i].instante=leer_u64(buffer);
+        indice[i].desplazamiento=leer_u64(buffer+8);
+    }
+    finDatos=desplazamientoIndice;
+
+    // Los fotogramas se cargan ya: son pocos (uno por segundo) y asi saltar no tiene que leerlos del disco
+    fotogramas.resize(n);
+    for (uint32_t i=0;i<n;i++)
+    {
+        RegistroVuelo registro;
+        uint64_t desplazamiento=indice[i].desplazamiento-TAM_CABECERA_REGISTRO-TAM_FOTOGRAMA;
+        fseek(f,(long)desplazamiento,SEEK_SET);
+        if (!leerRegistro(registro)||!leerFotograma(registro,fotogramas[i]))
+        {
+            indice.clear();
+            fotogramas.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void LectorVuelo::reconstruirIndice()
+{
+    indice.clear();
+    fotogramas.clear();
+
+    // Sin pie, los datos llegan hasta donde se pueda leer un registro completo
+    fseek(f,0,SEEK_END);
+    finDatos=(uint64_t)ftell(f);
+    fseek(f,(long)TAM_CABECERA,SEEK_SET);
+
+    RegistroVuelo registro;
+    EstadoInstrumentos estado;
+    uint64_t ultimoCompleto=TAM_CABECERA;
+    uint64_t ultimoInstante=0;
+    // Los instantes no decrecen nunca; si lo hacen es que se ha llegado a un indice escrito a medias
+    while (leerRegistro(registro)&&(registro.instante>=ultimoInstante))
+    {
+        ultimoInstante=registro.instante;
+        ultimoCompleto=(uint64_t)ftell(f);
+        if ((registro.tipo==REGISTRO_FOTOGRAMA)&&leerFotograma(registro,estado))
+        {
+            EntradaIndice e;
+            e.instante=registro.instante;
+            e.desplazamiento=ultimoCompleto;
+            indice.push_back(e);
+            fotogramas.push_back(estado);
+        }
+    }
+    finDatos=ultimoCompleto;
+}
+
+bool LectorVuelo::leerRegistro(RegistroVuelo &registro)
+{
+    uint64_t posicion=(uint64_t)ftell(f);
+    if (posicion+TAM_CABECERA_REGISTRO>finDatos) return false;
+
+    uint8_t cabecera[TAM_CABECERA_REGISTRO];
+    if (fread(cabecera,1,sizeof(cabecera),f)!=sizeof(cabecera)) return false;
+    uint16_t n=leer_u16(cabecera+2);
+    if (posicion+TAM_CABECERA_REGISTRO+n>finDatos) return false;
+    if ((cabecera[0]<REGISTRO_DATOS)||(cabecera[0]>REGISTRO_SINCRONIZACION)||cabecera[1]) return false;
+
+    registro.tipo=cabecera[0];
+    registro.instante=leer_u64(cabecera+4);
+    registro.datos.resize(n);
+    return (n==0)||(fread(registro.datos.data(),1,n,f)==n);
+}
+
+bool LectorVuelo::siguienteHasta(uint64_t limite, RegistroVuelo &registro)
+{
+    if (!hayMirado)
+    {
+        if (!f||!leerRegistro(mirado)) return false;
+        hayMirado=true;
+    }
+    if (mirado.instante>limite) return false;
+
+    hayMirado=false;
+    registro.tipo=mirado.tipo;
+    registro.instante=mirado.instante;
+    registro.datos.swap(mirado.datos);
+    return true;
+}
+
+uint64_t LectorVuelo::buscar(uint64_t instante, EstadoInstrumentos &estado)
+{
+    hayMirado=false;
+
+    // Primer fotograma posterior a 'instante'; el anterior a ese es el que sirve
+    std::vector<EntradaIndice>::const_iterator it=std::upper_bound(indice.begin(),indice.end(),instante,
+        [](uint64_t t, const EntradaIndice &e) { return t<e.instante; });
+    if (it==indice.begin())
+    {
+        memset(&estado,0,sizeof(estado));
+        fseek(f,(long)TAM_CABECERA,SEEK_SET);
+        return tInicial;
+    }
+    --it;
+    estado=fotogramas[(size_t)(it-indice.begin())];
+    fseek(f,(long)it->desplazamiento,SEEK_SET);
+    return it->instante;
+}
+
+bool LectorVuelo::leerFotograma(const RegistroVuelo &registro, EstadoInstrumentos &estado)
+{
+    if ((registro.tipo!=REGISTRO_FOTOGRAMA)||(registro.datos.size()!=TAM_FOTOGRAMA)) return false;
+
+    const uint8_t *p=registro.datos.data();
+    estado.altura=leer_f32(p); p+=4;
+    estado.combustible=leer_f32(p); p+=4;
+    estado.velocidad=leer_f32(p); p+=4;
+    estado.consigna=leer_f32(p); p+=4;
+    estado.reloj=leer_u32(p); p+=4;
+    estado.roll=leer_u16(p); p+=2;
+    estado.pitch=leer_u16(p); p+=2;
+    estado.yaw=leer_u16(p); p+=2;
+    estado.colision=*p++;
+    estado.sinCombustible=*p++;
+    memcpy(estado.radio,p,sizeof(estado.radio));
+    estado.radio[sizeof(estado.radio)-1]='\0';
+    return true;
+}
+
+bool LectorVuelo::leerConsigna(const RegistroVuelo &registro, float &consigna)
+{
+    if ((registro.tipo!=REGISTRO_CONSIGNA)||(registro.datos.size()!=4)) return false;
+    consigna=leer_f32(registro.datos.data());
+    return true;
+}
+
+bool LectorVuelo::leerMuestra(const RegistroVuelo &registro, uint8_t &tipo, const uint8_t *&parametro, size_t &n)
+{
+    if ((registro.tipo!=REGISTRO_MUESTRA)||registro.datos.empty()) return false;
+    tipo=registro.datos[0];
+    parametro=registro.datos.data()+1;
+    n=registro.datos.size()-1;
+    return true;
+}
+
+bool LectorVuelo::leerSincronizacion(const RegistroVuelo &registro, uint32_t &secuencia, uint64_t &t1)
+{
+    if ((registro.tipo!=REGISTRO_SINCRONIZACION)||(registro.datos.size()!=12)) return false;
+    secuencia=leer_u32(registro.datos.data());
+    t1=leer_u64(registro.datos.data()+4);
+    return true;
+}
@@ -0,0 +1,151 @@
+// Grabacion de vuelos para reproducirlos despues en el GUI. Se guardan los bytes tal como llegan del puerto serie,
+// con su instante de llegada, de forma que la reproduccion pasa por el mismo camino que los datos en vivo
+// (decodificador, cola de mensajes, indicadores). Cada segundo se añade ademas un fotograma con el estado
+// completo de los instrumentos, y al cerrar la grabacion un indice de fotogramas: para saltar a cualquier punto
+// se busca (busqueda binaria) el ultimo fotograma anterior, se aplica, y solo se reproducen los datos desde ahi.
+//
+// Formato (little endian):
+//
+//   cabecera:   "GPVUELO\0" | u32 version (1) | u32 reservado
+//   registro:   u8 tipo | u8 reservado | u16 longitud | u64 instante (us) | datos[longitud]
+//                 REGISTRO_DATOS:      bytes recibidos por el puerto serie (como mucho MAX_DATOS_REGISTRO)
+//                 REGISTRO_FOTOGRAMA:  EstadoInstrumentos serializado
+//                 REGISTRO_CONSIGNA:   f32 consigna de velocidad de la palanca (km/h)
+//                 REGISTRO_MUESTRA:    u8 tipo de mensaje | parametro ya decodificado (solo la caja negra, cajanegra.h)
+//                 REGISTRO_SINCRONIZACION: u32 secuencia | u64 t1 de una peticion de sincronizacion enviada (la
+//                                      respuesta llega en los datos; con las dos se recupera el reloj de la TIVA)
+//   indice:     u32 numero de fotogramas | {u64 instante, u64 desplazamiento del registro siguiente}...
+//   pie:        u64 desplazamiento del indice | "GPINDICE"
+//
+// Si el programa termina sin cerrar la grabacion falta el indice; el lector lo reconstruye recorriendo el fichero.
+// No depende de Qt.
+
+#ifndef GRABACION_H
+#define GRABACION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// Estado completo de los instrumentos en un instante
+struct EstadoInstrumentos {
+    float altura;              // m
+    float combustible;
+    float velocidad;           // Aguja de velocidad (km/h)
+    float consigna;            // Palanca de velocidad (km/h)
+    uint32_t reloj;            // s
+    uint16_t roll;             // Cuentas del ADC
+    uint16_t pitch;
+    uint16_t yaw;
+    uint8_t colision;
+    uint8_t sinCombustible;
+    char radio[41];            // Ultimo mensaje de radio, terminado en '\0'
+};
+
+enum TipoRegistro {
+    REGISTRO_DATOS=1,
+    REGISTRO_FOTOGRAMA=2,
+    REGISTRO_CONSIGNA=3,
+    REGISTRO_MUESTRA=4,
+    REGISTRO_SINCRONIZACION=5
+};
+
+struct RegistroVuelo {
+    uint8_t tipo;
+    uint64_t instante;         // us
+    std::vector<uint8_t> datos;
+};
+
+class GrabadorVuelo
+{
+public:
+    static const int MAX_DATOS_REGISTRO=4096;
+    static const uint64_t PERIODO_FOTOGRAMAS=1000000;    // us
+
+    GrabadorVuelo();
+    ~GrabadorVuelo();
+
+    bool abrir(const std::string &fichero);
+    // Escribe el indice. Devuelve false si ha fallado alguna escritura (disco lleno...): la grabacion puede estar
+    // incompleta
+    bool cerrar();
+    bool abierto() const { return f!=nullptr; }
+
+    void anadirDatos(uint64_t instante, const uint8_t *datos, size_t n);
+    void anadirConsigna(uint64_t instante, float consigna);
+    void anadirFotograma(uint64_t instante, const EstadoInstrumentos &estado);
+    void anadirMuestra(uint64_t instante, uint8_t tipo, const uint8_t *parametro, size_t n);
+    void anadirSincronizacion(uint64_t instante, uint32_t secuencia, uint64_t t1);
+
+    // Indica si ya toca el siguiente fotograma
+    bool tocaFotograma(uint64_t instante) const { return !hayFotograma || (instante-ultimoFotograma>=PERIODO_FOTOGRAMAS); }
+
+private:
+    struct EntradaIndice {
+        uint64_t instante;
+        uint64_t desplazamiento;
+    };
+
+    void escribir(const uint8_t *datos, size_t n);
+    void escribirRegistro(uint8_t tipo, uint64_t instante, const uint8_t *datos, uint16_t n);
+
+    FILE *f;
+    bool errorEscritura;
+    std::vector<EntradaIndice> indice;
+    bool hayFotograma;
+    uint64_t ultimoFotograma;
+};
+
+class LectorVuelo
+{
+public:
+    LectorVuelo();
+    ~LectorVuelo();
+
+    // Abre la grabacion y carga (o reconstruye) el indice de fotogramas
+    bool abrir(const std::string &fichero);
+    void cerrar();
+
+    uint64_t inicio() const { return tInicial; }
+    uint64_t fin() const { return tFinal; }
+
+    // Se coloca en el ultimo fotograma anterior o igual a 'instante' (busqueda binaria en el indice) y lo deja en
+    // 'estado'. Devuelve el instante del fotograma, o el inicio de la grabacion si no hay ninguno anterior (en ese
+    // caso 'estado' queda a cero)
+    uint64_t buscar(uint64_t instante, EstadoInstrumentos &estado);
+
+    // Lee el siguiente registro. Devuelve false al final del fichero
+    bool siguiente(RegistroVuelo &registro) { return siguienteHasta(UINT64_MAX, registro); }
+    // Igual, pero solo si el registro no es posterior a 'limite' (si lo es, se queda para la siguiente lectura)
+    bool siguienteHasta(uint64_t limite, RegistroVuelo &registro);
+
+    // Contenido de los registros de fotograma y de consigna (false si el registro no es de ese tipo)
+    static bool leerFotograma(const RegistroVuelo &registro, EstadoInstrumentos &estado);
+    static bool leerConsigna(const RegistroVuelo &registro, float &consigna);
+    // Muestra decodificada: tipo de mensaje y parametro (apunta dentro de 'registro')
+    static bool leerMuestra(const RegistroVuelo &registro, uint8_t &tipo, const uint8_t *&parametro, size_t &n);
+    static bool leerSincronizacion(const RegistroVuelo &registro, uint32_t &secuencia, uint64_t &t1);
+
+private:
+    struct EntradaIndice {
+        uint64_t instante;
+        uint64_t desplazamiento;
+    };
+
+    bool leerRegistro(RegistroVuelo &registro);
+    bool cargarIndice();
+    void reconstruirIndice();
+
+    FILE *f;
+    uint64_t finDatos;             // Fin de los registros (principio del indice)
+    uint64_t tInicial;
+    uint64_t tFinal;
+    std::vector<EntradaIndice> indice;
+    std::vector<EstadoInstrumentos> fotogramas;   // Estado de cada entrada del indice
+    bool hayMirado;
+    RegistroVuelo mirado;
+};
+
+#endif // GRABACION_H
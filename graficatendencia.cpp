@@ -0,0 +1,81 @@
+#include "graficatendencia.h"
+
+#include <qwt_plot_intervalcurve.h>
+#include <qwt_plot_canvas.h>
+#include <qwt_plot_panner.h>
+#include <qwt_plot_magnifier.h>
+#include <qwt_plot_grid.h>
+#include <qwt_scale_div.h>
+#include <QVector>
+
+GraficaTendencia::GraficaTendencia(const QString &titulo, const HistorialCanal *historial, QWidget *parent) :
+    QwtPlot(parent)
+  , historial(historial)
+  , ventana(60.0)
+  , ultimoFinal(0.0)
+{
+    setTitle(titulo);
+    setAxisTitle(QwtPlot::xBottom, tr("Tiempo (s)"));
+    setCanvasBackground(Qt::white);
+
+    QwtPlotGrid *rejilla = new QwtPlotGrid();
+    rejilla->setMajorPen(QPen(Qt::lightGray, 0, Qt::DotLine));
+    rejilla->attach(this);
+
+    // Banda entre el minimo y el maximo de cada pixel: con muchas muestras por pixel no se pierden los picos
+    curva = new QwtPlotIntervalCurve(titulo);
+    curva->setStyle(QwtPlotIntervalCurve::Tube);
+    curva->setPen(QPen(QColor(255, 125, 0), 1));
+    curva->setBrush(QBrush(QColor(255, 125, 0, 120)));
+    curva->setRenderHint(QwtPlotItem::RenderAntialiased, false);
+    curva->attach(this);
+
+    // Desplazamiento con el raton y zoom con la rueda, solo en el eje de tiempos
+    QwtPlotPanner *panner = new QwtPlotPanner(canvas());
+    panner->setOrientations(Qt::Horizontal);
+    QwtPlotMagnifier *magnifier = new QwtPlotMagnifier(canvas());
+    magnifier->setAxisEnabled(QwtPlot::yLeft, false);
+
+    setAxisScale(QwtPlot::xBottom, 0.0, ventana);
+    setAxisAutoScale(QwtPlot::yLeft, true);
+
+    // El refresco es periodico (5 Hz) y no por muestra: el coste de pintar no crece con la tasa de datos
+    temporizador = new QTimer(this);
+    connect(temporizador, SIGNAL(timeout()), this, SLOT(refrescar()));
+    temporizador->start(200);
+}
+
+void GraficaTendencia::setVentana(double segundos)
+{
+    ventana=segundos;
+    setAxisScale(QwtPlot::xBottom, ultimoFinal-ventana, ultimoFinal);
+}
+
+void GraficaTendencia::refrescar()
+{
+    if (!isVisible() || historial->vacio()) return;
+
+    double t0=axisScaleDiv(QwtPlot::xBottom).lowerBound();
+    double t1=axisScaleDiv(QwtPlot::xBottom).upperBound();
+    double tFinal=historial->tiempoFinal();
+
+    // Si el usuario estaba mirando el final de la grafica, se desplaza la ventana para seguir los datos
+    if (t1>=ultimoFinal)
+    {
+        ventana=t1-t0;
+        t1=tFinal;
+        t0=tFinal-ventana;
+        setAxisScale(QwtPlot::xBottom, t0, t1);
+    }
+    ultimoFinal=tFinal;
+
+    historial->consultar(t0, t1, canvas()->width(), muestras);
+
+    QVector<QwtIntervalSample> puntos;
+    puntos.reserve((int)muestras.size());
+    for (const MuestraHistorial &m : muestras)
+        puntos.append(QwtIntervalSample(m.t, m.minimo, m.maximo));
+    curva->setSamples(puntos);
+
+    replot();
+}
@@ -0,0 +1,38 @@
+// Grafica de tendencia (Qwt) de un canal de telemetria guardado en un HistorialCanal. En cada refresco se pide
+// al historial un intervalo min/max por pixel del eje X, por lo que el coste de pintar no depende de las horas
+// de vuelo acumuladas. Se puede desplazar (boton izquierdo) y hacer zoom (rueda) sobre la grafica; si el extremo
+// derecho esta en el instante actual, la ventana sigue a los datos nuevos.
+
+#ifndef GRAFICATENDENCIA_H
+#define GRAFICATENDENCIA_H
+
+#include <qwt_plot.h>
+#include <QTimer>
+#include <vector>
+
+#include "historial.h"
+
+class QwtPlotIntervalCurve;
+
+class GraficaTendencia : public QwtPlot
+{
+    Q_OBJECT
+
+public:
+    GraficaTendencia(const QString &titulo, const HistorialCanal *historial, QWidget *parent = 0);
+
+    void setVentana(double segundos);
+
+private slots:
+    void refrescar();
+
+private:
+    const HistorialCanal *historial;
+    QwtPlotIntervalCurve *curva;
+    QTimer *temporizador;
+    double ventana;             // Anchura (s) del eje X al seguir los datos nuevos
+    double ultimoFinal;         // tiempoFinal() del historial en el refresco anterior
+    std::vector<MuestraHistorial> muestras;
+};
+
+#endif // GRAFICATENDENCIA_H
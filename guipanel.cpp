@@ -5,6 +5,7 @@
 
 #include<stdint.h>      // Cabecera para usar tipos de enteros con tamaño
 #include<stdbool.h>     // Cabecera para usar booleanos
+#include<string.h>
 
 extern "C" {
 #include "serial2USBprotocol.h"    // Cabecera de funciones de gestión de tramas; se indica que está en C, ya que QTs
@@ -12,11 +13,31 @@ extern "C" {
 }
 
 #include "usb_messages_table.h"
+#include "telemetria.h"           // Reensamblado y decodificacion de tramas (comun con las herramientas)
+#include "traza.h"
+
+#include <math.h>
 
 #include <QPainter>       // colores diferentes para los componentes
 #include <QTimer>
 #include <QGraphicsPixmapItem>
 #include <QString>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QVBoxLayout>
+#include <QShortcut>
+#include <QFile>
+#include <QStringList>
+
+#include "graficatendencia.h"
+#include "panelreproduccion.h"
+#include "publicadormqtt.h"
+#include <QDateTime>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>   // Socket netlink para la deteccion en caliente de puertos
+#include <linux/netlink.h>
+#include <unistd.h>
+#endif
 
 #include <qwt_dial_needle.h>
 #include <qwt_round_scale_draw.h>
@@ -32,10 +53,21 @@ typedef QColorGroup Palette;
 typedef QPalette Palette;
 #endif
 
+// Variacion minima (en grados) para volver a pintar un indicador de actitud
+#define BANDA_MUERTA_GRADOS 0.5f
+
 GUIPanel::GUIPanel(QWidget *parent) :  // Constructor de la clase
     QWidget(parent),
     ui(new Ui::GUIPanel)               // Indica que guipanel.ui es el interfaz grafico de la clase
   , transactionCount(0)
+  , enlace([this](const uint8_t *trama, size_t tam) { return escribirTrama(trama, tam); },
+           [this]() { return ahoraUs(); })
+  , ventanaTendencias(nullptr)
+  , publicadorMqtt(nullptr)
+  , shmTelemetria(nullptr)
+  , ventanaReproduccion(nullptr)
+  , fReproduciendo(false)
+  , instanteReproduccion(0)
 {
     ui->setupUi(this);                // Conecta la clase con su interfaz gráfico.
     setWindowTitle(tr("Simulador de vuelo (2020/2021)")); // Título de la ventana
@@ -43,12 +75,17 @@ GUIPanel::GUIPanel(QWidget *parent) :  // Constructor de la clase
     // Conexion por el puerto serie-USB
     fConnected=false;                 // Todavía no hemos establecido la conexión USB
     ui->serialPortComboBox->clear(); // Vacía de componentes la comboBox
-    foreach (const QSerialPortInfo &info, QSerialPortInfo::availablePorts())
-        // La identificación nos permite que SOLO aparezcan los interfaces tipo USB serial de Texas Instrument
-        if ((info.vendorIdentifier()==0x1CBE) && (info.productIdentifier()==0x0002))
-        {
-            ui->serialPortComboBox->addItem(info.portName());
-        }
+    // La enumeración de puertos (QSerialPortInfo::availablePorts()) es lenta, ya que recorre sysfs/udev; se lanza en
+    // un hilo aparte y la comboBox se rellena cuando termina (puertosEnumerados), sin retrasar la apertura de la ventana
+    fEnumeracionPendiente=false;
+    connect(&enumeradorPuertos, SIGNAL(finished()), this, SLOT(puertosEnumerados()));
+    // Los eventos de conexión/desconexión llegan a rafagas; el temporizador agrupa todos en una sola enumeración
+    temporizadorPuertos = new QTimer(this);
+    temporizadorPuertos->setSingleShot(true);
+    temporizadorPuertos->setInterval(250);
+    connect(temporizadorPuertos, SIGNAL(timeout()), this, SLOT(actualizarPuertos()));
+    initMonitorUdev(); // Detección en caliente de puertos que se conecten más tarde
+    actualizarPuertos();
     ui->serialPortComboBox->setFocus();   // Componente del GUI seleccionado de inicio
     // Las funciones CONNECT son la base del funcionamiento de QT; conectan dos componentes
     // o elementos del sistema; uno que GENERA UNA SEÑAL; y otro que EJECUTA UNA FUNCION (SLOT) al recibir dicha señal.
@@ -69,12 +106,9 @@ GUIPanel::GUIPanel(QWidget *parent) :  // Constructor de la clase
     ventanaPopUp.setWindowTitle(tr("Evento"));
     ventanaPopUp.setParent(this,Qt::Popup);
 
-    // Inicializa componentes para los controles y mandos
-    initPitchCompass(); // Pinta y configura el componente del control de angulo de ataque (Pitch)
-    initRuedaVelocidad(); // Inicializacion para "tunear" la esfera
-    initReloj(); // Iniciamos el reloj
-    initDeposito(); // Iniciamos el deposito
-    initPanelAltitud();
+    // Los componentes de los controles y mandos (escalas Qwt) se configuran al mostrarse la ventana por primera
+    // vez (ver showEvent), para que el primer frame aparezca cuanto antes
+    fIndicadoresIniciados=false;
 
     // Configura otros controles e indicadores del GUI
 
@@ -83,232 +117,889 @@ GUIPanel::GUIPanel(QWidget *parent) :  // Constructor de la clase
     disableWidgets();
     originalPixmap=(QPixmap) *(ui->drone->pixmap());
 
-    ui->ControlVelocidad->setSingleSteps(2); // Tiene que ser divisor del "factor de inercia" (para que no hay oscilacion)
-    ui->ControlVelocidad->setTotalSteps(ui->RuedaVelocidad->upperBound()/2); // Para que haya una coincidencia de escalas en el dial y el Slider
-
     // Inicializacion de la variable del timer para el ajuste retardado de velocidad
     VelocidadTimer = new QTimer(this);
     VelocidadTimer->connect(VelocidadTimer, SIGNAL(timeout()), this, SLOT(changeValue()));
+    timerPitch = nullptr;   // Se crea al agotarse el combustible
 
     //Inicialización de variables auxiliares
     valor_pitch1 = 0;
     valor_pitch2 = 0;
+    for (int e=0;e<NUM_EJES;e++) actitudMostrada[e]=HUGE_VALF;  // Fuerza el primer repintado
+    pitchDron = 0;
+    loteActitud.reserve(64);
+
+    // Sincronizacion del reloj de la TIVA: se repite periodicamente mientras el vuelo esta en marcha
+    temporizadorSincronizacion = new QTimer(this);
+    temporizadorSincronizacion->setInterval(5000);
+    connect(temporizadorSincronizacion, SIGNAL(timeout()), this, SLOT(enviarSincronizacion()));
+    latenciaMedia = 0;
+    reiniciarInstantes();
+
+    // Hasta que la TIVA confirme otra cosa, los mensajes van con la codificacion normal. La que se pide
+    // (fCodificacionCompacta) la fija main.cpp con --codificacion
+    fCodificacionCompacta = false;
+    codificacion = CODIFICACION_NORMAL;
+
+    // Plazos de las peticiones con respuesta: solo se revisan mientras hay alguna en curso (ver escribirTrama)
+    temporizadorEnlace = new QTimer(this);
+    temporizadorEnlace->setInterval(10);
+    connect(temporizadorEnlace, SIGNAL(timeout()), this, SLOT(revisarEnlace()));
+
+    // Suscripcion a los canales: se revisa periodicamente mientras el vuelo esta en marcha, asi sigue a los
+    // indicadores que se habilitan, se ocultan o se minimizan sin tener que engancharse a cada caso
+    temporizadorSuscripcion = new QTimer(this);
+    temporizadorSuscripcion->setInterval(500);
+    connect(temporizadorSuscripcion, SIGNAL(timeout()), this, SLOT(revisarSuscripcion()));
+
+    // Prueba del enlace: las tramas se generan a medida que QSerialPort las va escribiendo
+    pruebaEnlace = nullptr;
+    temporizadorPrueba = new QTimer(this);
+    temporizadorPrueba->setInterval(1);
+    temporizadorPrueba->setTimerType(Qt::PreciseTimer);
+    connect(temporizadorPrueba, SIGNAL(timeout()), this, SLOT(alimentarPrueba()));
+    connect(&serial, SIGNAL(bytesWritten(qint64)), this, SLOT(alimentarPrueba()));
+    QShortcut *atajoPrueba = new QShortcut(QKeySequence(tr("Ctrl+Shift+B")), this);
+    connect(atajoPrueba, SIGNAL(activated()), this, SLOT(iniciarPruebaEnlace()));
+
+    // Caja negra: siempre grabando en memoria; se vuelca con las alarmas que lo piden (colision, sin combustible)
+    // o a mano con Ctrl+Shift+N
+    temporizadorCajaNegra = new QTimer(this);
+    temporizadorCajaNegra->setInterval(250);
+    connect(temporizadorCajaNegra, SIGNAL(timeout()), this, SLOT(revisarCajaNegra()));
+    temporizadorCajaNegra->start();
+    QShortcut *atajoCajaNegra = new QShortcut(QKeySequence(tr("Ctrl+Shift+N")), this);
+    connect(atajoCajaNegra, SIGNAL(activated()), this, SLOT(volcarCajaNegra()));
+
+    // Alarmas: las reglas por defecto reproducen el bloqueo de la velocidad y el picado al quedarse sin
+    // combustible, y el cristal roto de la colision
+    alarmas.cargar(MotorAlarmas::REGLAS_POR_DEFECTO);
 
     //Ocultamos el cristal roto
     ui->CristalRoto->setVisible(false);
 
+    relojVuelo.start(); // Origen de tiempos de las graficas de tendencia
+
+    memset(&estadoCompartido,0,sizeof(estadoCompartido));
+
 }
 
 GUIPanel::~GUIPanel() // Destructor de la clase
 {
+    enumeradorPuertos.waitForFinished(); // No se puede destruir el objeto con la enumeración en curso
+    delete pruebaEnlace;
+    shm_telemetria_cerrar(shmTelemetria);
+#ifdef Q_OS_LINUX
+    if (udevSocket>=0) ::close(udevSocket);
+#endif
     delete ui;   // Borra el interfaz gráfico asociado a la clase
 }
 
-void GUIPanel::readRequest()
+// La primera vez que se muestra la ventana se programa la inicialización de los indicadores. Se hace mediante
+// un singleShot(0) para que se ejecute después de pintar el primer frame (los widgets están deshabilitados hasta
+// pulsar RUN, así que no se nota que las escalas aún no estén configuradas)
+void GUIPanel::showEvent(QShowEvent *event)
 {
-    int StopCharPosition,StartCharPosition,tam;   // Solo uso notacin hungara en los elementos que se van a
-    // intercambiar con el micro - para control de tamaño -
-    uint8_t *pui8Frame; // Puntero a zona de memoria donde reside la trama recibida
-    void *ptrtoparam;
-    uint8_t ui8Message; // Para almacenar el mensaje de la trama entrante
+    QWidget::showEvent(event);
+    if (!fIndicadoresIniciados)
+        QTimer::singleShot(0, this, SLOT(initIndicadores()));
+}
 
+// Inicializa componentes para los controles y mandos. Solo se ejecuta una vez
+void GUIPanel::initIndicadores()
+{
+    if (fIndicadoresIniciados) return;
+    fIndicadoresIniciados=true;
 
-    incommingDataBuffer.append(serial.readAll()); // Añade el contenido del puerto serie USB al array de bytes 'incommingDataBuffer'
-    // así vamos acumulando  en el array la información que va llegando
+    initPitchCompass(); // Pinta y configura el componente del control de angulo de ataque (Pitch)
+    initRuedaVelocidad(); // Inicializacion para "tunear" la esfera
+    initReloj(); // Iniciamos el reloj
+    initDeposito(); // Iniciamos el deposito
+    initPanelAltitud();
+
+    ui->ControlVelocidad->setSingleSteps(2); // Tiene que ser divisor del "factor de inercia" (para que no hay oscilacion)
+    ui->ControlVelocidad->setTotalSteps(ui->RuedaVelocidad->upperBound()/2); // Para que haya una coincidencia de escalas en el dial y el Slider
+}
+
+// Enumera los puertos serie disponibles en un hilo del pool global de Qt. Si ya hay una enumeración en curso,
+// se marca como pendiente y se repite al terminar, para no perder conexiones que ocurran mientras tanto
+static QList<QSerialPortInfo> enumerarPuertos()
+{
+    return QSerialPortInfo::availablePorts();
+}
 
-    // Busca la posición del primer byte de fin de trama (0xFD) en el array. Si no estuviera presente,
-    // salimos de la funcion, en caso contrario, es que ha llegado al menos una trama.
-    // Hay que tener en cuenta que pueden haber llegado varios paquetes juntos.
-    StopCharPosition=incommingDataBuffer.indexOf((char)STOP_FRAME_CHAR,0);
-    while (StopCharPosition>=0)
+void GUIPanel::actualizarPuertos()
+{
+    if (enumeradorPuertos.isRunning())
     {
-        //Ahora buscamos el caracter de inicio correspondiente.
-        StartCharPosition=incommingDataBuffer.lastIndexOf((char)START_FRAME_CHAR,0); //Este seria el primer caracter de inicio que va delante...
+        fEnumeracionPendiente=true;
+        return;
+    }
+    enumeradorPuertos.setFuture(QtConcurrent::run(enumerarPuertos));
+}
 
-        if (StartCharPosition<0)
-        {
-            //En caso de que no lo encuentre, no debo de hacer nada, pero debo vaciar las primeras posiciones hasta STOP_FRAME_CHAR (inclusive)
-            incommingDataBuffer.remove(0,StopCharPosition+1);
-            LastError=QString("Status:Fallo trozo paquete recibido");
-        } else
+// Slot que se ejecuta (en el hilo del GUI) al terminar la enumeración. Actualiza la comboBox conservando
+// el puerto seleccionado si sigue presente
+void GUIPanel::puertosEnumerados()
+{
+    QString seleccionado=ui->serialPortComboBox->currentText();
+    QStringList puertos;
+
+    foreach (const QSerialPortInfo &info, enumeradorPuertos.result())
+        // La identificación nos permite que SOLO aparezcan los interfaces tipo USB serial de Texas Instrument
+        if ((info.vendorIdentifier()==0x1CBE) && (info.productIdentifier()==0x0002))
         {
-            incommingDataBuffer.remove(0,StartCharPosition); //Si hay datos anteriores al caracter de inicio, son un trozo de trama incompleto. Los tiro.
-            tam=StopCharPosition-StartCharPosition+1;//El tamanio de la trama es el numero de bytes desde inicio hasta fin, ambos inclusive.
-            if (tam>=MINIMUM_FRAME_SIZE)
-            {
-                pui8Frame=(uint8_t*)incommingDataBuffer.data(); // Puntero de trama al inicio del array de bytes
-                pui8Frame++; //Nos saltamos el caracter de inicio.
-                tam-=2; //Descontamos los bytes de inicio y fin del tamanio del paquete
-
-                // Paso 1: Destuffing y cálculo del CRC. Si todo va bien, obtengo la trama
-                // con valores actualizados y sin bytes de CRC.
-                tam=destuff_and_check_checksum((unsigned char *)pui8Frame,tam);
-                if (tam>=0)
-                {
-                    //El paquete está bien, luego procedo a tratarlo.
-                    ui8Message=decode_message_type(pui8Frame); // Obtencion del byte de Mensaje
-                    tam=get_message_param_pointer(pui8Frame,tam,&ptrtoparam);
-                    switch(ui8Message) // Segun el mensaje tengo que hacer cosas distintas
-                    {
-                    /* A PARTIR AQUI ES DONDE SE DEBEN AÑADIR NUEVAS RESPUESTAS ANTE LOS MENSAJES QUE SE ENVIEN DESDE LA TIVA */
-                    case MENSAJE_PING:  // Algunos mensajes no tiene parametros
-                        // Crea una ventana popup con el texto indicado
-                        pingResponseReceived();
-                        break;
+            puertos.append(info.portName());
+        }
+
+    // Si no ha cambiado nada no se toca la comboBox (evita repintados y cambios de seleccion)
+    QStringList actuales;
+    for (int i=0;i<ui->serialPortComboBox->count();i++)
+        actuales.append(ui->serialPortComboBox->itemText(i));
+    if (actuales!=puertos)
+    {
+        ui->serialPortComboBox->clear();
+        ui->serialPortComboBox->addItems(puertos);
+        int indice=ui->serialPortComboBox->findText(seleccionado);
+        if (indice>=0) ui->serialPortComboBox->setCurrentIndex(indice);
+    }
+
+    if (fEnumeracionPendiente)
+    {
+        fEnumeracionPendiente=false;
+        actualizarPuertos();
+    }
+}
+
+// Abre un socket netlink para recibir los eventos de conexión/desconexión de dispositivos (los mismos que usa
+// "udevadm monitor"). Se escucha tanto el grupo del kernel (1) como el de udev (2): el segundo llega cuando el
+// fichero /dev/ttyACMx ya está creado, y el primero sirve en sistemas sin udevd. Si no se puede abrir, la
+// aplicación sigue funcionando con la lista de puertos del arranque.
+void GUIPanel::initMonitorUdev()
+{
+    udevSocket=-1;
+    udevNotifier=nullptr;
+#ifdef Q_OS_LINUX
+    struct sockaddr_nl direccion;
+
+    udevSocket=::socket(AF_NETLINK, SOCK_DGRAM|SOCK_NONBLOCK|SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (udevSocket<0) return;
+
+    memset(&direccion,0,sizeof(direccion));
+    direccion.nl_family=AF_NETLINK;
+    direccion.nl_pid=0;    // El kernel asigna el identificador
+    direccion.nl_groups=1|2;
+    if (::bind(udevSocket,(struct sockaddr *)&direccion,sizeof(direccion))<0)
+    {
+        ::close(udevSocket);
+        udevSocket=-1;
+        return;
+    }
+
+    udevNotifier = new QSocketNotifier(udevSocket, QSocketNotifier::Read, this);
+    connect(udevNotifier, SIGNAL(activated(int)), this, SLOT(eventoUdevRecibido()));
+#endif
+}
+
+// Slot asociado al socket netlink. Vacía todos los eventos pendientes y, si alguno es de la familia tty,
+// programa una nueva enumeración de puertos
+void GUIPanel::eventoUdevRecibido()
+{
+#ifdef Q_OS_LINUX
+    char evento[8192];
+    ssize_t leido;
+    bool fCambioTty=false;
+
+    while ((leido=::recv(udevSocket,evento,sizeof(evento),0))>0)
+    {
+        // Tanto el formato del kernel como el de udev llevan las propiedades como cadenas "CLAVE=valor"
+        // separadas por '\0', por lo que basta con buscar la del subsistema
+        if (memmem(evento,(size_t)leido,"SUBSYSTEM=tty",13)!=nullptr)
+            fCambioTty=true;
+    }
+    if (fCambioTty)
+        temporizadorPuertos->start();
+#endif
+}
+
+void GUIPanel::readRequest()
+{
+    // Lo que se lee de golpe es lo que se ha acumulado desde la lectura anterior: si crece es que el GUI no da
+    // abasto y hay que pedir a la TIVA que reduzca la telemetria
+    TRAZA_SPAN("serie","readRequest");
+    QByteArray datos;
+    {
+        TRAZA_SPAN("serie","readAll");
+        datos=serial.readAll();
+    }
+    uint64_t recepcion=ahoraUs();
+
+    // El fotograma se graba antes que los datos: es el estado del que parten
+    if (grabador.abierto())
+    {
+        if (grabador.tocaFotograma(recepcion)) grabador.anadirFotograma(recepcion, estadoInstrumentos());
+        grabador.anadirDatos(recepcion, (const uint8_t *)datos.constData(), (size_t)datos.size());
+    }
+    if (cajaNegra.tocaFotograma(recepcion)) cajaNegra.anadirFotograma(recepcion, estadoInstrumentos());
+    cajaNegra.anadirDatos(recepcion, (const uint8_t *)datos.constData(), (size_t)datos.size());
+    recibirDatos(datos, recepcion);
+    revisarFlujo((size_t)datos.size()+decodificador.pendientes());
+}
+
+void GUIPanel::revisarFlujo(size_t ocupacion)
+{
+    if (!controlFlujo.actualizar(ocupacion, relojVuelo.elapsed())) return;
+
+    uint8_t pui8Frame[MAX_FRAME_SIZE];
+    PARAM_MENSAJE_CONTROL_FLUJO parametro=controlFlujo.mensaje();
+    int size=create_frame((uint8_t *)pui8Frame, MENSAJE_CONTROL_FLUJO, &parametro, sizeof(parametro), MAX_FRAME_SIZE);
+    if ((size>0) && serial.isOpen()) serial.write((char *)pui8Frame,size);
+    mostrarEstadoFlujo();
+}
+
+// Muestra el nivel de telemetria pedido y, si no coincide, el que ha confirmado la TIVA
+void GUIPanel::mostrarEstadoFlujo()
+{
+    int pedido=controlFlujo.nivel();
+    int aplicado=controlFlujo.aplicado();
+    QString texto=tr("Flujo: %1").arg(QLatin1String(ControlFlujo::nombreNivel(pedido)));
+
+    if (aplicado!=pedido && (aplicado>=0 || pedido!=FLUJO_NORMAL))
+        texto+=tr(" (TIVA: %1)").arg(aplicado>=0 ? QLatin1String(ControlFlujo::nombreNivel(aplicado)) : QLatin1String("sin respuesta"));
+    ui->flujoLabel->setText(texto);
+    ui->flujoLabel->setStyleSheet(pedido==FLUJO_NORMAL ? QString() : QString("color: darkorange"));
+
+    const EstadisticasCola &cola=colaMensajes.estadisticas();
+    ui->flujoLabel->setToolTip(tr("Tasa de telemetria pedida al avion (control de flujo)\n"
+                                  "Muestras periodicas descartadas: %1 sustituidas, %2 anteriores a un evento critico\n"
+                                  "Eventos criticos adelantados: %3")
+                               .arg(cola.colapsados).arg(cola.obsoletos).arg(cola.adelantados)
+                               + (sincronizacion.sincronizado()
+                                  ? tr("\nReloj TIVA: desfase %1 ms, deriva %2 ppm, ida y vuelta %3 ms, latencia media %4 ms")
+                                    .arg(sincronizacion.desfase(ahoraUs())/1000.0,0,'f',1)
+                                    .arg(sincronizacion.deriva(),0,'f',1)
+                                    .arg(sincronizacion.retardo()/1000.0,0,'f',1)
+                                    .arg(latenciaMedia/1000.0,0,'f',1)
+                                  : tr("\nReloj TIVA sin sincronizar"))
+                               + tr("\nCodificacion: %1").arg(codificacion==CODIFICACION_COMPACTA ? tr("compacta") : tr("normal"))
+                               + tr("\nEnlace: %1 tramas, %2 errores de CRC, %3 trozos descartados")
+                                 .arg(decodificador.estadisticas().tramas).arg(decodificador.estadisticas().erroresCrc)
+                                 .arg(decodificador.estadisticas().fragmentos)
+                               + tr("\nCanales: %1").arg(descripcionSuscripcion()));
+}
+
+// Periodo que ha confirmado la TIVA para cada canal ("-" si no se envia, "normal" a su tasa de siempre)
+QString GUIPanel::descripcionSuscripcion() const
+{
+    if (!suscripciones.soportada()) return tr("todos (la TIVA no admite suscripcion)");
+
+    QStringList canales;
+    for (int c=0;c<NUM_CANALES_SUSCRIPCION;c++)
+    {
+        int periodo=suscripciones.aplicado(c);
+        QString valor = (periodo<0) ? tr("?")
+                      : (periodo==PERIODO_DESACTIVADO) ? tr("-")
+                      : (periodo==PERIODO_TASA_NORMAL) ? tr("normal")
+                      : tr("%1 ms").arg(periodo);
+        canales << QLatin1String(Suscripciones::nombreCanal(c))+QLatin1String(" ")+valor;
+    }
+    return canales.join(QLatin1String(", "));
+}
+
+void GUIPanel::recibirDatos(const QByteArray &datos)
+{
+    recibirDatos(datos, ahoraUs());
+}
+
+void GUIPanel::recibirDatos(const QByteArray &datos, uint64_t recepcion)
+{
+    // El decodificador acumula los bytes que van llegando (pueden haber llegado varios paquetes juntos, o un
+    // trozo de paquete) y deja en la cola cada trama completa, ya sin stuffing y con el CRC comprobado
+    // Cada mensaje se marca con su instante en la base de tiempos del PC y se registra antes de encolarlo
+    {
+        TRAZA_SPAN("decodificacion","reensamblado");
+        decodificador.anadir((const uint8_t *)datos.constData(),(size_t)datos.size(),
+                             [this,recepcion](const MensajeDecodificado &mensaje) {
+            MensajeDecodificado marcado=mensaje;
+            marcado.instante=instanteMuestra(mensaje, recepcion);
+            registrarMensaje(marcado);
+            colaMensajes.encolar(marcado);
+        });
+    }
+
+    // Despues se muestran por prioridades: los eventos criticos primero, aunque hayan llegado detras de muchas
+    // muestras periodicas, y si hay retraso solo la ultima muestra de cada tipo periodico
+    uint64_t descartadosAntes=colaMensajes.estadisticas().colapsados+colaMensajes.estadisticas().obsoletos;
+    {
+        TRAZA_SPAN("despacho","despachar");
+        colaMensajes.despachar([this](const MensajeDecodificado &mensaje) { procesarMensaje(mensaje); });
+    }
+    if (colaMensajes.estadisticas().colapsados+colaMensajes.estadisticas().obsoletos!=descartadosAntes)
+        mostrarEstadoFlujo();
+
+    // Las corrutinas que esperaban alguna de las respuestas siguen ahora, con el despacho ya terminado
+    enlace.reanudar();
 
-                    case MENSAJE_POTENCIOMETRO:
-                    {
-                        PARAM_MENSAJE_POTENCIOMETRO giro;
-                        if (check_and_extract_message_param(ptrtoparam, tam, sizeof(giro),&giro)>0)
-                        {
-                            giro.roll = giro.roll & 0xFFF;
-                            giro.pitch = giro.pitch & 0xFFF;
-                            giro.yaw = giro.yaw & 0xFFF;
+    // Los potenciometros se filtran todos juntos al final de la lectura y los indicadores se pintan una sola vez
+    if (!loteActitud.empty())
+    {
+        TRAZA_SPAN("despacho","actitud");
+        filtroActitud.procesar(loteActitud.data(),loteActitud.size());
+        loteActitud.clear();
+        actualizarActitud();
+        alimentarAlarma(CANAL_ROLL, recepcion/1e6, filtroActitud.grados(EJE_ROLL));
+        alimentarAlarma(CANAL_PITCH, recepcion/1e6, filtroActitud.grados(EJE_PITCH));
+        alimentarAlarma(CANAL_YAW, recepcion/1e6, filtroActitud.grados(EJE_YAW));
+    }
+}
 
-                            // Configuracion del yaw a nivel visual
-                            ui->ElementoYaw->setHeading((float)convertScale((unsigned)giro.yaw,0,360)-180);
-                            ui->ElementoYaw->update();
+// Microsegundos desde el arranque del panel (base de tiempos de los historiales y de la sincronizacion)
+uint64_t GUIPanel::ahoraUs() const
+{
+    return (uint64_t)(relojVuelo.nsecsElapsed()/1000);
+}
 
-                            // Configuracion del roll a nivel visual ( se pone el pitch porque el elemento permite ambos)
-                            ui->ElementoRoll->setRoll(convertScale((unsigned)giro.roll,0,360)-180);
+// Instante al que corresponden las muestras que se anotan ahora en los historiales: el actual, o el de la grabacion
+// si se esta reproduciendo un vuelo
+uint64_t GUIPanel::instanteActual() const
+{
+    return fReproduciendo ? instanteReproduccion : ahoraUs();
+}
 
-                            // Configuracion del pitch a nivel visual
-                            ui->drone->setPixmap(rotatePixmap(*(ui->drone->pixmap()),convertScale((unsigned)giro.pitch,0,180)-90));
-                            ui->ElementoRoll->setPitch(-convertScale((unsigned)giro.pitch,0,180)+90);
-                            ui->ElementoRoll->update();
-                            valor_pitch1 = convertScale((unsigned)giro.pitch,0,180)-90;
-                            valor_pitch2 = -convertScale((unsigned)giro.pitch,0,180)+90;
+// Instante de una muestra en la base de tiempos del PC: si el mensaje trae marca de tiempo y el reloj de la TIVA
+// esta sincronizado se usa la marca (instante en que se tomo la muestra), si no el de recepcion.
+// Los historiales y las ventanas de las alarmas necesitan instantes crecientes en cada canal, y al sincronizar (la
+// marca es anterior a la recepcion en lo que tarda el enlace) o al reajustar la deriva pueden ir hacia atras: en
+// ese caso se repite el ultimo, como en CajaNegra::anadir
+int64_t GUIPanel::instanteMuestra(const MensajeDecodificado &mensaje, uint64_t recepcion)
+{
+    // La respuesta de sincronizacion necesita el instante real de recepcion (t4): pasarla por la estimacion que
+    // ella misma corrige realimentaria el desfase, el retardo y latenciaMedia
+    if (mensaje.error || mensaje.tipo==MENSAJE_SINCRONIZACION) return (int64_t)recepcion;
 
-                        }
-                    }
-                        break;
-                    case MENSAJE_RELOJ:
-                    {
-                        PARAM_MENSAJE_RELOJ valor_reloj;
-                        if (check_and_extract_message_param(ptrtoparam, tam, sizeof(valor_reloj),&valor_reloj.reloj)>0)
-                        {
-                            ui->Reloj->setValue((double)valor_reloj.reloj*60.0); //Se actualiza el reloj moviendose cada segundo como si pasara una min
-                        }
-                    }
-                        break;
-
-                    case MENSAJE_COMBUSTIBLE:
-                    {
-
-                        PARAM_MENSAJE_COMBUSTIBLE combustible_restante;
-                        if (check_and_extract_message_param(ptrtoparam, tam, sizeof(combustible_restante),&combustible_restante.combustible)>0){
-
-                            if(combustible_restante.combustible > 0){
-
-                                ui->Deposito->setValue(combustible_restante.combustible); //Actualización del depósito
-
-                            }else{
-
-                                ui->Deposito->setValue(0.0); //Si no hay combustible, ponemos el depósito a 0
-
-                                // Deshabilitamos la palanca de control de velocidad
-                                ui->ControlVelocidad->setDisabled(true);
-
-                                VelocidadTimer->stop();
-                                ui->RuedaVelocidad->setValue(0); //Ponemos el velocímetro a 0
-
-                                timerPitch = new QTimer(this);
-                                connect(timerPitch, SIGNAL(timeout()), this, SLOT(disminucionPitch()));
-                                timerPitch->start(50);
-
-                            }
-                        }
-
-                    }
-                        break;
-
-                    case MENSAJE_ALTURA:
-                    {
-
-                        PARAM_MENSAJE_ALTURA altitud;
-                        if (check_and_extract_message_param(ptrtoparam, tam, sizeof(altitud),&altitud.altura)>0){
-
-                                ui->PanelAltitud->setValue((int)altitud.altura); //Actualizamos el valor de la altura
-
-                        }
-
-                    }
-
-                        break;
-
-                    case MENSAJE_COLISION:
-                    {
-
-                               ui->PanelAltitud->setValue(0); //Ponemos el altímetro a 0
-                               ui->CristalRoto->setVisible(true); //Mostramos la imagen del cristal roto
-                               disableWidgets(); //Deshabilitamos los widgets
-                               ui->groupBox->setEnabled(false); //Deshabilitamos los widgets del groupbox
-
-
-                    }
-                        break;
-
-                    case MENSAJE_MSG_RADIO:
-                    {
+    int64_t instante=(int64_t)recepcion;
+    if (mensaje.tieneMarca && sincronizacion.sincronizado())
+    {
+        instante=sincronizacion.aHost(sincronizacion.desenrollar(mensaje.marcaDispositivo, recepcion));
+        if (instante>(int64_t)recepcion) instante=(int64_t)recepcion;   // Error de la estimacion
+        latenciaMedia+=0.05*((double)((int64_t)recepcion-instante)-latenciaMedia);
+    }
+    if (instante<ultimoInstante[mensaje.tipo]) instante=ultimoInstante[mensaje.tipo];
+    ultimoInstante[mensaje.tipo]=instante;
+    return instante;
+}
 
-                        PARAM_MENSAJE_MSG_RADIO mensaje_radio;
+// Al empezar un vuelo o al cambiar de posicion en una grabacion los instantes vuelven a empezar
+void GUIPanel::reiniciarInstantes()
+{
+    for (int i=0;i<256;i++) ultimoInstante[i]=INT64_MIN;
+}
 
-                        if (check_and_extract_message_param(ptrtoparam, tam, sizeof(mensaje_radio),&mensaje_radio.caracteres)>0){
+void GUIPanel::enviarSincronizacion()
+{
+    uint8_t pui8Frame[MAX_FRAME_SIZE];
+    uint64_t ahora=ahoraUs();
+    PARAM_MENSAJE_SINCRONIZACION parametro=sincronizacion.peticion(ahora);
+    int size=create_frame((uint8_t *)pui8Frame, MENSAJE_SINCRONIZACION, &parametro, sizeof(parametro), MAX_FRAME_SIZE);
+    if ((size>0) && serial.isOpen()) serial.write((char *)pui8Frame,size);
+
+    // La respuesta queda grabada con los datos; sin la peticion no se podria emparejar al reproducir, y las
+    // muestras perderian su marca de tiempo
+    grabador.anadirSincronizacion(ahora, parametro.secuencia, parametro.t1);
+    cajaNegra.anadirSincronizacion(ahora, parametro.secuencia, parametro.t1);
+}
 
-                                ui->statusLabel->setText(tr(mensaje_radio.caracteres)); //Se muestra el mensaje enviado por el interfaz
+// Escritura de las peticiones del enlace; arranca la revision de plazos
+bool GUIPanel::escribirTrama(const uint8_t *trama, size_t tam)
+{
+    if (!fConnected || !serial.isOpen()) return false;
+    if (serial.write((const char *)trama, (qint64)tam)!=(qint64)tam) return false;
+    if (!temporizadorEnlace->isActive()) temporizadorEnlace->start();
+    return true;
+}
 
-                        }
+void GUIPanel::revisarEnlace()
+{
+    enlace.revisarPlazos();
+    enlace.reanudar();
+    if (!enlace.pendientes()) temporizadorEnlace->stop();
+}
 
-                    }
+void GUIPanel::activarTraza(const QString &fichero)
+{
+    ficheroTraza=fichero;
+    Traza::nombrarHilo("GUI");
 
-                        break;
+    // Cada widget se registra con su nombre (o el de su padre, para los que no tienen) y se filtran sus eventos
+    // de pintado para medirlos
+    foreach (QWidget *w, findChildren<QWidget *>())
+    {
+        QString nombre=w->objectName();
+        if (nombre.isEmpty() && w->parent())
+            nombre=w->parent()->objectName()+QStringLiteral("/")+QString::fromLatin1(w->metaObject()->className());
+        nombresTraza.insert(w, Traza::internar(nombre.toUtf8().constData()));
+        w->installEventFilter(this);
+    }
+    nombresTraza.insert(this, Traza::internar("GUIPanel"));
+    installEventFilter(this);
 
-                    case MENSAJE_NO_IMPLEMENTADO:
-                    {
-                        // En otros mensajes hay que extraer los parametros de la trama y copiarlos
-                        // a una estructura para poder procesar su informacion
-                        PARAM_MENSAJE_NO_IMPLEMENTADO parametro;
-                        if (check_and_extract_message_param(ptrtoparam, tam, sizeof(parametro),&parametro)>0)
-                        {
-                            // Muestra en una etiqueta (statuslabel) del GUI el mensaje
-                            ui->statusLabel->setText(tr("  Mensaje rechazado,"));
-                        }
-                        else
-                        {
-                            // TRATAMIENTO DE ERRORES
-                        }
-                    }
-                        break;
+    QShortcut *atajo = new QShortcut(QKeySequence(tr("Ctrl+Shift+T")), this);
+    connect(atajo, SIGNAL(activated()), this, SLOT(volcarTraza()));
+    Traza::activar(true);
+}
 
-                        //Falta por implementar la recepcion de mas tipos de mensajes
-                        //habria que decodificarlos y emitir las señales correspondientes con los parametros que correspondan
+bool GUIPanel::volcarTraza()
+{
+    if (ficheroTraza.isEmpty()) return false;
+    bool ok=Traza::volcar(QFile::encodeName(ficheroTraza).constData());
+    ui->statusLabel->setText(ok ? tr("Traza guardada en %1").arg(ficheroTraza)
+                                : tr("No se puede escribir la traza en %1").arg(ficheroTraza));
+    return ok;
+}
+
+// Solo se instala con la traza activa: el evento de pintado se entrega desde aqui para poder medirlo, y se
+// devuelve true para que Qt no lo entregue otra vez
+bool GUIPanel::eventFilter(QObject *objeto, QEvent *evento)
+{
+    if ((evento->type()!=QEvent::Paint) || !Traza::activada()) return QWidget::eventFilter(objeto, evento);
+
+    SpanTraza span("pintado", nombresTraza.value(objeto, "widget"));
+    objeto->event(evento);
+    return true;
+}
+
+void GUIPanel::setCalibracion(EjeActitud eje, const CalibracionEje &cal)
+{
+    filtroActitud.setCalibracion(eje,cal);
+}
+
+void GUIPanel::setSuavizadoActitud(float alfa)
+{
+    filtroActitud.setSuavizado(alfa);
+}
+
+bool GUIPanel::cargarAlarmas(const QString &fichero, QString *error)
+{
+    QFile f(fichero);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        if (error) *error=f.errorString();
+        return false;
+    }
+    std::string motivo;
+    bool ok=alarmas.cargar(f.readAll().toStdString(), &motivo);
+    if (!ok && error) *error=QString::fromStdString(motivo);
+    return ok;
+}
+
+void GUIPanel::alimentarAlarma(CanalAlarma canal, double t, double valor)
+{
+    alarmas.muestra(canal, t, valor, [this](const EventoAlarma &evento) { ejecutarAlarma(evento); });
+}
 
-                    default:
-                        //Este error lo notifico mediante la señal statusChanged
-                        LastError=QString("Status: Recibido paquete inesperado");
-                        ui->statusLabel->setText(tr("  Recibido paquete inesperado,"));
-                        break;
-                    }
-                }
-                else
-                {
-                    LastError=QString("Status: Error de stuffing o CRC");
-                    ui->statusLabel->setText(tr(" Error de stuffing o CRC"));
-                 }
+// Acciones de las reglas de alarma al activarse (y al desactivarse, las que tienen vuelta atras)
+void GUIPanel::ejecutarAlarma(const EventoAlarma &evento)
+{
+    for (const std::string &accion : alarmas.acciones(evento.regla))
+    {
+        if (accion=="bloquear_velocidad")
+        {
+            // Palanca de control de velocidad deshabilitada y velocimetro a 0
+            if (evento.activa)
+            {
+                ui->ControlVelocidad->setDisabled(true);
+                VelocidadTimer->stop();
+                ui->RuedaVelocidad->setValue(0);
+            }
+            else if (!velocidadBloqueada())
+            {
+                // Solo si ninguna otra regla la mantiene bloqueada (tras una colision no se recupera)
+                ui->ControlVelocidad->setDisabled(false);
+                VelocidadTimer->start(50);
             }
-            else
+        }
+        else if (accion=="picado")
+        {
+            // El avion va bajando el morro (ver disminucionPitch)
+            if (!timerPitch)
             {
+                timerPitch = new QTimer(this);
+                connect(timerPitch, SIGNAL(timeout()), this, SLOT(disminucionPitch()));
+            }
+            if (!evento.activa) timerPitch->stop();
+            else if (!timerPitch->isActive()) timerPitch->start(50);
+        }
+        else if (accion=="colision")
+        {
+            if (!evento.activa) continue;
+            ui->PanelAltitud->setValue(0); //Ponemos el altímetro a 0
+            ui->CristalRoto->setVisible(true); //Mostramos la imagen del cristal roto
+            disableWidgets(); //Deshabilitamos los widgets
+            ui->groupBox->setEnabled(false); //Deshabilitamos los widgets del groupbox
+        }
+        else if (accion=="caja_negra")
+        {
+            // Un vuelo reproducido ya esta grabado
+            if (evento.activa && !fReproduciendo) dispararCajaNegra(alarmas.nombre(evento.regla));
+        }
+        else if (evento.activa)
+        {
+            // "aviso" (o una accion que el panel no conoce): se muestra en la etiqueta de estado
+            ui->statusLabel->setText(tr("ALARMA: %1 (%2)").arg(QString::fromStdString(alarmas.nombre(evento.regla)))
+                                     .arg(evento.valor,0,'f',1));
+        }
+    }
+}
 
-                // B. La trama no está completa o no tiene el tamano adecuado... no lo procesa
-                //Este error lo notifico mediante la señal statusChanged
-                LastError=QString("Status: Error trozo paquete recibido");
-                ui->statusLabel->setText(tr(" Fallo trozo paquete recibido"));
+// true si sigue activa alguna regla que bloquea el control de velocidad (bloquear_velocidad o colision)
+bool GUIPanel::velocidadBloqueada() const
+{
+    for (int r=0;r<alarmas.numReglas();r++)
+    {
+        if (!alarmas.activa(r)) continue;
+        for (const std::string &accion : alarmas.acciones(r))
+            if ((accion=="bloquear_velocidad")||(accion=="colision")) return true;
+    }
+    return false;
+}
+
+// Lleva la actitud filtrada a los indicadores. Solo se repinta lo que ha cambiado mas que la banda muerta, para
+// que el ruido del ADC no provoque repintados continuos
+void GUIPanel::actualizarActitud()
+{
+    float roll=filtroActitud.grados(EJE_ROLL);
+    float pitch=filtroActitud.grados(EJE_PITCH);
+    float yaw=filtroActitud.grados(EJE_YAW);
+
+    // Configuracion del yaw a nivel visual
+    if (fabsf(yaw-actitudMostrada[EJE_YAW])>=BANDA_MUERTA_GRADOS)
+    {
+        actitudMostrada[EJE_YAW]=yaw;
+        ui->ElementoYaw->setHeading(yaw);
+        ui->ElementoYaw->update();
+    }
+
+    // Configuracion del roll y del pitch a nivel visual (el elemento permite ambos)
+    bool cambioRoll=(fabsf(roll-actitudMostrada[EJE_ROLL])>=BANDA_MUERTA_GRADOS);
+    bool cambioPitch=(fabsf(pitch-actitudMostrada[EJE_PITCH])>=BANDA_MUERTA_GRADOS);
+    if (cambioRoll)
+    {
+        actitudMostrada[EJE_ROLL]=roll;
+        ui->ElementoRoll->setRoll(roll);
+    }
+    if (cambioPitch)
+    {
+        actitudMostrada[EJE_PITCH]=pitch;
+        ui->ElementoRoll->setPitch(-pitch);
+
+        // Girar la imagen del avion es lo mas caro: solo cuando cambia el angulo entero
+        if ((int)pitch!=pitchDron)
+        {
+            pitchDron=(int)pitch;
+            ui->drone->setPixmap(rotatePixmap(*(ui->drone->pixmap()),pitchDron));
+        }
+        valor_pitch1 = (int)pitch;
+        valor_pitch2 = -(int)pitch;
+    }
+    if (cambioRoll || cambioPitch) ui->ElementoRoll->update();
+}
+
+void GUIPanel::setPublicadorMqtt(PublicadorMqtt *publicador)
+{
+    publicadorMqtt=publicador;
+}
+
+bool GUIPanel::activarMemoriaCompartida(const char *nombre)
+{
+    shm_telemetria_cerrar(shmTelemetria);
+    shmTelemetria=shm_telemetria_crear(nombre);
+    return shmTelemetria!=nullptr;
+}
+
+// Lleva el mensaje a la copia local del estado y, si esta activa, la publica en memoria compartida. Publicar es
+// una copia de unos 100 bytes sin llamadas al sistema, asi que se hace con cada mensaje. La copia local se
+// mantiene siempre, porque de ella salen tambien los fotogramas de la grabacion
+void GUIPanel::actualizarEstadoCompartido(const MensajeDecodificado &mensaje)
+{
+    estado_telemetria_t &e=estadoCompartido;
+
+    e.mensajes=decodificador.estadisticas().tramas;
+    e.errores_crc=decodificador.estadisticas().erroresCrc;
+
+    if (!mensaje.error && mensaje.parametroValido)
+    {
+        switch (mensaje.tipo)
+        {
+        case MENSAJE_POTENCIOMETRO:
+        {
+            VistaPotenciometro giro=mensaje.vista<VistaPotenciometro>();
+            e.roll=giro.roll() & 0xFFF;
+            e.pitch=giro.pitch() & 0xFFF;
+            e.yaw=giro.yaw() & 0xFFF;
+        }
+            break;
+        case MENSAJE_RELOJ:
+            e.reloj=mensaje.vista<VistaReloj>().reloj();
+            break;
+        case MENSAJE_ALTURA:
+            e.altura=mensaje.vista<VistaAltura>().altura();
+            break;
+        case MENSAJE_COMBUSTIBLE:
+            e.combustible=mensaje.vista<VistaCombustible>().combustible();
+            if ((e.combustible<=0) && !e.sin_combustible)
+            {
+                e.sin_combustible=1;
+                if (shmTelemetria) shm_telemetria_evento(shmTelemetria, MENSAJE_COMBUSTIBLE, nullptr, 0);
             }
-            incommingDataBuffer.remove(0,StopCharPosition-StartCharPosition+1); //Elimino el trozo que ya he procesado
+            break;
+        case MENSAJE_COLISION:
+            e.colision=1;
+            e.altura=0;
+            if (shmTelemetria) shm_telemetria_evento(shmTelemetria, MENSAJE_COLISION, nullptr, 0);
+            break;
+        case MENSAJE_MSG_RADIO:
+        {
+            VistaRadio radio=mensaje.vista<VistaRadio>();
+            uint8_t longitud=(uint8_t)radio.longitud();
+            memcpy(e.radio, radio.texto(), longitud);
+            e.radio[longitud]='\0';
+            if (shmTelemetria) shm_telemetria_evento(shmTelemetria, MENSAJE_MSG_RADIO, radio.texto(), longitud);
+        }
+            break;
+        default:
+            break;
         }
+    }
+    if (shmTelemetria) shm_telemetria_publicar(shmTelemetria, &e);
+}
+
+// Lleva cada mensaje, en el orden de llegada, a lo que tiene que ver todas las muestras: memoria compartida, caja
+// negra, MQTT, historiales y alarmas. Se hace al decodificarlo, antes de la cola de prioridades, que solo decide
+// lo que se pinta y puede descartar muestras periodicas (ver colamensajes.h)
+void GUIPanel::registrarMensaje(const MensajeDecodificado &mensaje)
+{
+    actualizarEstadoCompartido(mensaje);
+    if (mensaje.error) return;
+
+    // Los ecos y resumenes de la prueba del enlace no son telemetria
+    if ((mensaje.tipo==MENSAJE_PRUEBA_ECO)||(mensaje.tipo==MENSAJE_PRUEBA_SUMIDERO)||
+        (mensaje.tipo==MENSAJE_PRUEBA_RESUMEN))
+        return;
+
+    // La caja negra guarda tambien las muestras ya decodificadas, salvo al reproducir (ya estan grabadas)
+    if (!fReproduciendo)
+        cajaNegra.anadirMuestra((uint64_t)mensaje.instante, mensaje.tipo, mensaje.parametro, (size_t)mensaje.tamParametro);
+
+    // La publicacion solo copia el valor al lote del canal; el envio se hace en otro hilo
+    // El instante de la muestra se pasa a UTC a partir del reloj del PC
+    if (publicadorMqtt && !fReproduciendo)
+        publicadorMqtt->publicar(mensaje, QDateTime::currentMSecsSinceEpoch()-((int64_t)ahoraUs()-mensaje.instante)/1000);
+
+    switch (mensaje.tipo)
+    {
+    case MENSAJE_COMBUSTIBLE:
+        if (mensaje.parametroValido)
+        {
+            float combustible_restante=mensaje.vista<VistaCombustible>().combustible();
+            historialDeposito.anadirMuestra(mensaje.instante/1e6, combustible_restante > 0 ? combustible_restante : 0.0f);
+            alimentarAlarma(CANAL_COMBUSTIBLE, mensaje.instante/1e6, combustible_restante);
+        }
+        break;
+    case MENSAJE_ALTURA:
+        if (mensaje.parametroValido)
+        {
+            float altura=mensaje.vista<VistaAltura>().altura();
+            historialAltitud.anadirMuestra(mensaje.instante/1e6, altura);
+            alimentarAlarma(CANAL_ALTURA, mensaje.instante/1e6, altura);
+        }
+        break;
+    case MENSAJE_COLISION:
+        // El cristal roto y el bloqueo de los mandos los hace la alarma 'colision'
+        alimentarAlarma(CANAL_COLISION, mensaje.instante/1e6, 1.0);
+        break;
+    default:
+        break;
+    }
+}
+
+// Actualiza el GUI con un mensaje recibido de la TIVA (ya registrado, ver registrarMensaje)
+void GUIPanel::procesarMensaje(const MensajeDecodificado &mensaje)
+{
+    TRAZA_SPAN("despacho","procesarMensaje");
+
+    if (mensaje.error==PROT_ERROR_BAD_CHECKSUM)
+    {
+        LastError=QString("Status: Error de stuffing o CRC");
+        ui->statusLabel->setText(tr(" Error de stuffing o CRC"));
+        return;
+    }
+    else if (mensaje.error==ERROR_TRAMA_SIN_INICIO)
+    {
+        // Resto de una trama empezada antes: solo se cuenta en las estadisticas del enlace, sin tocar el estado
+        LastError=QString("Status:Fallo trozo paquete recibido");
+        mostrarEstadoFlujo();
+        return;
+    }
+    else if (mensaje.error)
+    {
+        // La trama no está completa o no tiene el tamano adecuado... no lo procesa
+        LastError=QString("Status: Error trozo paquete recibido");
+        ui->statusLabel->setText(tr(" Fallo trozo paquete recibido"));
+        return;
+    }
+
+    // Los ecos y resumenes de la prueba del enlace no son telemetria
+    if (pruebaEnlace && pruebaEnlace->recibir(mensaje, (uint64_t)mensaje.instante)) return;
+
+    // Las respuestas a peticiones del enlace las recibe la corrutina que las espera
+    if (enlace.entregar(mensaje)) return;
+
+    switch(mensaje.tipo) // Segun el mensaje tengo que hacer cosas distintas
+    {
+    /* A PARTIR AQUI ES DONDE SE DEBEN AÑADIR NUEVAS RESPUESTAS ANTE LOS MENSAJES QUE SE ENVIEN DESDE LA TIVA */
+    case MENSAJE_PING:  // Algunos mensajes no tiene parametros
+        // PING que no espera nadie (la respuesta a pingDevice la recibe la propia corrutina)
+        break;
+
+    case MENSAJE_POTENCIOMETRO:
+    {
+        if (mensaje.parametroValido)
+        {
+            // La muestra se guarda en el lote; los indicadores se actualizan al final de la lectura
+            // (ver recibirDatos y actualizarActitud)
+            VistaPotenciometro giro=mensaje.vista<VistaPotenciometro>();
+            MuestraAdc muestra;
+            muestra.eje[EJE_ROLL] = giro.roll() & 0xFFF;
+            muestra.eje[EJE_PITCH] = giro.pitch() & 0xFFF;
+            muestra.eje[EJE_YAW] = giro.yaw() & 0xFFF;
+            loteActitud.push_back(muestra);
+        }
+    }
+        break;
+    case MENSAJE_RELOJ:
+    {
+        if (mensaje.parametroValido)
+        {
+            ui->Reloj->setValue((double)mensaje.vista<VistaReloj>().reloj()*60.0); //Se actualiza el reloj moviendose cada segundo como si pasara una min
+        }
+    }
+        break;
+
+    case MENSAJE_COMBUSTIBLE:
+    {
+
+        if (mensaje.parametroValido){
+
+            float combustible_restante=mensaje.vista<VistaCombustible>().combustible();
+
+            //Actualización del depósito; si no hay combustible, se pone a 0 (el resto lo hace la alarma sin_combustible)
+            ui->Deposito->setValue(combustible_restante > 0 ? combustible_restante : 0.0);
+        }
+
+    }
+        break;
+
+    case MENSAJE_ALTURA:
+    {
+
+        if (mensaje.parametroValido){
+
+                float altura=mensaje.vista<VistaAltura>().altura();
+                ui->PanelAltitud->setValue((int)altura); //Actualizamos el valor de la altura
+
+        }
+
+    }
+
+        break;
+
+    case MENSAJE_COLISION:
+        // El cristal roto y el bloqueo de los mandos los hace la alarma 'colision' (ver registrarMensaje)
+        break;
+
+    case MENSAJE_MSG_RADIO:
+    {
+
+        if (mensaje.parametroValido){
+
+                // El mensaje puede ocupar los 40 caracteres, sin terminador
+                VistaRadio radio=mensaje.vista<VistaRadio>();
+                QString texto=QString::fromLatin1(radio.texto(),(int)radio.longitud());
+                ui->statusLabel->setText(texto); //Se muestra el mensaje enviado por el interfaz
+
+        }
+
+    }
 
-        StopCharPosition=incommingDataBuffer.indexOf((char)STOP_FRAME_CHAR,0); //Compruebo si el se ha recibido alguna trama completa mas. (Para ver si tengo que salir del bucle o no
-    } //Fin del while....
+        break;
+
+    case MENSAJE_CONTROL_FLUJO:
+    {
+        // La TIVA confirma el nivel de telemetria que ha aplicado
+        if (mensaje.parametroValido)
+        {
+            controlFlujo.confirmar(mensaje.vista<VistaControlFlujo>().nivel());
+            mostrarEstadoFlujo();
+        }
+    }
+        break;
+
+    case MENSAJE_SINCRONIZACION:
+    {
+        // Respuesta de la TIVA: el instante del mensaje es el de recepcion (t4), sin la marca (ver instanteMuestra)
+        if (mensaje.parametroValido &&
+            sincronizacion.respuesta(mensaje.vista<VistaSincronizacion>(), (uint64_t)mensaje.instante))
+            mostrarEstadoFlujo();
+    }
+        break;
+
+    case MENSAJE_CODIFICACION:
+    {
+        // La TIVA ha cambiado de codificacion por su cuenta (la respuesta a la peticion la recibe negociarCodificacion)
+        if (mensaje.parametroValido)
+        {
+            codificacion=mensaje.vista<VistaCodificacion>().codificacion();
+            mostrarEstadoFlujo();
+        }
+    }
+        break;
+
+    case MENSAJE_SUSCRIPCION:
+    {
+        // La TIVA ha cambiado los canales por su cuenta (la respuesta a la peticion la recibe enviarSuscripcion)
+        if (mensaje.parametroValido)
+        {
+            suscripciones.confirmar(mensaje.vista<VistaSuscripcion>());
+            mostrarEstadoFlujo();
+        }
+    }
+        break;
+
+    case MENSAJE_NO_IMPLEMENTADO:
+    {
+        // En otros mensajes hay que extraer los parametros de la trama y copiarlos
+        // a una estructura para poder procesar su informacion
+        if (mensaje.parametroValido)
+        {
+            // Muestra en una etiqueta (statuslabel) del GUI el mensaje
+            ui->statusLabel->setText(tr("  Mensaje rechazado,"));
+        }
+        else
+        {
+            // TRATAMIENTO DE ERRORES
+        }
+    }
+        break;
+
+        //Falta por implementar la recepcion de mas tipos de mensajes
+        //habria que decodificarlos y emitir las señales correspondientes con los parametros que correspondan
+
+    default:
+        //Este error lo notifico mediante la señal statusChanged
+        LastError=QString("Status: Recibido paquete inesperado");
+        ui->statusLabel->setText(tr("  Recibido paquete inesperado,"));
+        break;
+    }
 }
 
 // Funciones auxiliares a la gestión comunicación USB
@@ -399,6 +1090,21 @@ void GUIPanel::on_runButton_clicked()
     // Se rellenan los parametros del paquete (en este caso, el brillo)
     int size;
 
+    initIndicadores(); // Por si se pulsa antes de que se hayan configurado los indicadores
+
+    // Un vuelo nuevo empieza a tasa completa y con el reloj de la TIVA sin sincronizar (puede haberse reiniciado)
+    controlFlujo.reiniciar();
+    sincronizacion.reiniciar();
+    alarmas.reiniciar();
+    latenciaMedia = 0;
+    reiniciarInstantes();
+    mostrarEstadoFlujo();
+    enlace.cancelar();     // Las peticiones del vuelo anterior ya no van a tener respuesta
+    enlace.reanudar();
+    codificacion = CODIFICACION_NORMAL;
+    suscripciones.reiniciar();
+    cancelarPruebaEnlace();
+
     // Timer que controla el movimiento retardado de la aguja de velocidad
     VelocidadTimer->start(50);
     startSlave();
@@ -409,6 +1115,11 @@ void GUIPanel::on_runButton_clicked()
     // Si se pudo crear correctamente, se envia la trama
     if (size>0) serial.write((char *)pui8Frame,size);
 
+    enviarSincronizacion();
+    temporizadorSincronizacion->start();
+    negociarCodificacion();
+    revisarSuscripcion();
+    temporizadorSuscripcion->start();
 }
 
 // SLOT asociada a pulsación del botón PING
@@ -417,6 +1128,248 @@ void GUIPanel::on_pingButton_clicked()
     pingDevice();
 }
 
+// SLOT asociada a pulsación del botón TENDENCIAS. Abre (o trae al frente) la ventana con el historial de
+// altura, combustible y velocidad. La ventana se crea la primera vez que se pide
+void GUIPanel::on_tendenciasButton_clicked()
+{
+    if (!ventanaTendencias)
+    {
+        ventanaTendencias = new QWidget(this, Qt::Window);
+        ventanaTendencias->setWindowTitle(tr("Tendencias"));
+        ventanaTendencias->resize(700, 600);
+        QVBoxLayout *layout = new QVBoxLayout(ventanaTendencias);
+        layout->addWidget(new GraficaTendencia(tr("Altitud (m)"), &historialAltitud, ventanaTendencias));
+        layout->addWidget(new GraficaTendencia(tr("Combustible"), &historialDeposito, ventanaTendencias));
+        layout->addWidget(new GraficaTendencia(tr("Velocidad (km/h)"), &historialVelocidad, ventanaTendencias));
+    }
+    ventanaTendencias->show();
+    ventanaTendencias->raise();
+}
+
+// SLOT asociada a pulsación del botón REPRODUCIR. Abre la ventana de reproduccion de vuelos grabados
+void GUIPanel::on_reproducirButton_clicked()
+{
+    if (!ventanaReproduccion) ventanaReproduccion = new PanelReproduccion(this, this);
+    ventanaReproduccion->show();
+    ventanaReproduccion->raise();
+}
+
+bool GUIPanel::abrirReproduccion(const QString &fichero, double velocidad)
+{
+    on_reproducirButton_clicked();
+    ventanaReproduccion->setVelocidad(velocidad);
+    if (!ventanaReproduccion->abrir(fichero)) return false;
+    ventanaReproduccion->reproducir();
+    return true;
+}
+
+bool GUIPanel::iniciarGrabacion(const QString &fichero)
+{
+    return grabador.abrir(QFile::encodeName(fichero).toStdString());
+}
+
+bool GUIPanel::terminarGrabacion()
+{
+    return grabador.cerrar();
+}
+
+void GUIPanel::setDirectorioCajaNegra(const QString &dir)
+{
+    cajaNegra.setDirectorio(QFile::encodeName(dir).toStdString());
+}
+
+// Disparo manual de la caja negra (Ctrl+Shift+N)
+bool GUIPanel::volcarCajaNegra()
+{
+    return dispararCajaNegra("manual");
+}
+
+// El volcado se hace pasados unos segundos (para tener tambien lo que sigue al disparo) y en otro hilo: aqui solo
+// se anota. Se ve el resultado en la etiqueta de estado cuando termina (ver revisarCajaNegra)
+bool GUIPanel::dispararCajaNegra(const std::string &motivo)
+{
+    if (!cajaNegra.disparar(motivo, ahoraUs())) return false;
+    ui->statusLabel->setText(tr("Caja negra: guardando (%1)...").arg(QString::fromStdString(motivo)));
+    return true;
+}
+
+void GUIPanel::revisarCajaNegra()
+{
+    cajaNegra.revisar(ahoraUs());
+
+    VolcadoCajaNegra volcado;
+    while (cajaNegra.terminado(volcado))
+    {
+        QString fichero=QFile::decodeName(volcado.fichero.c_str());
+        if (volcado.ok)
+            ui->statusLabel->setText(tr("Caja negra guardada en %1 (%2 s)").arg(fichero).arg(volcado.segundos,0,'f',1));
+        else
+            ui->statusLabel->setText(tr("No se puede guardar la caja negra en %1").arg(fichero));
+    }
+}
+
+// Estado de los instrumentos para los fotogramas de la grabacion: lo que muestran los indicadores, y del estado
+// compartido lo que no se ve directamente (cuentas de los potenciometros, ultimo mensaje de radio)
+EstadoInstrumentos GUIPanel::estadoInstrumentos() const
+{
+    EstadoInstrumentos e;
+    memset(&e,0,sizeof(e));
+    e.altura=(float)ui->PanelAltitud->value();
+    e.combustible=(float)ui->Deposito->value();
+    e.velocidad=(float)ui->RuedaVelocidad->value();
+    e.consigna=(float)ui->ControlVelocidad->value();
+    e.reloj=(uint32_t)(ui->Reloj->value()/60.0);
+    e.roll=estadoCompartido.roll;
+    e.pitch=estadoCompartido.pitch;
+    e.yaw=estadoCompartido.yaw;
+    e.colision=estadoCompartido.colision;
+    e.sinCombustible=estadoCompartido.sin_combustible;
+    memcpy(e.radio,estadoCompartido.radio,sizeof(e.radio));
+    return e;
+}
+
+// Deja el panel preparado para reproducir: se cierra el puerto serie (los datos salen de la grabacion) y los
+// indicadores se habilitan como en un vuelo
+void GUIPanel::iniciarReproduccion()
+{
+    if (fReproduciendo) return;
+    fReproduciendo=true;
+
+    initIndicadores();
+    temporizadorSincronizacion->stop();
+    temporizadorSuscripcion->stop();
+    serial.close();
+    serial.setPortName(QString());   // Para que RUN vuelva a abrirlo
+    fConnected=false;
+    enlace.cancelar();
+    enlace.reanudar();
+    codificacion=CODIFICACION_NORMAL;
+    suscripciones.reiniciar();
+    cancelarPruebaEnlace();
+    ui->runButton->setEnabled(false);
+    ui->pingButton->setEnabled(false);
+
+    controlFlujo.reiniciar();
+    sincronizacion.reiniciar();
+    mostrarEstadoFlujo();
+    VelocidadTimer->start(50);
+    enableWidgets();
+}
+
+void GUIPanel::terminarReproduccion()
+{
+    if (!fReproduciendo) return;
+    fReproduciendo=false;
+
+    VelocidadTimer->stop();
+    if (timerPitch) timerPitch->stop();
+    decodificador.vaciar();
+    // Los historiales tienen los instantes de la grabacion; un vuelo nuevo empieza de cero
+    historialAltitud.vaciar();
+    historialDeposito.vaciar();
+    historialVelocidad.vaciar();
+
+    ui->CristalRoto->setVisible(false);
+    ui->groupBox->setEnabled(true);
+    disableWidgets();
+    activateRunButton();
+    ui->statusLabel->setText(tr("Reproduccion terminada"));
+}
+
+// Pone los indicadores en el estado de un fotograma (al empezar la reproduccion o al saltar). Lo que quedaba de
+// la posicion anterior se descarta: tramas a medias, muestras de actitud e historiales
+void GUIPanel::aplicarFotograma(const EstadoInstrumentos &estado, uint64_t instante)
+{
+    instanteReproduccion=instante;
+    decodificador.vaciar();
+    reiniciarInstantes();
+    loteActitud.clear();
+    alarmas.reiniciar();
+    if (timerPitch) timerPitch->stop();
+
+    ui->PanelAltitud->setValue((int)estado.altura);
+    ui->Deposito->setValue(estado.combustible);
+    ui->Reloj->setValue((double)estado.reloj*60.0);
+    ui->ControlVelocidad->setValue(estado.consigna);
+    ui->RuedaVelocidad->setValue(estado.velocidad);
+
+    historialAltitud.vaciar();
+    historialDeposito.vaciar();
+    historialVelocidad.vaciar();
+    historialAltitud.anadirMuestra(instante/1e6, estado.altura);
+    historialDeposito.anadirMuestra(instante/1e6, estado.combustible);
+    historialVelocidad.anadirMuestra(instante/1e6, estado.velocidad);
+
+    // La actitud parte de la muestra del fotograma, sin el filtrado de las anteriores
+    MuestraAdc muestra;
+    muestra.eje[EJE_ROLL]=estado.roll;
+    muestra.eje[EJE_PITCH]=estado.pitch;
+    muestra.eje[EJE_YAW]=estado.yaw;
+    filtroActitud.reiniciar();
+    filtroActitud.procesar(&muestra, 1);
+    for (int e=0;e<NUM_EJES;e++) actitudMostrada[e]=HUGE_VALF;
+    actualizarActitud();
+
+    // Los indicadores vuelven al estado de vuelo normal y las alarmas se evaluan con el fotograma: las que estaban
+    // activas en ese punto (sin combustible, colision...) vuelven a bloquear la velocidad, bajar el morro o
+    // romper el cristal, igual que en vivo
+    ui->CristalRoto->setVisible(false);
+    ui->groupBox->setEnabled(true);
+    enableWidgets();
+    ui->ControlVelocidad->setDisabled(false);
+    VelocidadTimer->start(50);
+    ui->statusLabel->setText(QString::fromLatin1(estado.radio));
+    double t=instante/1e6;
+    alimentarAlarma(CANAL_ALTURA, t, estado.altura);
+    alimentarAlarma(CANAL_COMBUSTIBLE, t, estado.sinCombustible ? 0.0 : estado.combustible);
+    alimentarAlarma(CANAL_VELOCIDAD, t, estado.velocidad);
+    alimentarAlarma(CANAL_ROLL, t, filtroActitud.grados(EJE_ROLL));
+    alimentarAlarma(CANAL_PITCH, t, filtroActitud.grados(EJE_PITCH));
+    alimentarAlarma(CANAL_YAW, t, filtroActitud.grados(EJE_YAW));
+    alimentarAlarma(CANAL_COLISION, t, estado.colision ? 1.0 : 0.0);
+
+    estado_telemetria_t &e=estadoCompartido;
+    e.altura=estado.altura;
+    e.combustible=estado.combustible;
+    e.velocidad=estado.velocidad;
+    e.reloj=estado.reloj;
+    e.roll=estado.roll;
+    e.pitch=estado.pitch;
+    e.yaw=estado.yaw;
+    e.colision=estado.colision;
+    e.sin_combustible=estado.sinCombustible;
+    memcpy(e.radio,estado.radio,sizeof(e.radio));
+    if (shmTelemetria) shm_telemetria_publicar(shmTelemetria, &e);
+}
+
+// Entrega un registro de la grabacion: los datos pasan por el mismo camino que los del puerto serie
+void GUIPanel::reproducirRegistro(const RegistroVuelo &registro)
+{
+    instanteReproduccion=registro.instante;
+    float consigna;
+
+    switch (registro.tipo)
+    {
+    case REGISTRO_DATOS:
+        recibirDatos(QByteArray::fromRawData((const char *)registro.datos.data(), (int)registro.datos.size()),
+                     registro.instante);
+        break;
+    case REGISTRO_CONSIGNA:
+        if (LectorVuelo::leerConsigna(registro, consigna)) ui->ControlVelocidad->setValue(consigna);
+        break;
+    case REGISTRO_SINCRONIZACION:
+    {
+        // La respuesta, que viene despues en los datos, se empareja con ella como en vivo
+        uint32_t secuencia;
+        uint64_t t1;
+        if (LectorVuelo::leerSincronizacion(registro, secuencia, t1)) sincronizacion.peticionGrabada(secuencia, t1);
+    }
+        break;
+    default:
+        break;   // Los fotogramas solo se usan al saltar; las muestras de la caja negra, para analizarla fuera
+    }
+}
+
 // SLOT asociada al borrado del mensaje de estado al pulsar el boton
 void GUIPanel::on_statusButton_clicked()
 {
@@ -429,31 +1382,168 @@ void GUIPanel::on_statusButton_clicked()
 
 // Envío de un mensaje PING
 
-void GUIPanel::pingDevice()
+// Es una corrutina: envia el PING y sigue cuando llega la respuesta o se agota el plazo, sin bloquear el GUI
+Tarea GUIPanel::pingDevice()
 {
-    uint8_t paquete[MAX_FRAME_SIZE];
-    int size;
+    if (!fConnected) co_return; // Para que no se intenten enviar datos si la conexion USB no esta activa
+
+    // El mensaje PING no necesita parametros; la respuesta es otro PING
+    RespuestaDispositivo respuesta=co_await enlace.ping();
+    if (respuesta.ok())
+        pingResponseReceived(respuesta.idaVuelta);
+    else if (respuesta.estado==TRANSACCION_PLAZO_AGOTADO)
+        ui->statusLabel->setText(tr("Status: sin respuesta a PING"));
+}
+
+// Pide a la TIVA la codificacion de la telemetria. Si no la conoce (firmware antiguo) responde
+// MENSAJE_NO_IMPLEMENTADO o no responde, y se sigue con la normal, que el decodificador entiende siempre
+Tarea GUIPanel::negociarCodificacion()
+{
+    PARAM_MENSAJE_CODIFICACION parametro;
+    parametro.codificacion=fCodificacionCompacta ? CODIFICACION_COMPACTA : CODIFICACION_NORMAL;
+
+    RespuestaDispositivo respuesta=co_await enlace.enviar(MENSAJE_CODIFICACION, parametro);
+    if (respuesta.estado==TRANSACCION_CANCELADA) co_return;
+    codificacion=respuesta.ok() ? respuesta.vista<VistaCodificacion>().codificacion() : (uint8_t)CODIFICACION_NORMAL;
+    mostrarEstadoFlujo();
+}
+
+// Periodo de un canal segun para que se necesita: a tasa normal si se muestra o se entrega fuera del panel, a tasa
+// reducida si solo lo vigilan las alarmas (segun la ventana mas corta de sus reglas), y si no, nada
+static uint16_t periodoCanal(bool completo, bool alarmas, double ventanaMinima=0)
+{
+    if (completo) return PERIODO_TASA_NORMAL;
+    return alarmas ? Suscripciones::periodoSoloAlarmas(ventanaMinima) : PERIODO_DESACTIVADO;
+}
+
+// Calcula los canales que hacen falta a partir de los indicadores visibles y habilitados (y de la grabacion, las
+// tendencias, los consumidores externos y las alarmas), y los pide a la TIVA si han cambiado
+void GUIPanel::revisarSuscripcion()
+{
+    if (!fConnected || fReproduciendo) return;
+
+    // La grabacion, MQTT y la memoria compartida entregan todo lo que llega, se vea o no
+    bool todo = grabador.abierto() || publicadorMqtt || shmTelemetria;
+    bool panelVisible = isVisible() && !window()->isMinimized();
+    bool tendencias = ventanaTendencias && ventanaTendencias->isVisible() && !ventanaTendencias->isMinimized();
+    auto mostrado=[panelVisible](const QWidget *w) { return panelVisible && w->isVisible() && w->isEnabled(); };
+
+    bool actitud = mostrado(ui->PitchCompass) || mostrado(ui->ElementoRoll) || mostrado(ui->ElementoYaw);
+    bool alarmasActitud = alarmas.usaCanal(CANAL_ROLL) || alarmas.usaCanal(CANAL_PITCH) || alarmas.usaCanal(CANAL_YAW);
+    double ventanaActitud = 0;   // Los tres ejes van en el mismo canal: manda la ventana mas corta de los tres
+    for (int c : {CANAL_ROLL, CANAL_PITCH, CANAL_YAW})
+    {
+        double v=alarmas.ventanaMinima(c);
+        if ((v>0)&&((ventanaActitud==0)||(v<ventanaActitud))) ventanaActitud=v;
+    }
+
+    // La velocidad que muestra el panel es la de la palanca, asi que la de la TIVA solo interesa fuera del panel
+    suscripciones.pedir(SUSCRIPCION_ACTITUD, periodoCanal(todo || actitud, alarmasActitud, ventanaActitud));
+    suscripciones.pedir(SUSCRIPCION_VELOCIDAD, periodoCanal(todo, false));
+    suscripciones.pedir(SUSCRIPCION_RELOJ, periodoCanal(todo || mostrado(ui->Reloj), false));
+    suscripciones.pedir(SUSCRIPCION_COMBUSTIBLE, periodoCanal(todo || tendencias || mostrado(ui->Deposito),
+                                                             alarmas.usaCanal(CANAL_COMBUSTIBLE),
+                                                             alarmas.ventanaMinima(CANAL_COMBUSTIBLE)));
+    suscripciones.pedir(SUSCRIPCION_ALTURA, periodoCanal(todo || tendencias || mostrado(ui->PanelAltitud),
+                                                        alarmas.usaCanal(CANAL_ALTURA),
+                                                        alarmas.ventanaMinima(CANAL_ALTURA)));
+    suscripciones.pedir(SUSCRIPCION_RADIO, periodoCanal(todo || (panelVisible && ui->statusLabel->isVisible()), false));
+
+    if (suscripciones.pendiente()) enviarSuscripcion();
+}
+
+// Envia la suscripcion pedida. Si la TIVA no la conoce (firmware antiguo) responde MENSAJE_NO_IMPLEMENTADO y se
+// deja de pedir: sigue enviandolo todo, como siempre. Sin respuesta se repite en la siguiente revision
+Tarea GUIPanel::enviarSuscripcion()
+{
+    PARAM_MENSAJE_SUSCRIPCION parametro=suscripciones.mensaje();
+
+    RespuestaDispositivo respuesta=co_await enlace.enviar(MENSAJE_SUSCRIPCION, parametro);
+    if (respuesta.estado==TRANSACCION_CANCELADA) co_return;
+    if (respuesta.ok()) suscripciones.confirmar(respuesta.vista<VistaSuscripcion>());
+    else if (respuesta.estado==TRANSACCION_RECHAZADA) suscripciones.rechazar();
+    else suscripciones.sinRespuesta();
+    mostrarEstadoFlujo();
+}
+
+// SLOT del atajo Ctrl+Shift+B. La prueba comparte el enlace con la telemetria, que sigue llegando y se procesa
+// como siempre; para medir el enlace solo, conviene quitar antes los canales (p.ej. minimizando la ventana)
+bool GUIPanel::iniciarPruebaEnlace()
+{
+    if (!fConnected || fReproduciendo || pruebaEnlace)
+    {
+        ui->statusLabel->setText(pruebaEnlace ? tr("Prueba del enlace en curso") : tr("Prueba del enlace: sin conexion"));
+        return false;
+    }
+    pruebaEnlace = new PruebaEnlace(configPrueba);
+    ui->statusLabel->setText(tr("Prueba del enlace en curso..."));
+    temporizadorPrueba->start();
+    alimentarPrueba();
+    return true;
+}
 
-    if (fConnected) // Para que no se intenten enviar datos si la conexion USB no esta activa
+void GUIPanel::cancelarPruebaEnlace()
+{
+    temporizadorPrueba->stop();
+    delete pruebaEnlace;
+    pruebaEnlace = nullptr;
+}
+
+// Mantiene poco escrito por delante (dos tramas) para que la latencia mida el enlace y no el buffer de QSerialPort
+void GUIPanel::alimentarPrueba()
+{
+    if (!pruebaEnlace) return;
+
+    uint8_t trama[MAX_FRAME_SIZE];
+    int32_t tam;
+    while ((serial.bytesToWrite() < 2*MAX_FRAME_SIZE) && ((tam=pruebaEnlace->generar(trama, ahoraUs()))>0))
+        serial.write((const char *)trama, tam);
+    if (!pruebaEnlace->terminada()) return;
+
+    const ConfigPrueba &c = pruebaEnlace->configuracion();
+    ResultadoPrueba r = pruebaEnlace->resultado();
+    QString texto;
+    if (r.rechazada)
+        texto = tr("Prueba del enlace: la TIVA no la admite");
+    else
     {
-        // El mensaje PING no necesita parametros; de ahí el NULL, y el 0 final.
-        // No vamos a usar el mecanismo de numeracion de tramas; pasamos un 0 como n de trama
-        size=create_frame(paquete, MENSAJE_PING, nullptr, 0, MAX_FRAME_SIZE);
-        // Si la trama se creó correctamente, se escribe el paquete por el puerto serie USB
-        if (size>0) serial.write((const char*)paquete,size);
+        texto = tr("Prueba del enlace (%1, %2 bytes de carga, densidad de escape %3) a %4 baudios:\n")
+                .arg(c.modo==PRUEBA_ECO ? tr("eco") : tr("sumidero")).arg(c.carga).arg(c.densidadEscape,0,'f',2)
+                .arg(serial.baudRate())
+              + tr("%1 tramas/s, caudal util %2 kbit/s (%3% de la linea), stuffing +%4%")
+                .arg(r.tramasPorSegundo,0,'f',0).arg(r.caudalUtil*8/1000.0,0,'f',2)
+                .arg(100.0*r.caudalUtil/(serial.baudRate()/10.0),0,'f',1).arg(100.0*r.sobrecosteStuffing(),0,'f',1);
+        texto += r.sinResumen ? tr("\nPerdidas: sin resumen de la TIVA")
+                              : tr("\nPerdidas: %1% (%2 de %3)").arg(100.0*r.perdidas(),0,'f',2)
+                                .arg(r.enviadas-r.recibidas).arg(r.enviadas);
+        if (c.modo==PRUEBA_ECO)
+            texto += tr("\nLatencia ida y vuelta p50/p90/p99/max: %1/%2/%3/%4 ms")
+                     .arg(pruebaEnlace->percentilLatencia(0.5)/1000.0,0,'f',2)
+                     .arg(pruebaEnlace->percentilLatencia(0.9)/1000.0,0,'f',2)
+                     .arg(pruebaEnlace->percentilLatencia(0.99)/1000.0,0,'f',2)
+                     .arg(pruebaEnlace->percentilLatencia(1.0)/1000.0,0,'f',2);
     }
+    cancelarPruebaEnlace();
+
+    ui->statusLabel->setText(tr("Prueba del enlace terminada"));
+    ventanaPopUp.setText(texto);
+    ventanaPopUp.setStyleSheet("background-color: lightgrey");
+    ventanaPopUp.setModal(true);
+    ventanaPopUp.show();
 }
 
-void GUIPanel::pingResponseReceived()
+void GUIPanel::pingResponseReceived(uint64_t idaVuelta)
 
 {
     // Ventana popUP para el caso de mensaje PING; no te deja definirla en un "caso"
+    ventanaPopUp.setText(tr("Status: RESPUESTA A PING RECIBIDA (%1 ms)").arg(idaVuelta/1000.0,0,'f',1));
     ventanaPopUp.setStyleSheet("background-color: lightgrey");
     ventanaPopUp.setModal(true);
     ventanaPopUp.show();
 }
 
 QPixmap GUIPanel::rotatePixmap(QPixmap thePixmax, int angle){
+    TRAZA_SPAN("pintado","rotatePixmap");
     QSize size = originalPixmap.size();
     QPixmap rotatedPixmap(size);
     rotatedPixmap.fill(QColor::fromRgb(0, 0, 0, 0)); //the new pixmap must be transparent.
@@ -579,14 +1669,6 @@ void GUIPanel::initPitchCompass(){
     ui->PitchCompass->setWrapping(false); // La aguja no puede superar los valores máximo o minimo
 }
 
-// Convierte un valor en la escala 0-4096 (centrado en 2048) a otro en la escala (min,max),
-// centrado en (max-min)/2
-unsigned short GUIPanel::convertScale(unsigned short value, unsigned short min, unsigned short max){
-    float temp = ((float)value)/4096;
-    temp = (temp * (max - min)) + min;
-    return temp;
-}
-
 // Configuracion de la esfera que marca la velocidad de 0 a 200 km/h
 void GUIPanel::initRuedaVelocidad(){
 
@@ -637,11 +1719,22 @@ void GUIPanel::changeValue(void) // Slider Controlled
             ui->RuedaVelocidad->setValue(actualValue - negOffset);
         }
     }
+
+    // La velocidad mostrada se guarda en cada tick del timer (50ms)
+    historialVelocidad.anadirMuestra(instanteActual()/1e6, ui->RuedaVelocidad->value());
+    alimentarAlarma(CANAL_VELOCIDAD, instanteActual()/1e6, ui->RuedaVelocidad->value());
+    if (estadoCompartido.velocidad!=(float)ui->RuedaVelocidad->value())
+    {
+        estadoCompartido.velocidad=(float)ui->RuedaVelocidad->value();
+        if (shmTelemetria) shm_telemetria_publicar(shmTelemetria, &estadoCompartido);
+    }
 }
 
 // Slot que reacciona cuando se suelta la palanca que controla la velocidad y envia ese valor en km/h como mensaje
 void GUIPanel::on_ControlVelocidad_sliderReleased()
 {
+    if (fReproduciendo) return;   // Al reproducir la palanca la mueve la grabacion
+
     PARAM_MENSAJE_VELOCIDAD velocidad;
     uint8_t pui8Frame[MAX_FRAME_SIZE];
 
@@ -650,10 +1743,22 @@ void GUIPanel::on_ControlVelocidad_sliderReleased()
 
     velocidad.bIntensity = (float)ui->ControlVelocidad->value(); //Obtenemos el valor de la barra y lo almacenamos en el valor de intensidad
 
-    size=create_frame((uint8_t *)pui8Frame, MENSAJE_VELOCIDAD, &velocidad, sizeof(velocidad), MAX_FRAME_SIZE);
+    if (codificacion==CODIFICACION_COMPACTA)
+    {
+        // Misma codificacion en los dos sentidos (empaquetado.h)
+        uint8_t compacta[sizeof(PARAM_MENSAJE_VELOCIDAD_COMPACTO)];
+        escribir_u16_le(compacta, (uint16_t)a_fijo_s16(velocidad.bIntensity, ESCALA_VELOCIDAD_COMPACTA));
+        size=create_frame((uint8_t *)pui8Frame, MENSAJE_VELOCIDAD_COMPACTO, compacta, sizeof(compacta), MAX_FRAME_SIZE);
+    }
+    else
+        size=create_frame((uint8_t *)pui8Frame, MENSAJE_VELOCIDAD, &velocidad, sizeof(velocidad), MAX_FRAME_SIZE);
 
     // Si se pudo crear correctamente, se envia la trama
     if (size>0) serial.write((char *)pui8Frame,size);
+
+    // La palanca no llega de la TIVA: se graba aparte para que la aguja la siga tambien al reproducir
+    grabador.anadirConsigna(ahoraUs(), velocidad.bIntensity);
+    cajaNegra.anadirConsigna(ahoraUs(), velocidad.bIntensity);
 }
 
 void GUIPanel::initReloj()
@@ -720,6 +1825,11 @@ void GUIPanel::disminucionPitch(){
            valor_pitch2 = actualValue2 - negOffset;
         }
     }
+
+    // Lo que se ha pintado pasa a ser lo que se muestra, para que actualizarActitud compare las siguientes muestras
+    // con la imagen y el horizonte del picado y no con el angulo de antes
+    pitchDron = valor_pitch1;
+    actitudMostrada[EJE_PITCH] = -valor_pitch2;
 }
 
 void GUIPanel::initPanelAltitud(){
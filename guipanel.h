@@ -8,6 +8,29 @@
 #include <qwt_analog_clock.h>
 #include <QTimer>
 #include <QTime>
+#include <QSerialPortInfo>
+#include <QFutureWatcher>
+#include <QSocketNotifier>
+#include <QElapsedTimer>
+#include <QHash>
+
+#include "historial.h"
+#include "telemetria.h"
+#include "filtroactitud.h"
+#include "controlflujo.h"
+#include "colamensajes.h"
+#include "sincronizacion.h"
+#include "grabacion.h"
+#include "motoralarmas.h"
+#include "enlacedispositivo.h"
+#include "suscripciones.h"
+#include "pruebaenlace.h"
+#include "cajanegra.h"
+
+#include "telemetria_shm.h"
+
+class PublicadorMqtt;
+class PanelReproduccion;
 
 namespace Ui {
 class GUIPanel;
@@ -23,6 +46,60 @@ public:
     explicit GUIPanel(QWidget *parent = 0);
     ~GUIPanel(); // Da problemas
 
+    // Procesa bytes recibidos como si llegasen por el puerto serie (lo usa readRequest y las pruebas sin TIVA).
+    // 'recepcion' es el instante de llegada (us, misma base que los historiales); por defecto, el actual
+    void recibirDatos(const QByteArray &datos);
+    void recibirDatos(const QByteArray &datos, uint64_t recepcion);
+
+    // Publica cada mensaje decodificado en MQTT (opcional; el panel no toma posesion del publicador)
+    void setPublicadorMqtt(PublicadorMqtt *publicador);
+
+    // Publica el estado del avion en el segmento de memoria compartida indicado (ver telemetria_shm.h)
+    bool activarMemoriaCompartida(const char *nombre);
+
+    // Traza de tiempos (traza.h): activa los intervalos, incluido el pintado de cada widget, y los vuelca en
+    // 'fichero' con volcarTraza() o con Ctrl+Shift+T
+    void activarTraza(const QString &fichero);
+
+    // Mensajes despachados y descartados por la cola de prioridades (ver colamensajes.h)
+    const EstadisticasCola &estadisticasCola() const { return colaMensajes.estadisticas(); }
+
+    // Calibracion de los potenciometros y suavizado de las agujas (ver filtroactitud.h)
+    void setCalibracion(EjeActitud eje, const CalibracionEje &cal);
+    const CalibracionEje &calibracion(EjeActitud eje) const { return filtroActitud.calibracion(eje); }
+    void setSuavizadoActitud(float alfa);
+
+    // Codificacion de la telemetria que se pide a la TIVA al pulsar RUN (por defecto la compacta, empaquetado.h)
+    void setCodificacionCompacta(bool compacta) { fCodificacionCompacta=compacta; }
+
+    // Reglas de alarma (ver motoralarmas.h). Se añaden a las de por defecto; si hay algun error no se añade
+    // ninguna y se devuelve el motivo en 'error'
+    bool cargarAlarmas(const QString &fichero, QString *error = nullptr);
+
+    // Prueba de rendimiento del enlace (ver pruebaenlace.h) que se lanza con Ctrl+Shift+B durante el vuelo. El
+    // resultado se muestra en una ventana (para guardarlo, pruebaenlace escribe una tabla)
+    void setConfigPrueba(const ConfigPrueba &config) { configPrueba=config; }
+
+    // Caja negra (ver cajanegra.h): directorio en el que se guardan sus volcados (por defecto el actual)
+    void setDirectorioCajaNegra(const QString &dir);
+
+    // Grabacion de lo que llega por el puerto serie, con un fotograma del estado cada segundo (ver grabacion.h)
+    bool iniciarGrabacion(const QString &fichero);
+    bool terminarGrabacion();      // false si ha fallado alguna escritura
+
+    // Reproduccion de un vuelo grabado (la controla PanelReproduccion). Mientras dura, los instantes de los
+    // historiales son los de la grabacion y no se publica en MQTT
+    bool abrirReproduccion(const QString &fichero, double velocidad);
+    void iniciarReproduccion();
+    void terminarReproduccion();
+    void aplicarFotograma(const EstadoInstrumentos &estado, uint64_t instante);
+    void reproducirRegistro(const RegistroVuelo &registro);
+
+public slots:
+    bool volcarTraza();
+    bool iniciarPruebaEnlace();
+    bool volcarCajaNegra();
+
 private slots:
     void readRequest();
     void on_pingButton_clicked();
@@ -35,28 +112,88 @@ private slots:
 
     void disminucionPitch();
 
+    void actualizarPuertos();
+    void puertosEnumerados();
+    void eventoUdevRecibido();
+    void initIndicadores();
+
+    void on_tendenciasButton_clicked();
+    void on_reproducirButton_clicked();
+
+    void enviarSincronizacion();
+    void revisarEnlace();
+    void revisarSuscripcion();
+    void alimentarPrueba();
+    void revisarCajaNegra();
+
+protected:
+    void showEvent(QShowEvent *event);
+    bool eventFilter(QObject *objeto, QEvent *evento);
+
 private: // funciones privadas
-    void pingDevice();
+    Tarea pingDevice();
+    Tarea negociarCodificacion();
+    Tarea enviarSuscripcion();
+    bool escribirTrama(const uint8_t *trama, size_t tam);
     void startSlave();
     void processError(const QString &s);
     void activateRunButton();
-    void pingResponseReceived();
+    void pingResponseReceived(uint64_t idaVuelta);
+    void registrarMensaje(const MensajeDecodificado &mensaje);
+    void procesarMensaje(const MensajeDecodificado &mensaje);
+    void actualizarEstadoCompartido(const MensajeDecodificado &mensaje);
+    EstadoInstrumentos estadoInstrumentos() const;
+    void actualizarActitud();
+    void alimentarAlarma(CanalAlarma canal, double t, double valor);
+    void ejecutarAlarma(const EventoAlarma &evento);
+    bool velocidadBloqueada() const;
+    void revisarFlujo(size_t ocupacion);
+    void mostrarEstadoFlujo();
+    void cancelarPruebaEnlace();
+    bool dispararCajaNegra(const std::string &motivo);
+    QString descripcionSuscripcion() const;
+    uint64_t ahoraUs() const;
+    uint64_t instanteActual() const;
+    int64_t instanteMuestra(const MensajeDecodificado &mensaje, uint64_t recepcion);
+    void reiniciarInstantes();
     QPixmap rotatePixmap(const QPixmap thePixmax, int angle);
     void disableWidgets();
     void enableWidgets();
     void initPitchCompass();
-    unsigned short convertScale(unsigned short value, unsigned short min, unsigned short max);
     void initRuedaVelocidad();
     void initReloj();
     void initDeposito();
     void initPanelAltitud();
+    void initMonitorUdev();
 
 private:
     Ui::GUIPanel *ui;
     int transactionCount;
     bool fConnected;
     QSerialPort serial;
-    QByteArray incommingDataBuffer;
+    DecodificadorTramas decodificador;
+    EnlaceDispositivo enlace;              // Peticiones con respuesta (corrutinas, ver enlacedispositivo.h)
+    QTimer *temporizadorEnlace;            // Revisa los plazos mientras hay peticiones en curso
+    ColaMensajes colaMensajes;
+    FiltroActitud filtroActitud;
+    std::vector<MuestraAdc> loteActitud;   // Muestras de los potenciometros de la lectura en curso
+    float actitudMostrada[NUM_EJES];       // Angulos que muestran ahora los indicadores
+    int pitchDron;                         // Angulo con el que se ha girado por ultima vez la imagen del avion
+    ControlFlujo controlFlujo;
+    bool fCodificacionCompacta;            // Codificacion que se pide a la TIVA
+    uint8_t codificacion;                  // La que ha confirmado (codificaciones)
+    Suscripciones suscripciones;           // Canales que se piden a la TIVA segun lo que se muestra
+    QTimer *temporizadorSuscripcion;
+    ConfigPrueba configPrueba;
+    PruebaEnlace *pruebaEnlace;            // Prueba del enlace en curso (nullptr si no hay)
+    QTimer *temporizadorPrueba;            // Genera las tramas de la prueba y revisa sus plazos
+    MotorAlarmas alarmas;
+    SincronizacionReloj sincronizacion;
+    QTimer *temporizadorSincronizacion;
+    double latenciaMedia;                  // us, de los mensajes con marca de tiempo (media exponencial)
+    int64_t ultimoInstante[256];           // Ultimo instante de cada tipo de mensaje (ver instanteMuestra)
+    QString ficheroTraza;
+    QHash<QObject *, const char *> nombresTraza;   // Nombre de cada widget en la traza (internado)
     QString LastError;
     QMessageBox ventanaPopUp;
     QPixmap originalPixmap;
@@ -65,6 +202,26 @@ private:
     QTimer *timerPitch;
     int valor_pitch1;
     int valor_pitch2;
+    bool fIndicadoresIniciados;
+    QFutureWatcher<QList<QSerialPortInfo> > enumeradorPuertos;
+    bool fEnumeracionPendiente;
+    QTimer *temporizadorPuertos;
+    int udevSocket;
+    QSocketNotifier *udevNotifier;
+    QElapsedTimer relojVuelo;          // Base de tiempos de los historiales
+    HistorialCanal historialAltitud;
+    HistorialCanal historialDeposito;
+    HistorialCanal historialVelocidad;
+    QWidget *ventanaTendencias;
+    PublicadorMqtt *publicadorMqtt;
+    shm_telemetria_t *shmTelemetria;
+    estado_telemetria_t estadoCompartido;  // Ultimo estado del avion (se publica en memoria compartida si esta activa)
+    GrabadorVuelo grabador;
+    CajaNegra cajaNegra;                   // Ultimos segundos de vuelo, siempre en memoria
+    QTimer *temporizadorCajaNegra;         // Cierra los disparos y recoge los volcados terminados
+    PanelReproduccion *ventanaReproduccion;
+    bool fReproduciendo;
+    uint64_t instanteReproduccion;         // Instante de la grabacion (us) del ultimo registro reproducido
 };
 
 #endif // GUIPANEL_H
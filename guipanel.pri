@@ -0,0 +1,65 @@
+#-------------------------------------------------
+#
+# Fuentes comunes del panel (GUIPanel y la capa de telemetria). Lo incluyen
+# GUIPractica.pro y los programas de herramientas/ que necesitan el GUI completo
+#-------------------------------------------------
+
+QT       += core gui serialport widgets
+QT       += svg
+QT       += concurrent network
+CONFIG   += qwt analogwidgets qmqtt ColorWidgets embeddeduma
+CONFIG   += c++2a
+# Corrutinas (enlacedispositivo.h): GCC 10 las necesita activar aparte
+gcc:!clang: QMAKE_CXXFLAGS += -fcoroutines
+
+INCLUDEPATH += $$PWD
+unix:!macx: LIBS += -lrt    # shm_open (telemetria_shm.c)
+
+SOURCES += $$PWD/guipanel.cpp \
+    $$PWD/serial2USBprotocol.cpp \
+    $$PWD/historial.cpp \
+    $$PWD/graficatendencia.cpp \
+    $$PWD/telemetria.cpp \
+    $$PWD/filtroactitud.cpp \
+    $$PWD/controlflujo.cpp \
+    $$PWD/colamensajes.cpp \
+    $$PWD/sincronizacion.cpp \
+    $$PWD/traza.cpp \
+    $$PWD/grabacion.cpp \
+    $$PWD/panelreproduccion.cpp \
+    $$PWD/motoralarmas.cpp \
+    $$PWD/enlacedispositivo.cpp \
+    $$PWD/suscripciones.cpp \
+    $$PWD/pruebaenlace.cpp \
+    $$PWD/cajanegra.cpp \
+    $$PWD/publicadormqtt.cpp \
+    $$PWD/telemetria_shm.c
+
+HEADERS  += $$PWD/guipanel.h \
+    $$PWD/serial2USBprotocol.h \
+    $$PWD/codectramas.h \
+    $$PWD/empaquetado.h \
+    $$PWD/usb_messages_table.h \
+    $$PWD/historial.h \
+    $$PWD/graficatendencia.h \
+    $$PWD/telemetria.h \
+    $$PWD/vistasmensajes.h \
+    $$PWD/filtroactitud.h \
+    $$PWD/controlflujo.h \
+    $$PWD/colamensajes.h \
+    $$PWD/sincronizacion.h \
+    $$PWD/traza.h \
+    $$PWD/grabacion.h \
+    $$PWD/panelreproduccion.h \
+    $$PWD/motoralarmas.h \
+    $$PWD/enlacedispositivo.h \
+    $$PWD/suscripciones.h \
+    $$PWD/pruebaenlace.h \
+    $$PWD/cajanegra.h \
+    $$PWD/publicadormqtt.h \
+    $$PWD/telemetria_shm.h
+
+FORMS    += $$PWD/guipanel.ui
+
+RESOURCES += \
+    $$PWD/images.qrc
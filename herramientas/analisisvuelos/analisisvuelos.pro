@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Herramienta de analisis de vuelos grabados (linea de comandos)
+# Reutiliza la decodificacion de tramas del GUI (telemetria.cpp)
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = analisisvuelos
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../..
+LIBS += -lpthread
+
+SOURCES += main.cpp \
+    ../../telemetria.cpp \
+    ../../traza.cpp \
+    ../../serial2USBprotocol.cpp
+
+HEADERS += ../../telemetria.h \
+    ../../vistasmensajes.h \
+    ../../traza.h \
+    ../../serial2USBprotocol.h \
+    ../../codectramas.h \
+    ../../empaquetado.h \
+    ../../usb_messages_table.h
@@ -0,0 +1,302 @@
+// Analisis de vuelos grabados. Recorre un directorio de capturas del puerto serie (bytes tal y como los envia
+// la TIVA, con el protocolo de serial2USBprotocol), las proyecta en memoria con mmap y las decodifica en
+// paralelo (un fichero por hilo) con el mismo decodificador que usa el GUI. Saca un resumen por vuelo y otro
+// de toda la flota.
+//
+// Uso: analisisvuelos [-j hilos] [--csv] [--traza fichero.json] directorio
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetria.h"
+#include "traza.h"
+
+// Tamaño de los bloques que se pasan al decodificador (el buffer interno no crece con el fichero)
+#define BLOQUE_DECODIFICACION (64*1024)
+
+struct Extremos {
+    double minimo;
+    double maximo;
+
+    Extremos() : minimo(std::numeric_limits<double>::infinity()), maximo(-std::numeric_limits<double>::infinity()) {}
+    void anadir(double v) { minimo=std::min(minimo,v); maximo=std::max(maximo,v); }
+    void anadir(const Extremos &e) { minimo=std::min(minimo,e.minimo); maximo=std::max(maximo,e.maximo); }
+    bool valido() const { return minimo<=maximo; }
+};
+
+struct ResumenVuelo {
+    std::string fichero;
+    bool leido;
+    EstadisticasEnlace enlace;
+    Extremos altura;
+    Extremos roll, pitch, yaw;       // Grados, con la misma conversion que el GUI
+    bool hayCombustible;
+    double combustibleInicial, combustibleFinal;
+    double relojCombustibleInicial, relojCombustibleFinal;
+    bool hayReloj;
+    double relojInicial, relojActual;   // Segundos del reloj de la TIVA (MENSAJE_RELOJ)
+    bool colision;
+    double tiempoColision;              // Segundos desde el primer MENSAJE_RELOJ
+
+    double consumo() const     // Unidades de combustible por segundo
+    {
+        double t=relojCombustibleFinal-relojCombustibleInicial;
+        return (hayCombustible&&(t>0)) ? (combustibleInicial-combustibleFinal)/t : 0.0;
+    }
+    double tasaErroresCrc() const
+    {
+        uint64_t total=enlace.tramas+enlace.erroresCrc;
+        return total ? (double)enlace.erroresCrc/(double)total : 0.0;
+    }
+};
+
+// Conversion de la escala 0-4096 de los potenciometros a grados (la calibracion nominal de FiltroActitud)
+static double a_grados(uint16_t valor, double rango)
+{
+    return ((double)(valor&0xFFF)/4096.0)*rango-rango/2;
+}
+
+static void procesar_mensaje(ResumenVuelo &r, const MensajeDecodificado &m)
+{
+    if (m.error || !m.parametroValido) return;
+
+    switch (m.tipo)
+    {
+    case MENSAJE_RELOJ:
+        r.relojActual=(double)m.vista<VistaReloj>().reloj();
+        if (!r.hayReloj)
+        {
+            r.hayReloj=true;
+            r.relojInicial=r.relojActual;
+        }
+        break;
+    case MENSAJE_ALTURA:
+        r.altura.anadir(m.vista<VistaAltura>().altura());
+        break;
+    case MENSAJE_POTENCIOMETRO:
+    {
+        VistaPotenciometro giro=m.vista<VistaPotenciometro>();
+        r.roll.anadir(a_grados(giro.roll(),360));
+        r.pitch.anadir(a_grados(giro.pitch(),180));
+        r.yaw.anadir(a_grados(giro.yaw(),360));
+    }
+        break;
+    case MENSAJE_COMBUSTIBLE:
+    {
+        double c=std::max(0.0f,m.vista<VistaCombustible>().combustible());
+        if (!r.hayCombustible)
+        {
+            r.hayCombustible=true;
+            r.combustibleInicial=c;
+            r.relojCombustibleInicial=r.relojActual;
+        }
+        r.combustibleFinal=c;
+        r.relojCombustibleFinal=r.relojActual;
+    }
+        break;
+    case MENSAJE_COLISION:
+        if (!r.colision)
+        {
+            r.colision=true;
+            r.tiempoColision=r.relojActual-r.relojInicial;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void analizar_fichero(ResumenVuelo &r)
+{
+    struct stat info;
+    int fd=open(r.fichero.c_str(),O_RDONLY);
+
+    if (fd<0) return;
+    if ((fstat(fd,&info)<0)||(info.st_size==0))
+    {
+        close(fd);
+        return;
+    }
+
+    const uint8_t *datos=(const uint8_t *)mmap(nullptr,(size_t)info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (datos==MAP_FAILED) return;
+    madvise((void *)datos,(size_t)info.st_size,MADV_SEQUENTIAL);
+
+    TRAZA_SPAN("analisis","fichero");
+    DecodificadorTramas decodificador;
+    for (off_t pos=0;pos<info.st_size;pos+=BLOQUE_DECODIFICACION)
+    {
+        TRAZA_SPAN("decodificacion","bloque");
+        size_t n=(size_t)std::min<off_t>(BLOQUE_DECODIFICACION,info.st_size-pos);
+        decodificador.anadir(datos+pos,n,[&r](const MensajeDecodificado &m) { procesar_mensaje(r,m); });
+    }
+    r.enlace=decodificador.estadisticas();
+    r.leido=true;
+
+    munmap((void *)datos,(size_t)info.st_size);
+}
+
+static void imprimir_extremos(const char *nombre, const Extremos &e)
+{
+    if (e.valido()) printf("  %-12s min %10.2f  max %10.2f\n",nombre,e.minimo,e.maximo);
+    else printf("  %-12s sin datos\n",nombre);
+}
+
+static void imprimir_resumen(const ResumenVuelo &r)
+{
+    printf("%s\n",r.fichero.c_str());
+    if (!r.leido)
+    {
+        printf("  no se puede leer\n");
+        return;
+    }
+    printf("  %-12s %llu tramas, %llu errores CRC (%.3f%%), %llu fragmentos\n","enlace",
+           (unsigned long long)r.enlace.tramas,(unsigned long long)r.enlace.erroresCrc,
+           100.0*r.tasaErroresCrc(),(unsigned long long)r.enlace.fragmentos);
+    imprimir_extremos("altura",r.altura);
+    imprimir_extremos("roll",r.roll);
+    imprimir_extremos("pitch",r.pitch);
+    imprimir_extremos("yaw",r.yaw);
+    if (r.hayCombustible)
+        printf("  %-12s %.2f -> %.2f, consumo %.4f/s\n","combustible",r.combustibleInicial,r.combustibleFinal,r.consumo());
+    if (r.colision)
+        printf("  %-12s a los %.0f s\n","colision",r.tiempoColision);
+}
+
+static void imprimir_csv(const std::vector<ResumenVuelo> &vuelos)
+{
+    printf("fichero,tramas,errores_crc,fragmentos,altura_min,altura_max,roll_min,roll_max,pitch_min,pitch_max,"
+           "yaw_min,yaw_max,consumo,colision,tiempo_colision\n");
+    for (const ResumenVuelo &r : vuelos)
+    {
+        if (!r.leido) continue;
+        printf("%s,%llu,%llu,%llu,%g,%g,%g,%g,%g,%g,%g,%g,%g,%d,%g\n",r.fichero.c_str(),
+               (unsigned long long)r.enlace.tramas,(unsigned long long)r.enlace.erroresCrc,
+               (unsigned long long)r.enlace.fragmentos,r.altura.minimo,r.altura.maximo,
+               r.roll.minimo,r.roll.maximo,r.pitch.minimo,r.pitch.maximo,r.yaw.minimo,r.yaw.maximo,
+               r.consumo(),r.colision?1:0,r.colision?r.tiempoColision:0.0);
+    }
+}
+
+static void imprimir_flota(const std::vector<ResumenVuelo> &vuelos)
+{
+    EstadisticasEnlace enlace;
+    Extremos altura, roll, pitch, yaw;
+    int leidos=0, colisiones=0, conConsumo=0;
+    double sumaConsumo=0, sumaTiempoColision=0;
+
+    memset(&enlace,0,sizeof(enlace));
+    for (const ResumenVuelo &r : vuelos)
+    {
+        if (!r.leido) continue;
+        leidos++;
+        enlace.bytes+=r.enlace.bytes;
+        enlace.tramas+=r.enlace.tramas;
+        enlace.erroresCrc+=r.enlace.erroresCrc;
+        enlace.fragmentos+=r.enlace.fragmentos;
+        altura.anadir(r.altura);
+        roll.anadir(r.roll);
+        pitch.anadir(r.pitch);
+        yaw.anadir(r.yaw);
+        if (r.consumo()>0)
+        {
+            conConsumo++;
+            sumaConsumo+=r.consumo();
+        }
+        if (r.colision)
+        {
+            colisiones++;
+            sumaTiempoColision+=r.tiempoColision;
+        }
+    }
+
+    uint64_t total=enlace.tramas+enlace.erroresCrc;
+    printf("\nFlota: %d vuelos, %llu bytes\n",leidos,(unsigned long long)enlace.bytes);
+    printf("  %-12s %llu tramas, %llu errores CRC (%.3f%%), %llu fragmentos\n","enlace",
+           (unsigned long long)enlace.tramas,(unsigned long long)enlace.erroresCrc,
+           total ? 100.0*(double)enlace.erroresCrc/(double)total : 0.0,(unsigned long long)enlace.fragmentos);
+    imprimir_extremos("altura",altura);
+    imprimir_extremos("roll",roll);
+    imprimir_extremos("pitch",pitch);
+    imprimir_extremos("yaw",yaw);
+    if (conConsumo) printf("  %-12s consumo medio %.4f/s\n","combustible",sumaConsumo/conConsumo);
+    printf("  %-12s %d vuelos",  "colision",colisiones);
+    if (colisiones) printf(", tiempo medio hasta colision %.0f s",sumaTiempoColision/colisiones);
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned hilos=std::max(1u,std::thread::hardware_concurrency());
+    bool csv=false;
+    const char *directorio=nullptr;
+    const char *ficheroTraza=nullptr;
+
+    for (int i=1;i<argc;i++)
+    {
+        if (!strcmp(argv[i],"-j")&&(i+1<argc)) hilos=(unsigned)std::max(1,atoi(argv[++i]));
+        else if (!strcmp(argv[i],"--csv")) csv=true;
+        else if (!strcmp(argv[i],"--traza")&&(i+1<argc)) ficheroTraza=argv[++i];
+        else directorio=argv[i];
+    }
+    if (!directorio)
+    {
+        fprintf(stderr,"Uso: %s [-j hilos] [--csv] [--traza fichero.json] directorio\n",argv[0]);
+        return 1;
+    }
+    if (ficheroTraza) Traza::activar(true);
+
+    std::vector<ResumenVuelo> vuelos;
+    std::error_code error;
+    for (const auto &entrada : std::filesystem::directory_iterator(directorio,error))
+    {
+        if (!entrada.is_regular_file()) continue;
+        ResumenVuelo r{};
+        r.fichero=entrada.path().string();
+        vuelos.push_back(r);
+    }
+    if (error)
+    {
+        fprintf(stderr,"No se puede leer el directorio %s: %s\n",directorio,error.message().c_str());
+        return 1;
+    }
+    std::sort(vuelos.begin(),vuelos.end(),[](const ResumenVuelo &a, const ResumenVuelo &b) { return a.fichero<b.fichero; });
+
+    // Reparto dinamico: cada hilo coge el siguiente fichero libre, asi los vuelos largos no bloquean a los demas
+    std::atomic<size_t> siguiente(0);
+    std::vector<std::thread> trabajadores;
+    hilos=std::min<unsigned>(hilos,(unsigned)std::max<size_t>(1,vuelos.size()));
+    for (unsigned h=0;h<hilos;h++)
+        trabajadores.emplace_back([&]() {
+            Traza::nombrarHilo("analisis");
+            for (size_t i=siguiente++;i<vuelos.size();i=siguiente++)
+                analizar_fichero(vuelos[i]);
+        });
+    for (std::thread &t : trabajadores) t.join();
+
+    if (csv)
+        imprimir_csv(vuelos);
+    else
+    {
+        for (const ResumenVuelo &r : vuelos) imprimir_resumen(r);
+        imprimir_flota(vuelos);
+    }
+
+    if (ficheroTraza && !Traza::volcar(ficheroTraza))
+        fprintf(stderr,"No se puede escribir la traza en %s\n",ficheroTraza);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# Banco de pruebas de renderizado del GUI, sin pantalla (plataforma offscreen)
+# Compila el GUIPanel completo y le inyecta telemetria simulada con un reloj virtual
+#-------------------------------------------------
+
+TARGET = benchgui
+TEMPLATE = app
+CONFIG   += console
+CONFIG   -= app_bundle
+
+include(../../guipanel.pri)
+
+SOURCES += main.cpp \
+    ../../motorvuelo.cpp
+
+HEADERS += ../../motorvuelo.h
@@ -0,0 +1,278 @@
+// Banco de pruebas de renderizado del GUIPanel, sin pantalla. Crea el panel en la plataforma "offscreen" de Qt,
+// le inyecta la telemetria de un avion simulado (MotorVuelo) a las tasas indicadas y mide:
+//  - tiempo de pintado de cada widget (filtro de eventos sobre QEvent::Paint),
+//  - tiempo de cada frame (percentiles), y
+//  - CPU por mensaje, tanto de la decodificacion/despacho como del total incluyendo el pintado.
+//
+// No se ejecuta el bucle de eventos de Qt: el tiempo lo marca un reloj virtual que dispara los QTimer del panel
+// (aguja de velocidad, picado sin combustible...) y los frames se pintan procesando los eventos pendientes, asi
+// que los resultados no dependen de la carga de la maquina ni de la resolucion de sus temporizadores.
+//
+// Uso: benchgui [--duracion s] [--fps n] [--potenciometro Hz] [--altura Hz] [--combustible Hz] [--reloj Hz]
+//               [--semilla n] [--traza fichero.json]
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+#include <QWidget>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "guipanel.h"
+#include "motorvuelo.h"
+#include "telemetria.h"
+#include "traza.h"
+
+// Paso del simulador y del reloj virtual (ms)
+#define PASO_MS 10
+
+static double cpu_hilo()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&t);
+    return (double)t.tv_sec+(double)t.tv_nsec*1e-9;
+}
+
+// Reloj virtual. Los QTimer del panel nunca llegan a dispararse por si solos (no hay bucle de eventos); en su
+// lugar, cada vez que avanza el reloj se buscan los temporizadores activos y se emite su timeout() en el
+// instante virtual que les corresponde
+class RelojVirtual
+{
+public:
+    explicit RelojVirtual(QObject *raiz) : raiz(raiz), ahora(0) {}
+
+    void avanzar(qint64 ms)
+    {
+        qint64 objetivo=ahora+ms;
+        for (;;)
+        {
+            capturar();
+            int proximo=-1;
+            for (int i=0;i<temporizadores.size();i++)
+                if ((temporizadores[i].siguiente<=objetivo) &&
+                    ((proximo<0)||(temporizadores[i].siguiente<temporizadores[proximo].siguiente)))
+                    proximo=i;
+            if (proximo<0) break;
+
+            Temporizador &t=temporizadores[proximo];
+            ahora=t.siguiente;
+            t.siguiente+=std::max(1,t.timer->interval());
+            if (t.timer->isSingleShot()) t.timer->stop();
+            QMetaObject::invokeMethod(t.timer, "timeout", Qt::DirectConnection);
+        }
+        ahora=objetivo;
+    }
+
+    qint64 milisegundos() const { return ahora; }
+
+private:
+    struct Temporizador {
+        QPointer<QTimer> timer;
+        qint64 siguiente;
+    };
+
+    // Sincroniza la lista con los temporizadores que el panel tiene arrancados en este momento
+    void capturar()
+    {
+        for (int i=temporizadores.size()-1;i>=0;i--)
+            if (!temporizadores[i].timer || !temporizadores[i].timer->isActive())
+                temporizadores.removeAt(i);
+
+        foreach (QTimer *timer, raiz->findChildren<QTimer *>())
+        {
+            if (!timer->isActive()) continue;
+            bool conocido=false;
+            for (const Temporizador &t : temporizadores)
+                if (t.timer==timer) conocido=true;
+            if (!conocido)
+            {
+                Temporizador t;
+                t.timer=timer;
+                t.siguiente=ahora+std::max(1,timer->interval());
+                temporizadores.append(t);
+            }
+        }
+    }
+
+    QObject *raiz;
+    qint64 ahora;
+    QList<Temporizador> temporizadores;
+};
+
+// Filtro que mide el tiempo de cada QEvent::Paint. El evento se entrega desde el propio filtro para poder
+// cronometrarlo, y se devuelve true para que Qt no lo entregue otra vez
+class MedidorPintado : public QObject
+{
+public:
+    struct Medida {
+        int pintados;
+        double total;      // s
+        double maximo;     // s
+    };
+
+    void instalar(QWidget *raiz)
+    {
+        raiz->installEventFilter(this);
+        foreach (QWidget *w, raiz->findChildren<QWidget *>())
+            w->installEventFilter(this);
+    }
+
+    QHash<QString, Medida> medidas;
+
+protected:
+    bool eventFilter(QObject *objeto, QEvent *evento) override
+    {
+        if (evento->type()!=QEvent::Paint) return false;
+
+        // Los viewports de los QGraphicsView no tienen nombre: se identifican por el de su padre
+        QString nombre=objeto->objectName();
+        if (nombre.isEmpty() && objeto->parent())
+            nombre=objeto->parent()->objectName()+QStringLiteral("/")+QString::fromLatin1(objeto->metaObject()->className());
+
+        QElapsedTimer cronometro;
+        cronometro.start();
+        {
+            // Este filtro entrega el evento el mismo, asi que tambien es el que lo anota en la traza
+            SpanTraza span("pintado", Traza::activada() ? Traza::internar(nombre.toUtf8().constData()) : "");
+            objeto->event(evento);
+        }
+        double t=(double)cronometro.nsecsElapsed()*1e-9;
+
+        Medida &m=medidas[nombre];
+        m.pintados++;
+        m.total+=t;
+        m.maximo=std::max(m.maximo,t);
+        return true;
+    }
+};
+
+static int periodo_pasos(double hz)
+{
+    return (hz>0) ? std::max(1,(int)(1000.0/(hz*PASO_MS)+0.5)) : 0;
+}
+
+static double percentil(const std::vector<double> &ordenados, double p)
+{
+    if (ordenados.empty()) return 0.0;
+    size_t i=(size_t)(p*(double)(ordenados.size()-1)+0.5);
+    return ordenados[i];
+}
+
+int main(int argc, char *argv[])
+{
+    double duracion=60, fps=60, hzPotenciometro=20, hzAltura=5, hzCombustible=1, hzReloj=1;
+    unsigned long long semilla=1;
+    const char *ficheroTraza=nullptr;
+
+    for (int i=1;i+1<argc;i+=2)
+    {
+        if (!strcmp(argv[i],"--duracion")) duracion=atof(argv[i+1]);
+        else if (!strcmp(argv[i],"--fps")) fps=atof(argv[i+1]);
+        else if (!strcmp(argv[i],"--potenciometro")) hzPotenciometro=atof(argv[i+1]);
+        else if (!strcmp(argv[i],"--altura")) hzAltura=atof(argv[i+1]);
+        else if (!strcmp(argv[i],"--combustible")) hzCombustible=atof(argv[i+1]);
+        else if (!strcmp(argv[i],"--reloj")) hzReloj=atof(argv[i+1]);
+        else if (!strcmp(argv[i],"--semilla")) semilla=strtoull(argv[i+1],nullptr,0);
+        else if (!strcmp(argv[i],"--traza")) ficheroTraza=argv[i+1];
+    }
+    if (fps<=0) fps=60;
+
+    // Sin pantalla, salvo que se pida expresamente otra plataforma
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM","offscreen");
+
+    QApplication a(argc, argv);
+    GUIPanel panel;
+    panel.show();
+    QCoreApplication::sendPostedEvents();           // Inicializacion diferida de los indicadores (showEvent)
+
+    // Se habilitan los indicadores como al pulsar RUN, pero sin abrir el puerto serie
+    foreach (QWidget *w, panel.findChildren<QWidget *>())
+        w->setEnabled(true);
+
+    if (ficheroTraza) Traza::activar(true);
+
+    MedidorPintado medidor;
+    medidor.instalar(&panel);
+    RelojVirtual reloj(&panel);
+
+    MotorVuelo motor(1, semilla, PASO_MS/1000.0f);
+    PeriodosCanales periodos={periodo_pasos(hzPotenciometro),0,periodo_pasos(hzAltura),
+                              periodo_pasos(hzCombustible),periodo_pasos(hzReloj)};
+    motor.setPeriodos(periodos);
+
+    DecodificadorTramas contador;                  // Solo para contar los mensajes inyectados
+    std::vector<uint8_t> bytes;
+    std::vector<double> frames;
+    uint64_t mensajes=0;
+    double cpuDespacho=0;
+    double msPorFrame=1000.0/fps, siguienteFrame=0;
+    double cpuInicio=cpu_hilo();
+
+    while (reloj.milisegundos()<(qint64)(duracion*1000))
+    {
+        motor.avanzar();
+        bytes.clear();
+        motor.emitirTramas(0,bytes);
+        if (!bytes.empty())
+        {
+            mensajes+=(uint64_t)contador.anadir(bytes.data(),bytes.size(),[](const MensajeDecodificado &) {});
+            double c0=cpu_hilo();
+            // Con el instante del reloj virtual: con el del panel, las tendencias y las ventanas de las alarmas verian
+            // el tiempo comprimido y saltarian reglas (y repintados) que no son de la carga
+            panel.recibirDatos(QByteArray((const char *)bytes.data(),(int)bytes.size()),
+                               (uint64_t)reloj.milisegundos()*1000);
+            cpuDespacho+=cpu_hilo()-c0;
+        }
+        reloj.avanzar(PASO_MS);
+
+        // Frame: se procesan los eventos pendientes (repintados incluidos) como haria el bucle de eventos
+        if ((double)reloj.milisegundos()>=siguienteFrame)
+        {
+            siguienteFrame+=msPorFrame;
+            QElapsedTimer cronometro;
+            cronometro.start();
+            QCoreApplication::sendPostedEvents();
+            frames.push_back((double)cronometro.nsecsElapsed()*1e-6);
+        }
+    }
+    double cpuTotal=cpu_hilo()-cpuInicio;
+
+    std::sort(frames.begin(),frames.end());
+    printf("Duracion virtual %.0f s, %llu mensajes, %zu frames\n",duracion,(unsigned long long)mensajes,frames.size());
+    printf("Frame (ms): p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",percentil(frames,0.5),percentil(frames,0.9),
+           percentil(frames,0.99),frames.empty()?0.0:frames.back());
+    if (mensajes)
+        printf("CPU por mensaje (us): despacho %.2f  total con pintado %.2f\n",1e6*cpuDespacho/(double)mensajes,
+               1e6*cpuTotal/(double)mensajes);
+
+    const EstadisticasCola &cola=panel.estadisticasCola();
+    printf("Cola: despachados %llu criticos, %llu eventos, %llu periodicos; descartados %llu sustituidos, %llu obsoletos\n",
+           (unsigned long long)cola.despachados[PRIORIDAD_CRITICA],(unsigned long long)cola.despachados[PRIORIDAD_EVENTO],
+           (unsigned long long)cola.despachados[PRIORIDAD_PERIODICA],(unsigned long long)cola.colapsados,
+           (unsigned long long)cola.obsoletos);
+
+    QList<QString> nombres=medidor.medidas.keys();
+    std::sort(nombres.begin(),nombres.end(),[&medidor](const QString &x, const QString &y) {
+        return medidor.medidas[x].total>medidor.medidas[y].total;
+    });
+    printf("\n%-40s %8s %12s %12s %12s\n","widget","pintados","total (ms)","medio (us)","max (us)");
+    foreach (const QString &nombre, nombres)
+    {
+        const MedidorPintado::Medida &m=medidor.medidas[nombre];
+        printf("%-40s %8d %12.2f %12.1f %12.1f\n",nombre.toLocal8Bit().constData(),m.pintados,1e3*m.total,
+               1e6*m.total/m.pintados,1e6*m.maximo);
+    }
+
+    if (ficheroTraza && !Traza::volcar(ficheroTraza))
+        fprintf(stderr,"No se puede escribir la traza en %s\n",ficheroTraza);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# Ejemplo de lector de la telemetria en memoria compartida (C, sin Qt)
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = lectorshm
+CONFIG += console
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../..
+LIBS += -lrt
+
+SOURCES += main.c \
+    ../../telemetria_shm.c
+
+HEADERS += ../../telemetria_shm.h
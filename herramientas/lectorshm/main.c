@@ -0,0 +1,60 @@
+// Ejemplo de uso de la libreria de lectura de telemetria_shm: muestra el estado del avion publicado por el GUI
+// (GUIPanel --shm) cada medio segundo, y los eventos nuevos segun llegan.
+//
+// Uso: lectorshm [nombre del segmento]
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "telemetria_shm.h"
+#include "usb_messages_table.h"
+
+int main(int argc, char *argv[])
+{
+    const char *nombre=(argc>1) ? argv[1] : SHM_TELEMETRIA_NOMBRE;
+    shm_telemetria_t *shm=shm_telemetria_abrir(nombre);
+    estado_telemetria_t estado;
+    evento_telemetria_t evento;
+    uint64_t cursor, perdidos=0;
+
+    if (!shm)
+    {
+        fprintf(stderr,"No se puede abrir el segmento %s (¿esta el GUI en marcha con --shm?)\n",nombre);
+        return 1;
+    }
+    cursor=shm_telemetria_eventos_escritos(shm);   // Solo los eventos a partir de ahora
+
+    for (;;)
+    {
+        int r=shm_telemetria_leer(shm,&estado);
+        if (r==-2)
+        {
+            fprintf(stderr,"El segmento %s no se actualiza (¿ha terminado el GUI a mitad de una publicacion?)\n",
+                    nombre);
+            shm_telemetria_cerrar(shm);
+            return 1;
+        }
+        if (r==0)
+            printf("reloj %5u s  altura %8.1f m  combustible %6.2f  velocidad %6.1f km/h  "
+                   "roll %4u pitch %4u yaw %4u  mensajes %llu (CRC %llu)%s\n",
+                   estado.reloj,estado.altura,estado.combustible,estado.velocidad,estado.roll,estado.pitch,
+                   estado.yaw,(unsigned long long)estado.mensajes,(unsigned long long)estado.errores_crc,
+                   estado.colision ? "  COLISION" : "");
+
+        while (shm_telemetria_siguiente_evento(shm,&cursor,&evento,&perdidos))
+        {
+            switch (evento.tipo)
+            {
+            case MENSAJE_COLISION: printf("  evento %llu: colision\n",(unsigned long long)evento.secuencia); break;
+            case MENSAJE_COMBUSTIBLE: printf("  evento %llu: sin combustible\n",(unsigned long long)evento.secuencia); break;
+            case MENSAJE_MSG_RADIO: printf("  evento %llu: radio \"%.*s\"\n",(unsigned long long)evento.secuencia,
+                                           (int)evento.longitud,(const char *)evento.datos); break;
+            default: printf("  evento %llu: tipo %u\n",(unsigned long long)evento.secuencia,evento.tipo); break;
+            }
+        }
+        if (perdidos) printf("  (%llu eventos perdidos)\n",(unsigned long long)perdidos);
+        perdidos=0;
+        fflush(stdout);
+        usleep(500000);
+    }
+}
@@ -0,0 +1,374 @@
+// Panel de vuelo en modo texto, para estaciones de tierra modestas o sesiones SSH. Lee el puerto serie (o la
+// entrada estandar, p.ej. una captura de simuladorvuelo) con la misma decodificacion que el GUI (telemetria.cpp,
+// colamensajes.cpp y filtroactitud.cpp) y pinta con secuencias ANSI la actitud, la velocidad, el combustible, la
+// altura, el reloj, el ultimo mensaje de radio y las estadisticas del enlace. La pantalla se repinta como mucho
+// 'hz' veces por segundo, sin importar cuantas tramas lleguen; entre repintados solo se decodifica.
+//
+// No usa Qt: un solo hilo con poll(), sin Qwt ni QtSvg.
+//
+// Uso: panelterminal [-r hz] [-b baudios] [--compacta] (dispositivo | -)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include <string>
+#include <vector>
+
+#include "telemetria.h"
+#include "colamensajes.h"
+#include "filtroactitud.h"
+
+#define TAM_LECTURA 4096
+
+static volatile sig_atomic_t terminar=0;
+
+static void al_terminar(int)
+{
+    terminar=1;
+}
+
+static uint64_t ahora_us()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000u+(uint64_t)t.tv_nsec/1000u;
+}
+
+static speed_t velocidad_termios(int baudios)
+{
+    switch (baudios)
+    {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return 0;
+    }
+}
+
+// Misma configuracion que GUIPanel::startSlave: 8N1, sin control de flujo, en modo raw
+static int abrir_puerto(const char *dispositivo, int baudios)
+{
+    int fd=open(dispositivo,O_RDWR|O_NOCTTY|O_NONBLOCK);
+    if (fd<0) return -1;
+
+    struct termios tio;
+    if (tcgetattr(fd,&tio)==0)
+    {
+        cfmakeraw(&tio);
+        tio.c_cflag&=~(CSTOPB|PARENB|CRTSCTS);
+        tio.c_cflag|=CS8|CLOCAL|CREAD;
+        cfsetispeed(&tio,velocidad_termios(baudios));
+        cfsetospeed(&tio,velocidad_termios(baudios));
+        tcsetattr(fd,TCSANOW,&tio);
+    }
+    return fd;
+}
+
+static void enviar(int fd, uint8_t tipo, void *parametro, int32_t tam)
+{
+    uint8_t trama[MAX_FRAME_SIZE];
+    int32_t size=create_frame(trama,tipo,parametro,tam,MAX_FRAME_SIZE);
+    if ((size>0)&&(write(fd,trama,(size_t)size)!=size))
+        fprintf(stderr,"No se puede escribir en el puerto: %s\n",strerror(errno));
+}
+
+// Ultimo estado conocido del avion
+struct Estado {
+    bool hayVelocidad, hayCombustible, hayAltura, hayReloj;
+    float velocidad, combustible, altura;
+    uint32_t reloj;
+    bool colision;
+    std::string radio;
+    uint64_t mensajes;
+    uint64_t rechazados;       // MENSAJE_NO_IMPLEMENTADO
+    uint64_t inesperados;
+
+    Estado() : hayVelocidad(false), hayCombustible(false), hayAltura(false), hayReloj(false),
+        velocidad(0), combustible(0), altura(0), reloj(0), colision(false), mensajes(0), rechazados(0), inesperados(0) {}
+};
+
+static void procesar_mensaje(Estado &e, std::vector<MuestraAdc> &lote, const MensajeDecodificado &m)
+{
+    if (m.error) return;
+    e.mensajes++;
+    if (!m.parametroValido) return;
+
+    switch (m.tipo)
+    {
+    case MENSAJE_POTENCIOMETRO:
+    {
+        VistaPotenciometro giro=m.vista<VistaPotenciometro>();
+        MuestraAdc muestra;
+        muestra.eje[EJE_ROLL]=giro.roll()&0xFFF;
+        muestra.eje[EJE_PITCH]=giro.pitch()&0xFFF;
+        muestra.eje[EJE_YAW]=giro.yaw()&0xFFF;
+        lote.push_back(muestra);
+    }
+        break;
+    case MENSAJE_VELOCIDAD:
+        e.hayVelocidad=true;
+        e.velocidad=m.vista<VistaVelocidad>().velocidad();
+        break;
+    case MENSAJE_COMBUSTIBLE:
+        e.hayCombustible=true;
+        e.combustible=m.vista<VistaCombustible>().combustible();
+        break;
+    case MENSAJE_ALTURA:
+        e.hayAltura=true;
+        e.altura=m.vista<VistaAltura>().altura();
+        break;
+    case MENSAJE_RELOJ:
+        e.hayReloj=true;
+        e.reloj=m.vista<VistaReloj>().reloj();
+        break;
+    case MENSAJE_COLISION:
+        e.colision=true;
+        break;
+    case MENSAJE_MSG_RADIO:
+    {
+        VistaRadio radio=m.vista<VistaRadio>();
+        e.radio.assign(radio.texto(),radio.longitud());
+    }
+        break;
+    case MENSAJE_NO_IMPLEMENTADO:
+        e.rechazados++;
+        break;
+    case MENSAJE_PING:
+    case MENSAJE_CONTROL_FLUJO:
+    case MENSAJE_SINCRONIZACION:
+    case MENSAJE_CODIFICACION:
+    case MENSAJE_SUSCRIPCION:
+    case MENSAJE_PRUEBA_ECO:
+    case MENSAJE_PRUEBA_RESUMEN:
+        break;
+    default:
+        e.inesperados++;
+        break;
+    }
+}
+
+// Barra horizontal de 'ancho' caracteres con la fraccion 'v' (0-1) llena
+static std::string barra(double v, int ancho)
+{
+    int llenos=(int)(v*ancho+0.5);
+    if (llenos<0) llenos=0;
+    if (llenos>ancho) llenos=ancho;
+    return "["+std::string((size_t)llenos,'#')+std::string((size_t)(ancho-llenos),'.')+"]";
+}
+
+// Indicador de un angulo en [minimo,maximo]: una marca sobre una escala con el cero en el centro
+static std::string escala(double grados, double minimo, double maximo, int ancho)
+{
+    std::string s((size_t)ancho,'-');
+    s[(size_t)(ancho/2)]='|';
+    int pos=(int)((grados-minimo)/(maximo-minimo)*(ancho-1)+0.5);
+    if (pos<0) pos=0;
+    if (pos>ancho-1) pos=ancho-1;
+    s[(size_t)pos]='O';
+    return "["+s+"]";
+}
+
+// Pinta todo en un buffer y lo escribe de una vez, para que el terminal no muestre la pantalla a medias
+static void pintar(const Estado &e, const FiltroActitud &filtro, const EstadisticasEnlace &enlace,
+                   const EstadisticasCola &cola, const char *origen, double bytesPorSegundo, double tramasPorSegundo)
+{
+    std::string p="\x1b[H";    // Cursor al principio; cada linea se termina borrando hasta el final
+    char linea[160];
+    auto anadir=[&p](const char *texto) { p+=texto; p+="\x1b[K\n"; };
+
+    snprintf(linea,sizeof(linea),"GUIPanel (terminal) - %s%s",origen,e.colision ? "   *** COLISION ***" : "");
+    anadir(linea);
+    anadir("");
+
+    if (filtro.hayDatos())
+    {
+        const char *nombres[NUM_EJES]={"Roll ","Pitch","Yaw  "};
+        for (int eje=0;eje<NUM_EJES;eje++)
+        {
+            const CalibracionEje &cal=filtro.calibracion((EjeActitud)eje);
+            double g=filtro.grados((EjeActitud)eje);
+            snprintf(linea,sizeof(linea),"  %s %8.1f deg  %s",nombres[eje],g,escala(g,cal.minimo,cal.maximo,41).c_str());
+            anadir(linea);
+        }
+    }
+    else
+        for (int eje=0;eje<NUM_EJES;eje++) anadir(eje ? "" : "  Actitud       sin datos");
+    anadir("");
+
+    if (e.hayVelocidad) snprintf(linea,sizeof(linea),"  Velocidad   %8.1f km/h %s",e.velocidad,barra(e.velocidad/200.0,30).c_str());
+    else snprintf(linea,sizeof(linea),"  Velocidad        ---");
+    anadir(linea);
+    if (e.hayCombustible)
+        snprintf(linea,sizeof(linea),"  Combustible %8.2f      %s%s",e.combustible,barra(e.combustible/100.0,30).c_str(),
+                 e.combustible<=0 ? "  SIN COMBUSTIBLE" : "");
+    else snprintf(linea,sizeof(linea),"  Combustible      ---");
+    anadir(linea);
+    if (e.hayAltura) snprintf(linea,sizeof(linea),"  Altura      %8.1f m    %s",e.altura,barra(e.altura/6000.0,30).c_str());
+    else snprintf(linea,sizeof(linea),"  Altura           ---");
+    anadir(linea);
+    // El reloj del GUI avanza un minuto por cada segundo de la TIVA
+    if (e.hayReloj) snprintf(linea,sizeof(linea),"  Reloj          %02u:%02u",(e.reloj/60)%24,e.reloj%60);
+    else snprintf(linea,sizeof(linea),"  Reloj            ---");
+    anadir(linea);
+    anadir("");
+
+    snprintf(linea,sizeof(linea),"  Radio: %s",e.radio.c_str());
+    anadir(linea);
+    anadir("");
+
+    uint64_t total=enlace.tramas+enlace.erroresCrc;
+    snprintf(linea,sizeof(linea),"  Enlace: %.0f B/s, %.0f tramas/s, %llu tramas, %llu errores CRC (%.3f%%), %llu fragmentos",
+             bytesPorSegundo,tramasPorSegundo,(unsigned long long)enlace.tramas,(unsigned long long)enlace.erroresCrc,
+             total ? 100.0*(double)enlace.erroresCrc/(double)total : 0.0,(unsigned long long)enlace.fragmentos);
+    anadir(linea);
+    snprintf(linea,sizeof(linea),"  Cola: %llu sustituidas, %llu obsoletas, %llu eventos adelantados; %llu rechazados, %llu inesperados",
+             (unsigned long long)cola.colapsados,(unsigned long long)cola.obsoletos,(unsigned long long)cola.adelantados,
+             (unsigned long long)e.rechazados,(unsigned long long)e.inesperados);
+    anadir(linea);
+    p+="\x1b[J";
+
+    if (write(STDOUT_FILENO,p.data(),p.size())<0) terminar=1;
+}
+
+int main(int argc, char *argv[])
+{
+    double hz=4.0;
+    int baudios=9600;
+    bool compacta=false;
+    const char *origen=nullptr;
+
+    for (int i=1;i<argc;i++)
+    {
+        if (!strcmp(argv[i],"-r")&&(i+1<argc)) hz=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-b")&&(i+1<argc)) baudios=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--compacta")) compacta=true;
+        else if (!origen) origen=argv[i];
+        else origen=nullptr, i=argc;
+    }
+    if (!origen||(hz<=0)||(hz>60)||!velocidad_termios(baudios))
+    {
+        fprintf(stderr,"Uso: %s [-r hz] [-b baudios] [--compacta] (dispositivo | -)\n",argv[0]);
+        return 1;
+    }
+
+    // Con '-' se lee la entrada estandar (no se envia nada); con un dispositivo se arranca el vuelo como el boton RUN
+    bool puerto=strcmp(origen,"-")!=0;
+    int fd=puerto ? abrir_puerto(origen,baudios) : STDIN_FILENO;
+    if (fd<0)
+    {
+        fprintf(stderr,"No se puede abrir %s: %s\n",origen,strerror(errno));
+        return 1;
+    }
+    if (puerto)
+    {
+        enviar(fd,MENSAJE_INICIO,nullptr,0);
+        if (compacta)
+        {
+            // El decodificador entiende las dos codificaciones, asi que no hace falta esperar la respuesta
+            PARAM_MENSAJE_CODIFICACION c;
+            c.codificacion=CODIFICACION_COMPACTA;
+            enviar(fd,MENSAJE_CODIFICACION,&c,sizeof(c));
+        }
+    }
+
+    signal(SIGINT,al_terminar);
+    signal(SIGTERM,al_terminar);
+    signal(SIGPIPE,SIG_IGN);
+
+    DecodificadorTramas decodificador;
+    ColaMensajes cola;
+    FiltroActitud filtro;
+    std::vector<MuestraAdc> lote;
+    lote.reserve(64);
+    Estado estado;
+
+    const uint64_t periodo=(uint64_t)(1e6/hz);
+    uint64_t siguiente=ahora_us();
+    uint64_t inicioVentana=siguiente, bytesVentana=0, tramasVentana=0;
+    double bytesPorSegundo=0, tramasPorSegundo=0;
+    bool finDatos=false;
+    const char *errorPuerto=nullptr;   // El dispositivo ha desaparecido (p.ej. se ha desconectado la TIVA)
+    uint8_t buffer[TAM_LECTURA];
+
+    fputs("\x1b[?25l\x1b[2J",stdout);   // Sin cursor y con la pantalla limpia
+    fflush(stdout);
+
+    while (!terminar)
+    {
+        uint64_t ahora=ahora_us();
+        if (ahora>=siguiente)
+        {
+            // Tasas del enlace medidas sobre el ultimo segundo (o lo que haya pasado)
+            if (ahora-inicioVentana>=1000000)
+            {
+                double s=(double)(ahora-inicioVentana)/1e6;
+                bytesPorSegundo=(double)(decodificador.estadisticas().bytes-bytesVentana)/s;
+                tramasPorSegundo=(double)(decodificador.estadisticas().tramas-tramasVentana)/s;
+                inicioVentana=ahora;
+                bytesVentana=decodificador.estadisticas().bytes;
+                tramasVentana=decodificador.estadisticas().tramas;
+            }
+            pintar(estado,filtro,decodificador.estadisticas(),cola.estadisticas(),origen,bytesPorSegundo,tramasPorSegundo);
+            siguiente+=periodo;
+            if (siguiente<ahora) siguiente=ahora+periodo;   // Sin repintados atrasados acumulados
+            continue;
+        }
+        if (finDatos)
+        {
+            // Se ha acabado la entrada: se deja el ultimo estado en pantalla hasta Ctrl+C
+            usleep((useconds_t)(siguiente-ahora));
+            continue;
+        }
+
+        struct pollfd pfd={fd,POLLIN,0};
+        int r=poll(&pfd,1,(int)((siguiente-ahora+999)/1000));
+        if ((r<0)&&(errno!=EINTR)) break;
+        if (r<=0) continue;
+
+        // Con POLLHUP o POLLERR poll() vuelve enseguida en cada vuelta: en cuanto no queda nada por leer, el
+        // dispositivo se ha perdido (p.ej. se ha desconectado la TIVA) y se termina
+        ssize_t n=read(fd,buffer,sizeof(buffer));
+        if (n<=0)
+        {
+            bool reintentar=(n<0)&&((errno==EAGAIN)||(errno==EINTR));
+            bool perdido=!reintentar&&((n<0)||(pfd.revents&(POLLHUP|POLLERR|POLLNVAL)));
+            if (!puerto) finDatos=!reintentar;   // Fin de la captura: se deja el ultimo estado
+            else if (perdido)
+            {
+                errorPuerto=(n<0) ? strerror(errno) : "dispositivo cerrado";
+                break;
+            }
+            continue;
+        }
+
+        // Igual que GUIPanel::recibirDatos: decodificacion a la cola, despacho por prioridades y filtrado de la
+        // actitud por lotes
+        decodificador.anadir(buffer,(size_t)n,[&cola](const MensajeDecodificado &m) { cola.encolar(m); });
+        cola.despachar([&estado,&lote](const MensajeDecodificado &m) { procesar_mensaje(estado,lote,m); });
+        if (!lote.empty())
+        {
+            filtro.procesar(lote.data(),lote.size());
+            lote.clear();
+        }
+    }
+
+    fputs("\x1b[?25h\n",stdout);
+    fflush(stdout);
+    if (puerto) close(fd);
+    if (errorPuerto)
+    {
+        fprintf(stderr,"Error leyendo %s: %s\n",origen,errorPuerto);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# Panel de vuelo en modo texto (terminal o SSH), alternativa ligera al GUIPanel
+# Reutiliza la decodificacion, la cola de prioridades y el filtro de actitud del GUI
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = panelterminal
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../..
+LIBS += -lpthread
+
+SOURCES += main.cpp \
+    ../../telemetria.cpp \
+    ../../colamensajes.cpp \
+    ../../filtroactitud.cpp \
+    ../../traza.cpp \
+    ../../serial2USBprotocol.cpp
+
+HEADERS += ../../telemetria.h \
+    ../../colamensajes.h \
+    ../../filtroactitud.h \
+    ../../vistasmensajes.h \
+    ../../traza.h \
+    ../../serial2USBprotocol.h \
+    ../../codectramas.h \
+    ../../empaquetado.h \
+    ../../usb_messages_table.h
@@ -0,0 +1,241 @@
+// Prueba de rendimiento del enlace serie con la TIVA (o con simuladorvuelo --pty), al estilo de iperf. Para cada
+// velocidad de la lista y cada tamaño de carga satura el enlace durante el tiempo indicado (ver pruebaenlace.h) y
+// escribe una fila con el caudal util, el coste del stuffing, las perdidas y la latencia de ida y vuelta.
+// Con -h se escribe ademas el histograma de latencia de cada prueba de eco.
+//
+// No usa Qt: un solo hilo con poll(), como panelterminal.
+//
+// Uso: pruebaenlace [-m eco|sumidero] [-b baudios,...] [-c carga,...] [-e densidad] [-t segundos] [-v ventana] [-h]
+//                   dispositivo
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include <vector>
+
+#include "telemetria.h"
+#include "pruebaenlace.h"
+
+static uint64_t ahora_us()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000u+(uint64_t)t.tv_nsec/1000u;
+}
+
+static speed_t velocidad_termios(int baudios)
+{
+    switch (baudios)
+    {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+    }
+}
+
+// Misma configuracion que GUIPanel::startSlave: 8N1, sin control de flujo, en modo raw
+static int abrir_puerto(const char *dispositivo, int baudios)
+{
+    int fd=open(dispositivo,O_RDWR|O_NOCTTY|O_NONBLOCK);
+    if (fd<0) return -1;
+
+    struct termios tio;
+    if (tcgetattr(fd,&tio)==0)
+    {
+        cfmakeraw(&tio);
+        tio.c_cflag&=~(CSTOPB|PARENB|CRTSCTS);
+        tio.c_cflag|=CS8|CLOCAL|CREAD;
+        cfsetispeed(&tio,velocidad_termios(baudios));
+        cfsetospeed(&tio,velocidad_termios(baudios));
+        tcsetattr(fd,TCSANOW,&tio);
+    }
+    tcflush(fd,TCIOFLUSH);
+    return fd;
+}
+
+// Lista de enteros separados por comas
+static std::vector<int> leer_lista(const char *texto)
+{
+    std::vector<int> valores;
+    const char *p=texto;
+    while (*p)
+    {
+        char *fin;
+        long v=strtol(p,&fin,10);
+        if (fin==p) return std::vector<int>();
+        valores.push_back((int)v);
+        p=(*fin==',') ? fin+1 : fin;
+    }
+    return valores;
+}
+
+// Ejecuta una prueba completa sobre el puerto ya abierto. Las tramas que no son de la prueba (la telemetria que
+// siga enviando la TIVA) se decodifican y se ignoran. Devuelve false si falla el puerto
+static bool ejecutar(int fd, PruebaEnlace &prueba, EstadisticasEnlace &enlace)
+{
+    DecodificadorTramas decodificador;
+    uint8_t trama[MAX_FRAME_SIZE];
+    uint8_t buffer[4096];
+    int32_t pendiente=0, escrito=0;     // Trama a medio escribir cuando el puerto no admite mas
+
+    while (!prueba.terminada())
+    {
+        uint64_t ahora=ahora_us();
+        if (escrito>=pendiente)
+        {
+            pendiente=prueba.generar(trama,ahora);
+            escrito=0;
+        }
+        while (escrito<pendiente)
+        {
+            ssize_t n=write(fd,trama+escrito,(size_t)(pendiente-escrito));
+            if (n<0)
+            {
+                if (errno==EAGAIN || errno==EINTR) break;
+                return false;
+            }
+            escrito+=(int32_t)n;
+            if (escrito>=pendiente)
+            {
+                pendiente=prueba.generar(trama,ahora_us());
+                escrito=0;
+            }
+        }
+
+        // Se espera a que llegue algo o a que se pueda seguir escribiendo (como mucho 1 ms, para los plazos)
+        struct pollfd pfd={fd,(short)(POLLIN|((escrito<pendiente) ? POLLOUT : 0)),0};
+        int r=poll(&pfd,1,1);
+        if ((r<0)&&(errno!=EINTR)) return false;
+        if ((r<=0)||!(pfd.revents&POLLIN)) continue;
+
+        ssize_t n=read(fd,buffer,sizeof(buffer));
+        if (n<0 && errno!=EAGAIN && errno!=EINTR) return false;
+        if (n<=0) continue;
+        uint64_t recepcion=ahora_us();
+        decodificador.anadir(buffer,(size_t)n,[&prueba,recepcion](const MensajeDecodificado &m) {
+            prueba.recibir(m,recepcion);
+        });
+    }
+    enlace=decodificador.estadisticas();
+    return true;
+}
+
+static void escribir_histograma(const PruebaEnlace &prueba)
+{
+    const uint64_t *h=prueba.histogramaLatencia();
+    uint64_t maximo=0;
+    for (int i=0;i<NUM_CUBETAS_LATENCIA;i++) if (h[i]>maximo) maximo=h[i];
+    if (!maximo) return;
+
+    for (int i=0;i<NUM_CUBETAS_LATENCIA;i++)
+    {
+        if (!h[i]) continue;
+        int ancho=(int)(40*h[i]/maximo);
+        printf("    %9.3f ms %8llu ",(double)(1u<<i)/1000.0,(unsigned long long)h[i]);
+        for (int j=0;j<ancho;j++) putchar('#');
+        putchar('\n');
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ConfigPrueba config;
+    std::vector<int> bauds(1,115200), cargas(1,MAX_CARGA_PRUEBA);
+    bool histograma=false, valido=true;
+    const char *dispositivo=nullptr;
+
+    for (int i=1;i<argc;i++)
+    {
+        if (!strcmp(argv[i],"-m")&&(i+1<argc))
+        {
+            i++;
+            if (!strcmp(argv[i],"eco")) config.modo=PRUEBA_ECO;
+            else if (!strcmp(argv[i],"sumidero")) config.modo=PRUEBA_SUMIDERO;
+            else valido=false;
+        }
+        else if (!strcmp(argv[i],"-b")&&(i+1<argc)) bauds=leer_lista(argv[++i]);
+        else if (!strcmp(argv[i],"-c")&&(i+1<argc)) cargas=leer_lista(argv[++i]);
+        else if (!strcmp(argv[i],"-e")&&(i+1<argc)) config.densidadEscape=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-t")&&(i+1<argc)) config.duracionUs=(uint64_t)(atof(argv[++i])*1e6);
+        else if (!strcmp(argv[i],"-v")&&(i+1<argc)) config.ventana=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-h")) histograma=true;
+        else if (!dispositivo) dispositivo=argv[i];
+        else valido=false;
+    }
+    for (size_t i=0;i<bauds.size();i++) if (!velocidad_termios(bauds[i])) valido=false;
+    for (size_t i=0;i<cargas.size();i++) if ((cargas[i]<0)||(cargas[i]>MAX_CARGA_PRUEBA)) valido=false;
+    if (!valido||!dispositivo||bauds.empty()||cargas.empty()||(config.duracionUs==0)||(config.ventana<1)||
+        (config.densidadEscape<0)||(config.densidadEscape>1))
+    {
+        fprintf(stderr,"Uso: %s [-m eco|sumidero] [-b baudios,...] [-c carga,...] [-e densidad] [-t segundos] "
+                       "[-v ventana] [-h] dispositivo\n",argv[0]);
+        return 1;
+    }
+
+    printf("%s, %s, densidad de escape %.2f, %.1f s por prueba\n",dispositivo,
+           (config.modo==PRUEBA_ECO) ? "eco" : "sumidero",config.densidadEscape,config.duracionUs/1e6);
+    printf("%8s %5s %8s %10s %6s %9s %8s %9s %27s\n","baudios","carga","tramas/s","util kbps","uso %","stuffing",
+           "perdidas","err. CRC","latencia p50/p90/p99/max ms");
+
+    for (size_t b=0;b<bauds.size();b++)
+    {
+        int fd=abrir_puerto(dispositivo,bauds[b]);
+        if (fd<0)
+        {
+            fprintf(stderr,"No se puede abrir %s: %s\n",dispositivo,strerror(errno));
+            return 1;
+        }
+
+        for (size_t c=0;c<cargas.size();c++)
+        {
+            config.carga=cargas[c];
+            PruebaEnlace prueba(config);
+            EstadisticasEnlace enlace;
+            if (!ejecutar(fd,prueba,enlace))
+            {
+                fprintf(stderr,"Error en el puerto: %s\n",strerror(errno));
+                close(fd);
+                return 1;
+            }
+
+            ResultadoPrueba r=prueba.resultado();
+            if (r.rechazada)
+            {
+                fprintf(stderr,"El dispositivo no admite las pruebas del enlace\n");
+                close(fd);
+                return 1;
+            }
+
+            // El uso es el caudal util frente a la capacidad nominal de la linea (10 bits por byte en 8N1)
+            double util=r.caudalUtil*8/1000.0;
+            double uso=100.0*r.caudalUtil/(bauds[b]/10.0);
+            printf("%8d %5d %8.0f %10.2f %6.1f %8.1f%% ",bauds[b],config.carga,r.tramasPorSegundo,
+                   util,uso,100.0*r.sobrecosteStuffing());
+            if (r.sinResumen) printf("%8s %9s","?","?");
+            else printf("%7.2f%% %9llu",100.0*r.perdidas(),
+                        (unsigned long long)(enlace.erroresCrc+r.erroresTiva));
+            if (config.modo==PRUEBA_ECO)
+                printf("   %6.2f/%6.2f/%6.2f/%6.2f",prueba.percentilLatencia(0.5)/1000.0,
+                       prueba.percentilLatencia(0.9)/1000.0,prueba.percentilLatencia(0.99)/1000.0,
+                       prueba.percentilLatencia(1.0)/1000.0);
+            putchar('\n');
+            if (histograma && config.modo==PRUEBA_ECO) escribir_histograma(prueba);
+            fflush(stdout);
+        }
+        close(fd);
+    }
+    return 0;
+}
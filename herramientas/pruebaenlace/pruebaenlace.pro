@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Prueba de rendimiento del enlace serie (caudal, stuffing, perdidas y latencia)
+# Usa la decodificacion del GUI y el generador de pruebaenlace.cpp
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = pruebaenlace
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../..
+LIBS += -lpthread
+
+SOURCES += main.cpp \
+    ../../pruebaenlace.cpp \
+    ../../telemetria.cpp \
+    ../../traza.cpp \
+    ../../serial2USBprotocol.cpp
+
+HEADERS += ../../pruebaenlace.h \
+    ../../telemetria.h \
+    ../../vistasmensajes.h \
+    ../../traza.h \
+    ../../serial2USBprotocol.h \
+    ../../codectramas.h \
+    ../../empaquetado.h \
+    ../../usb_messages_table.h
@@ -0,0 +1,215 @@
+// Generador de telemetria sintetica. Simula N aviones con MotorVuelo y escribe, para cada uno, el flujo de
+// tramas que enviaria la TIVA:
+//  - a ficheros de captura (avionNNNN.bin) en un directorio, que se pueden pasar a analisisvuelos, o
+//  - a pseudoterminales (--pty), en tiempo real, para conectar el GUI o cualquier otro lector de puerto serie.
+//    En este modo cada avion atiende ademas las pruebas del enlace (pruebaenlace.h) como lo haria la TIVA.
+//
+// Uso: simuladorvuelo [-n aviones] [-s semilla] [-t segundos] [--velocidad] [--compacta] (-o directorio | --pty)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include <string>
+#include <vector>
+
+#include "motorvuelo.h"
+#include "telemetria.h"
+#include "pruebaenlace.h"
+
+// Los buffers de cada avion se vuelcan al fichero al superar este tamaño
+#define TAM_VOLCADO (64*1024)
+
+static int abrir_pty(std::string &nombre)
+{
+    int fd=posix_openpt(O_RDWR|O_NOCTTY|O_NONBLOCK);
+    if (fd<0) return -1;
+    if ((grantpt(fd)<0)||(unlockpt(fd)<0))
+    {
+        close(fd);
+        return -1;
+    }
+
+    // Modo raw: los bytes de las tramas no deben pasar por la disciplina de linea del terminal
+    struct termios tio;
+    if (tcgetattr(fd,&tio)==0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd,TCSANOW,&tio);
+    }
+    nombre=ptsname(fd);
+    return fd;
+}
+
+// Escribe todo lo posible; en modo pty, si nadie lee y el buffer del terminal se llena, el resto se descarta
+// (como haria un puerto serie sin control de flujo). Devuelve los bytes descartados
+static size_t volcar(int fd, std::vector<uint8_t> &datos)
+{
+    size_t escrito=0;
+    while (escrito<datos.size())
+    {
+        ssize_t n=write(fd,datos.data()+escrito,datos.size()-escrito);
+        if (n<=0) break;
+        escrito+=(size_t)n;
+    }
+    size_t descartado=datos.size()-escrito;
+    datos.clear();
+    return descartado;
+}
+
+// Extremo de las pruebas del enlace de un avion en modo pty
+struct Respondedor {
+    DecodificadorTramas decodificador;
+    RespondedorPrueba prueba;
+};
+
+// Lee lo que haya llegado por el terminal y deja las respuestas en 'salida'
+static void atender(int fd, Respondedor &r, std::vector<uint8_t> &salida)
+{
+    uint8_t buffer[4096];
+    ssize_t n;
+    while ((n=read(fd,buffer,sizeof(buffer)))>0)
+    {
+        r.decodificador.anadir(buffer,(size_t)n,[&r,&salida](const MensajeDecodificado &m) {
+            uint8_t trama[MAX_FRAME_SIZE];
+            int32_t tam=r.prueba.atender(m,trama);
+            salida.insert(salida.end(),trama,trama+tam);
+        });
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int aviones=100;
+    uint64_t semilla=1;
+    double segundos=600.0;
+    bool pty=false, velocidad=false, compacta=false;
+    const char *directorio=nullptr;
+
+    for (int i=1;i<argc;i++)
+    {
+        if (!strcmp(argv[i],"-n")&&(i+1<argc)) aviones=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"-s")&&(i+1<argc)) semilla=strtoull(argv[++i],nullptr,0);
+        else if (!strcmp(argv[i],"-t")&&(i+1<argc)) segundos=atof(argv[++i]);
+        else if (!strcmp(argv[i],"-o")&&(i+1<argc)) directorio=argv[++i];
+        else if (!strcmp(argv[i],"--pty")) pty=true;
+        else if (!strcmp(argv[i],"--velocidad")) velocidad=true;
+        else if (!strcmp(argv[i],"--compacta")) compacta=true;
+        else directorio=nullptr, pty=false, aviones=0;
+    }
+    if ((aviones<=0)||(pty==(directorio!=nullptr)))
+    {
+        fprintf(stderr,"Uso: %s [-n aviones] [-s semilla] [-t segundos] [--velocidad] [--compacta] (-o directorio | --pty)\n",argv[0]);
+        return 1;
+    }
+
+    MotorVuelo motor(aviones,semilla);
+    if (velocidad)
+    {
+        PeriodosCanales p={5,10,20,100,100};
+        motor.setPeriodos(p);
+    }
+    motor.setCompacta(compacta);
+
+    std::vector<int> salidas(aviones,-1);
+    std::vector<std::vector<uint8_t> > buffers(aviones);
+    std::vector<Respondedor> respondedores(pty ? aviones : 0);
+    std::vector<struct pollfd> entradas(pty ? aviones : 0);
+    for (int i=0;i<aviones;i++)
+    {
+        std::string nombre;
+        if (pty)
+        {
+            salidas[i]=abrir_pty(nombre);
+            printf("avion %d: %s\n",i,nombre.c_str());
+        }
+        else
+        {
+            char fichero[32];
+            snprintf(fichero,sizeof(fichero),"/avion%04d.bin",i);
+            nombre=std::string(directorio)+fichero;
+            salidas[i]=open(nombre.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+        }
+        if (salidas[i]<0)
+        {
+            fprintf(stderr,"No se puede abrir la salida %s: %s\n",nombre.c_str(),strerror(errno));
+            return 1;
+        }
+        buffers[i].reserve(2*TAM_VOLCADO);
+    }
+    fflush(stdout);
+
+    // En modo pty se sigue el reloj real: cada paso se espera hasta su instante absoluto, asi los retrasos
+    // de una iteracion no se acumulan
+    struct timespec siguiente;
+    clock_gettime(CLOCK_MONOTONIC,&siguiente);
+    const long pasoNs=10*1000*1000;
+    uint64_t bytes=0, descartados=0;
+
+    while (motor.tiempo()<segundos)
+    {
+        motor.avanzar();
+        for (int i=0;i<aviones;i++)
+        {
+            bytes+=motor.emitirTramas(i,buffers[i]);
+            if (pty || (buffers[i].size()>=TAM_VOLCADO))
+                descartados+=volcar(salidas[i],buffers[i]);
+        }
+
+        if (pty)
+        {
+            siguiente.tv_nsec+=pasoNs;
+            if (siguiente.tv_nsec>=1000000000L)
+            {
+                siguiente.tv_nsec-=1000000000L;
+                siguiente.tv_sec++;
+            }
+
+            // Hasta el paso siguiente se atiende lo que llega por los terminales. Un terminal sin nadie al otro
+            // lado da POLLHUP continuamente: se deja de vigilar hasta el paso siguiente
+            for (int i=0;i<aviones;i++) entradas[i]={salidas[i],POLLIN,0};
+            for (;;)
+            {
+                struct timespec ahora, espera;
+                clock_gettime(CLOCK_MONOTONIC,&ahora);
+                espera.tv_sec=siguiente.tv_sec-ahora.tv_sec;
+                espera.tv_nsec=siguiente.tv_nsec-ahora.tv_nsec;
+                if (espera.tv_nsec<0)
+                {
+                    espera.tv_nsec+=1000000000L;
+                    espera.tv_sec--;
+                }
+                if (espera.tv_sec<0) break;
+
+                int r=ppoll(entradas.data(),entradas.size(),&espera,nullptr);
+                if ((r<0)&&(errno!=EINTR)) break;
+                for (int i=0;(r>0)&&(i<aviones);i++)
+                {
+                    if (entradas[i].revents&POLLIN)
+                    {
+                        atender(salidas[i],respondedores[i],buffers[i]);
+                        descartados+=volcar(salidas[i],buffers[i]);
+                    }
+                    else if (entradas[i].revents) entradas[i].fd=-1;
+                }
+            }
+        }
+    }
+
+    int estrellados=0;
+    for (int i=0;i<aviones;i++)
+    {
+        descartados+=volcar(salidas[i],buffers[i]);
+        close(salidas[i]);
+        if (motor.estrellado(i)) estrellados++;
+    }
+    fprintf(stderr,"%d aviones, %.0f s, %llu bytes (%llu descartados), %d colisiones\n",aviones,motor.tiempo(),
+            (unsigned long long)bytes,(unsigned long long)descartados,estrellados);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# Generador de telemetria sintetica de muchos aviones (linea de comandos)
+# Usa el motor de vuelo (motorvuelo.cpp) y el protocolo de tramas del GUI
+#-------------------------------------------------
+
+TEMPLATE = app
+TARGET = simuladorvuelo
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+
+# El bucle de integracion esta escrito para que el compilador lo vectorice
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3
+
+INCLUDEPATH += ../..
+LIBS += -lpthread
+
+SOURCES += main.cpp \
+    ../../motorvuelo.cpp \
+    ../../telemetria.cpp \
+    ../../pruebaenlace.cpp \
+    ../../traza.cpp \
+    ../../serial2USBprotocol.cpp
+
+HEADERS += ../../motorvuelo.h \
+    ../../telemetria.h \
+    ../../vistasmensajes.h \
+    ../../pruebaenlace.h \
+    ../../traza.h \
+    ../../serial2USBprotocol.h \
+    ../../codectramas.h \
+    ../../empaquetado.h \
+    ../../usb_messages_table.h
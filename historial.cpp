@@ -0,0 +1,158 @@
+#include "historial.h"
+
+#include <algorithm>
+
+HistorialCanal::HistorialCanal(int capacidadNivel, int niveles)
+    : piramide(niveles), capacidad(capacidadNivel)
+{
+    for (Nivel &n : piramide)
+        n.anillo.resize(capacidad);
+    vaciar();
+}
+
+void HistorialCanal::vaciar()
+{
+    for (Nivel &n : piramide)
+    {
+        n.inicio=0;
+        n.cuenta=0;
+        n.nPendiente=0;
+    }
+}
+
+// Cada muestra entra en el nivel 0 como un intervalo degenerado (min=max)
+void HistorialCanal::anadirMuestra(double t, float valor)
+{
+    MuestraHistorial m;
+    m.t=t;
+    m.minimo=valor;
+    m.maximo=valor;
+    anadirEnNivel(0,m);
+}
+
+// Inserta una entrada en el anillo del nivel (sobrescribiendo la mas antigua si esta lleno) y la acumula en el
+// agregado pendiente; cuando este agrupa dos entradas se sube al nivel siguiente
+void HistorialCanal::anadirEnNivel(int nivel, const MuestraHistorial &e)
+{
+    Nivel &n=piramide[nivel];
+
+    if (n.cuenta<capacidad)
+    {
+        n.anillo[(n.inicio+n.cuenta)%capacidad]=e;
+        n.cuenta++;
+    }
+    else
+    {
+        n.anillo[n.inicio]=e;
+        n.inicio=(n.inicio+1)%capacidad;
+    }
+
+    if (nivel+1>=(int)piramide.size()) return; // El ultimo nivel no tiene a quien pasar el agregado
+
+    if (n.nPendiente==0)
+        n.pendiente=e;
+    else
+    {
+        n.pendiente.minimo=std::min(n.pendiente.minimo,e.minimo);
+        n.pendiente.maximo=std::max(n.pendiente.maximo,e.maximo);
+    }
+    if (++n.nPendiente==2)
+    {
+        n.nPendiente=0;
+        anadirEnNivel(nivel+1,n.pendiente);
+    }
+}
+
+const MuestraHistorial &HistorialCanal::entrada(const Nivel &n, int i) const
+{
+    return n.anillo[(n.inicio+i)%capacidad];
+}
+
+// Busqueda binaria (los instantes son crecientes): indice de la primera entrada con t>=tiempo
+int HistorialCanal::primeraNoAnterior(const Nivel &n, double tiempo) const
+{
+    int bajo=0, alto=n.cuenta;
+    while (bajo<alto)
+    {
+        int medio=(bajo+alto)/2;
+        if (entrada(n,medio).t<tiempo) bajo=medio+1;
+        else alto=medio;
+    }
+    return bajo;
+}
+
+bool HistorialCanal::vacio() const
+{
+    return piramide[0].cuenta==0;
+}
+
+double HistorialCanal::tiempoFinal() const
+{
+    const Nivel &n=piramide[0];
+    return n.cuenta ? entrada(n,n.cuenta-1).t : 0.0;
+}
+
+// La muestra mas antigua que se conserva esta en el nivel mas alto con datos
+double HistorialCanal::tiempoInicial() const
+{
+    for (int k=(int)piramide.size()-1;k>=0;k--)
+        if (piramide[k].cuenta) return entrada(piramide[k],0).t;
+    return 0.0;
+}
+
+int HistorialCanal::consultar(double t0, double t1, int puntos, std::vector<MuestraHistorial> &salida) const
+{
+    salida.clear();
+    if (vacio() || puntos<=0 || t1<t0) return -1;
+
+    // Se elige el nivel mas fino que cubre t0 (o que no ha perdido datos) y no da mas de dos entradas por punto
+    int nivel=-1;
+    int ultimoConDatos=0;
+    for (int k=0;k<(int)piramide.size();k++)
+    {
+        const Nivel &n=piramide[k];
+        if (!n.cuenta) break;
+        ultimoConDatos=k;
+        bool cubre=(n.cuenta<capacidad)||(entrada(n,0).t<=t0);
+        int enRango=primeraNoAnterior(n,t1)-primeraNoAnterior(n,t0);
+        if (cubre && enRango<=2*puntos)
+        {
+            nivel=k;
+            break;
+        }
+    }
+    if (nivel<0) nivel=ultimoConDatos;
+
+    // Entradas del nivel dentro del intervalo (mas la anterior a t0, para que la grafica no empiece cortada)
+    const Nivel &n=piramide[nivel];
+    std::vector<MuestraHistorial> seleccion;
+    int i=std::max(0,primeraNoAnterior(n,t0)-1);
+    int fin=primeraNoAnterior(n,t1);
+    if (fin<n.cuenta && entrada(n,fin).t<=t1) fin++;
+    for (;i<fin;i++)
+        seleccion.push_back(entrada(n,i));
+
+    // Las muestras mas recientes todavia no han subido al nivel elegido: estan en los agregados pendientes de
+    // los niveles inferiores (el del nivel-1 es el mas antiguo y el del nivel 0 el mas reciente)
+    for (int k=nivel-1;k>=0;k--)
+    {
+        const Nivel &p=piramide[k];
+        if (p.nPendiente && p.pendiente.t<=t1 && (seleccion.empty() || p.pendiente.t>seleccion.back().t))
+            seleccion.push_back(p.pendiente);
+    }
+
+    // Como mucho hay 2*puntos entradas; se agrupan para no devolver mas de un intervalo por punto
+    int grupo=((int)seleccion.size()+puntos-1)/puntos;
+    if (grupo<1) grupo=1;
+    for (size_t j=0;j<seleccion.size();j+=grupo)
+    {
+        MuestraHistorial m=seleccion[j];
+        for (size_t l=j+1;l<j+grupo && l<seleccion.size();l++)
+        {
+            m.minimo=std::min(m.minimo,seleccion[l].minimo);
+            m.maximo=std::max(m.maximo,seleccion[l].maximo);
+        }
+        salida.push_back(m);
+    }
+    return nivel;
+}
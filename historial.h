@@ -0,0 +1,51 @@
+// Historial de un canal de telemetria (altura, combustible, velocidad...) organizado como una piramide de
+// minimos/maximos: el nivel 0 guarda las muestras originales y cada nivel superior agrupa de dos en dos las
+// entradas del anterior. Cada nivel es un anillo de capacidad fija, de forma que la memoria esta acotada y los
+// niveles altos cubren horas de vuelo aunque la tasa de muestreo sea alta.
+// Para pintar un intervalo con N pixeles se lee el nivel cuya resolucion se ajusta a N, por lo que el coste
+// depende del numero de pixeles y no del de muestras.
+
+#ifndef HISTORIAL_H
+#define HISTORIAL_H
+
+#include <vector>
+
+struct MuestraHistorial {
+    double t;       // Instante (s) de la primera muestra agrupada
+    float minimo;
+    float maximo;
+};
+
+class HistorialCanal
+{
+public:
+    explicit HistorialCanal(int capacidadNivel=4096, int niveles=16);
+
+    void anadirMuestra(double t, float valor);
+    void vaciar();
+
+    // Rellena 'salida' con como mucho 'puntos' intervalos min/max que cubren [t0,t1]. Devuelve el nivel usado
+    int consultar(double t0, double t1, int puntos, std::vector<MuestraHistorial> &salida) const;
+
+    bool vacio() const;
+    double tiempoInicial() const;
+    double tiempoFinal() const;
+
+private:
+    struct Nivel {
+        std::vector<MuestraHistorial> anillo;
+        int inicio;                   // Posicion de la entrada mas antigua
+        int cuenta;                   // Entradas validas en el anillo
+        MuestraHistorial pendiente;   // Agregado parcial que subira al nivel siguiente
+        int nPendiente;
+    };
+
+    void anadirEnNivel(int nivel, const MuestraHistorial &entrada);
+    const MuestraHistorial &entrada(const Nivel &n, int i) const;
+    int primeraNoAnterior(const Nivel &n, double t) const;
+
+    std::vector<Nivel> piramide;
+    int capacidad;
+};
+
+#endif // HISTORIAL_H
@@ -1,11 +1,131 @@
 //QT4:#include <QtGui/QApplication>
 #include <QtWidgets/QApplication>
+#include <QCommandLineParser>
 #include "guipanel.h"
+#include "publicadormqtt.h"
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Opciones de linea de comandos
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption opcionMqtt("mqtt", "Publica la telemetria en el broker MQTT indicado.", "servidor[:puerto]");
+    QCommandLineOption opcionPrefijo("mqtt-prefijo", "Prefijo de los topics MQTT (por defecto 'avion').", "prefijo", "avion");
+    QCommandLineOption opcionShm("shm", "Publica el estado del avion en memoria compartida (telemetria_shm.h).");
+    QCommandLineOption opcionCalibracion("calibracion", "Calibracion de un potenciometro: cuentas del ADC con el mando "
+                                         "centrado y ganancia (negativa invierte el eje). Se puede repetir.",
+                                         "roll|pitch|yaw=cero[:ganancia]");
+    QCommandLineOption opcionSuavizado("suavizado", "Coeficiente del filtro paso bajo de la actitud, entre 0.01 y 1 "
+                                       "(1 = sin filtrar).", "alfa");
+    QCommandLineOption opcionTraza("traza", "Registra los tiempos de decodificacion y pintado y los guarda en el fichero "
+                                   "indicado (formato Chrome trace-event) al salir o con Ctrl+Shift+T.", "fichero");
+    QCommandLineOption opcionGrabar("grabar", "Graba lo que llega por el puerto serie en el fichero indicado, para "
+                                    "reproducirlo despues.", "fichero");
+    QCommandLineOption opcionReproducir("reproducir", "Reproduce un vuelo grabado con --grabar.", "fichero");
+    QCommandLineOption opcionVelocidadReproduccion("velocidad-reproduccion", "Velocidad de la reproduccion, de 0.25 a 16 "
+                                                   "(0 = lo mas rapido posible; por defecto 1).", "factor", "1");
+    QCommandLineOption opcionCodificacion("codificacion", "Codificacion de la telemetria que se pide a la TIVA: compacta "
+                                          "(por defecto) o normal.", "compacta|normal", "compacta");
+    QCommandLineOption opcionAlarmas("alarmas", "Añade las reglas de alarma del fichero indicado a las de por defecto "
+                                     "(sintaxis en motoralarmas.h).", "fichero");
+    QCommandLineOption opcionPrueba("prueba-enlace", "Configura la prueba del enlace que se lanza con Ctrl+Shift+B: "
+                                    "modo, bytes de carga (0-24), densidad de escape (0-1) y segundos (por defecto "
+                                    "eco:24:0:5).", "eco|sumidero[:carga[:densidad[:segundos]]]");
+    QCommandLineOption opcionCajaNegra("caja-negra", "Directorio en el que se guardan los volcados de la caja negra "
+                                       "(por defecto el actual).", "directorio");
+    parser.addOption(opcionMqtt);
+    parser.addOption(opcionPrefijo);
+    parser.addOption(opcionShm);
+    parser.addOption(opcionCalibracion);
+    parser.addOption(opcionSuavizado);
+    parser.addOption(opcionTraza);
+    parser.addOption(opcionGrabar);
+    parser.addOption(opcionReproducir);
+    parser.addOption(opcionVelocidadReproduccion);
+    parser.addOption(opcionCodificacion);
+    parser.addOption(opcionAlarmas);
+    parser.addOption(opcionPrueba);
+    parser.addOption(opcionCajaNegra);
+    parser.process(a);
+
+    QScopedPointer<PublicadorMqtt> publicador;   // Se declara antes que el panel para destruirse despues
     GUIPanel w;
+
+    if (parser.isSet(opcionMqtt))
+    {
+        QStringList servidor=parser.value(opcionMqtt).split(':');
+        quint16 puerto=(servidor.size()>1) ? servidor[1].toUShort() : 1883;
+        publicador.reset(new PublicadorMqtt(servidor[0], puerto, parser.value(opcionPrefijo)));
+        w.setPublicadorMqtt(publicador.data());
+    }
+
+    if (parser.isSet(opcionShm) && !w.activarMemoriaCompartida(SHM_TELEMETRIA_NOMBRE))
+        qWarning("No se puede crear el segmento de memoria compartida %s (¿hay otro GUI publicandolo?)",
+                 SHM_TELEMETRIA_NOMBRE);
+
+    const QStringList ejes = QStringList() << "roll" << "pitch" << "yaw";   // En el orden de EjeActitud
+    foreach (const QString &valor, parser.values(opcionCalibracion))
+    {
+        QStringList partes=valor.split('=');
+        int eje=ejes.indexOf(partes[0].toLower());
+        QStringList numeros=(partes.size()>1) ? partes[1].split(':') : QStringList();
+        if ((eje<0)||numeros.isEmpty())
+        {
+            qWarning("Calibracion no valida: %s", qPrintable(valor));
+            continue;
+        }
+        CalibracionEje cal=w.calibracion((EjeActitud)eje);
+        cal.cero=numeros[0].toFloat();
+        if (numeros.size()>1) cal.ganancia=numeros[1].toFloat();
+        w.setCalibracion((EjeActitud)eje, cal);
+    }
+    if (parser.isSet(opcionSuavizado))
+        w.setSuavizadoActitud(parser.value(opcionSuavizado).toFloat());
+
+    if (parser.isSet(opcionTraza))
+        w.activarTraza(parser.value(opcionTraza));
+
+    if (parser.value(opcionCodificacion)!="compacta" && parser.value(opcionCodificacion)!="normal")
+        qWarning("Codificacion no valida: %s (se usa la compacta)", qPrintable(parser.value(opcionCodificacion)));
+    w.setCodificacionCompacta(parser.value(opcionCodificacion)!="normal");
+
+    foreach (const QString &fichero, parser.values(opcionAlarmas))
+    {
+        QString error;
+        if (!w.cargarAlarmas(fichero, &error))
+            qWarning("No se pueden cargar las alarmas de %s: %s", qPrintable(fichero), qPrintable(error));
+    }
+
+    if (parser.isSet(opcionPrueba))
+    {
+        QStringList partes=parser.value(opcionPrueba).split(':');
+        ConfigPrueba config;
+        config.modo=(partes[0]=="sumidero") ? PRUEBA_SUMIDERO : PRUEBA_ECO;
+        if (partes.size()>1) config.carga=qBound(0, partes[1].toInt(), MAX_CARGA_PRUEBA);
+        if (partes.size()>2) config.densidadEscape=qBound(0.0, partes[2].toDouble(), 1.0);
+        if (partes.size()>3) config.duracionUs=(uint64_t)(qMax(0.1, partes[3].toDouble())*1e6);
+        if ((partes[0]!="eco")&&(partes[0]!="sumidero"))
+            qWarning("Modo de prueba no valido: %s", qPrintable(partes[0]));
+        else
+            w.setConfigPrueba(config);
+    }
+
+    if (parser.isSet(opcionCajaNegra))
+        w.setDirectorioCajaNegra(parser.value(opcionCajaNegra));
+
+    if (parser.isSet(opcionGrabar) && !w.iniciarGrabacion(parser.value(opcionGrabar)))
+        qWarning("No se puede crear la grabacion %s", qPrintable(parser.value(opcionGrabar)));
+
     w.show();
-    
-    return a.exec();
+
+    if (parser.isSet(opcionReproducir) &&
+        !w.abrirReproduccion(parser.value(opcionReproducir), parser.value(opcionVelocidadReproduccion).toDouble()))
+        qWarning("No se puede abrir la grabacion %s", qPrintable(parser.value(opcionReproducir)));
+
+    int resultado=a.exec();
+    if (parser.isSet(opcionTraza)) w.volcarTraza();
+    if (parser.isSet(opcionGrabar) && !w.terminarGrabacion())
+        qWarning("Error al escribir la grabacion %s: puede estar incompleta", qPrintable(parser.value(opcionGrabar)));
+    return resultado;
 }
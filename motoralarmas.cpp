@@ -0,0 +1,381 @@
+#include "motoralarmas.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Las sumas se recalculan desde las muestras de la ventana cuando el origen queda mas lejos que esto (en
+// duraciones de la ventana). Es un recorrido de la ventana cada muchas muestras: coste constante amortizado
+#define FACTOR_REAJUSTE 64.0
+
+const char *const MotorAlarmas::REGLAS_POR_DEFECTO =
+    "sin_combustible: combustible <= 0 -> bloquear_velocidad, picado, caja_negra\n"
+    "colision: colision > 0 -> colision, caja_negra\n"
+    "descenso_rapido: tasa(altura, 2) < -20 histeresis 5 -> aviso\n"
+    "consumo_alto: tasa(combustible, 10) < -0.1 histeresis 0.02 -> aviso\n";
+
+static const char *const nombresCanales[NUM_CANALES_ALARMA]={
+    "altura", "combustible", "velocidad", "roll", "pitch", "yaw", "colision"
+};
+
+static const char *const nombresFunciones[]={"valor", "tasa", "media", "minimo", "maximo"};
+
+MotorAlarmas::MotorAlarmas()
+{
+    indexar();
+}
+
+const char *MotorAlarmas::nombreCanal(int canal)
+{
+    return ((canal>=0)&&(canal<NUM_CANALES_ALARMA)) ? nombresCanales[canal] : "?";
+}
+
+void MotorAlarmas::vaciar()
+{
+    reglas.clear();
+    condiciones.clear();
+    ventanas.clear();
+    indexar();
+}
+
+void MotorAlarmas::reiniciar()
+{
+    for (Ventana &v : ventanas)
+    {
+        v.muestras.clear();
+        v.minimos.clear();
+        v.maximos.clear();
+        v.origen=0;
+        v.sumaT=v.sumaV=v.sumaTT=v.sumaTV=0;
+    }
+    for (Condicion &c : condiciones) c.activa=false;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Compilacion
+
+// Lector de una linea de reglas: palabras, numeros y simbolos, saltando espacios
+struct LectorRegla {
+    const char *p;
+
+    void espacios() { while (isspace((unsigned char)*p)) p++; }
+    bool fin() { espacios(); return *p=='\0'; }
+
+    bool simbolo(const char *s)
+    {
+        espacios();
+        size_t n=strlen(s);
+        if (strncmp(p,s,n)) return false;
+        p+=n;
+        return true;
+    }
+
+    bool palabra(std::string &s)
+    {
+        espacios();
+        const char *q=p;
+        while (isalnum((unsigned char)*q)||(*q=='_')) q++;
+        if (q==p) return false;
+        s.assign(p,q);
+        p=q;
+        return true;
+    }
+
+    bool numero(double &x)
+    {
+        espacios();
+        char *q;
+        x=strtod(p,&q);
+        if (q==p) return false;
+        p=q;
+        return true;
+    }
+};
+
+static int buscar_nombre(const std::string &s, const char *const *nombres, int n)
+{
+    for (int i=0;i<n;i++)
+        if (s==nombres[i]) return i;
+    return -1;
+}
+
+bool MotorAlarmas::compilarLinea(const std::string &linea, Regla &regla, Condicion &condicion, std::string &error)
+{
+    LectorRegla l={linea.c_str()};
+    std::string palabra;
+    double duracion=0;
+
+    if (!l.palabra(regla.nombre)||!l.simbolo(":"))
+    {
+        error="falta 'nombre:'";
+        return false;
+    }
+
+    // Termino: canal o funcion(canal, segundos)
+    if (!l.palabra(palabra))
+    {
+        error="falta el canal";
+        return false;
+    }
+    int funcion=buscar_nombre(palabra,nombresFunciones,sizeof(nombresFunciones)/sizeof(nombresFunciones[0]));
+    if (funcion>FUNCION_VALOR)
+    {
+        if (!l.simbolo("(")||!l.palabra(palabra)||!l.simbolo(",")||!l.numero(duracion)||!l.simbolo(")"))
+        {
+            error="se esperaba "+std::string(nombresFunciones[funcion])+"(canal, segundos)";
+            return false;
+        }
+        if (duracion<=0)
+        {
+            error="la ventana tiene que durar mas de 0 s";
+            return false;
+        }
+    }
+    else funcion=FUNCION_VALOR;
+    condicion.canal=buscar_nombre(palabra,nombresCanales,NUM_CANALES_ALARMA);
+    if (condicion.canal<0)
+    {
+        error="canal desconocido '"+palabra+"'";
+        return false;
+    }
+    condicion.funcion=(uint8_t)funcion;
+
+    // Comparacion (los de dos caracteres primero)
+    if (l.simbolo("<=")) condicion.operador=MENOR_IGUAL;
+    else if (l.simbolo(">=")) condicion.operador=MAYOR_IGUAL;
+    else if (l.simbolo("<")) condicion.operador=MENOR;
+    else if (l.simbolo(">")) condicion.operador=MAYOR;
+    else
+    {
+        error="falta el operador (< <= > >=)";
+        return false;
+    }
+    if (!l.numero(condicion.umbral))
+    {
+        error="falta el umbral";
+        return false;
+    }
+
+    condicion.histeresis=0;
+    const char *antes=l.p;
+    if (l.palabra(palabra))
+    {
+        if ((palabra!="histeresis")||!l.numero(condicion.histeresis)||(condicion.histeresis<0))
+        {
+            error="se esperaba 'histeresis valor' (no negativo)";
+            return false;
+        }
+    }
+    else l.p=antes;
+
+    regla.acciones.clear();
+    if (l.simbolo("->"))
+    {
+        do {
+            if (!l.palabra(palabra))
+            {
+                error="falta el nombre de la accion";
+                return false;
+            }
+            regla.acciones.push_back(palabra);
+        } while (l.simbolo(","));
+    }
+    if (!l.fin())
+    {
+        error="sobra texto al final";
+        return false;
+    }
+
+    condicion.activa=false;
+    condicion.ventana=(funcion==FUNCION_VALOR) ? -1 :
+        buscarVentana(condicion.canal,duracion,(funcion==FUNCION_MINIMO)||(funcion==FUNCION_MAXIMO));
+    return true;
+}
+
+// Las reglas sobre el mismo canal y la misma duracion comparten ventana
+int MotorAlarmas::buscarVentana(int canal, double duracion, bool extremos)
+{
+    for (size_t i=0;i<ventanas.size();i++)
+        if ((ventanas[i].canal==canal)&&(ventanas[i].duracion==duracion))
+        {
+            ventanas[i].extremos|=extremos;
+            return (int)i;
+        }
+
+    Ventana v;
+    v.canal=canal;
+    v.duracion=duracion;
+    v.extremos=extremos;
+    v.origen=0;
+    v.sumaT=v.sumaV=v.sumaTT=v.sumaTV=0;
+    ventanas.push_back(v);
+    return (int)ventanas.size()-1;
+}
+
+bool MotorAlarmas::cargar(const std::string &texto, std::string *error)
+{
+    size_t reglasAntes=reglas.size();
+    size_t ventanasAntes=ventanas.size();
+    std::vector<bool> extremosAntes;
+    for (const Ventana &v : ventanas) extremosAntes.push_back(v.extremos);
+
+    size_t inicio=0;
+    int numLinea=0;
+    while (inicio<=texto.size())
+    {
+        size_t fin=texto.find('\n',inicio);
+        if (fin==std::string::npos) fin=texto.size();
+        std::string linea=texto.substr(inicio,fin-inicio);
+        inicio=fin+1;
+        numLinea++;
+
+        size_t comentario=linea.find('#');
+        if (comentario!=std::string::npos) linea.erase(comentario);
+        if (linea.find_first_not_of(" \t\r")==std::string::npos) continue;
+
+        Regla regla;
+        Condicion condicion;
+        std::string motivo;
+        if (!compilarLinea(linea,regla,condicion,motivo))
+        {
+            // Se deshace todo lo añadido por este texto
+            reglas.resize(reglasAntes);
+            condiciones.resize(reglasAntes);
+            ventanas.resize(ventanasAntes);
+            for (size_t i=0;i<ventanasAntes;i++) ventanas[i].extremos=extremosAntes[i];
+            if (error) *error="linea "+std::to_string(numLinea)+": "+motivo;
+            return false;
+        }
+        reglas.push_back(regla);
+        condiciones.push_back(condicion);
+    }
+
+    reiniciar();
+    indexar();
+    return true;
+}
+
+// Construye las tablas planas por canal (ventanas que actualizar y condiciones que evaluar)
+void MotorAlarmas::indexar()
+{
+    ventanasPorCanal.clear();
+    condicionesPorCanal.clear();
+    for (int c=0;c<NUM_CANALES_ALARMA;c++)
+    {
+        inicioVentanas[c]=(int)ventanasPorCanal.size();
+        for (size_t i=0;i<ventanas.size();i++)
+            if (ventanas[i].canal==c) ventanasPorCanal.push_back((int)i);
+        inicioCondiciones[c]=(int)condicionesPorCanal.size();
+        for (size_t i=0;i<condiciones.size();i++)
+            if (condiciones[i].canal==c) condicionesPorCanal.push_back((int)i);
+    }
+    inicioVentanas[NUM_CANALES_ALARMA]=(int)ventanasPorCanal.size();
+    inicioCondiciones[NUM_CANALES_ALARMA]=(int)condicionesPorCanal.size();
+}
+
+double MotorAlarmas::ventanaMinima(int canal) const
+{
+    double minima=0;
+    for (int i=inicioVentanas[canal];i<inicioVentanas[canal+1];i++)
+    {
+        double d=ventanas[ventanasPorCanal[i]].duracion;
+        if ((minima==0)||(d<minima)) minima=d;
+    }
+    return minima;
+}
+
+// ---------------------------------------------------------------------------------------------------------------
+// Evaluacion
+
+bool MotorAlarmas::cumple(uint8_t operador, double valor, double umbral)
+{
+    switch (operador)
+    {
+    case MENOR: return valor<umbral;
+    case MENOR_IGUAL: return valor<=umbral;
+    case MAYOR: return valor>umbral;
+    default: return valor>=umbral;
+    }
+}
+
+void MotorAlarmas::anadirMuestra(Ventana &v, double t, double valor)
+{
+    if (v.muestras.empty()) v.origen=t;
+
+    MuestraVentana m;
+    m.t=t;
+    m.v=valor;
+    v.muestras.push_back(m);
+    double tt=t-v.origen;
+    v.sumaT+=tt;
+    v.sumaV+=valor;
+    v.sumaTT+=tt*tt;
+    v.sumaTV+=tt*valor;
+
+    if (v.extremos)
+    {
+        while (!v.minimos.empty()&&(v.minimos.back().v>=valor)) v.minimos.pop_back();
+        v.minimos.push_back(m);
+        while (!v.maximos.empty()&&(v.maximos.back().v<=valor)) v.maximos.pop_back();
+        v.maximos.push_back(m);
+    }
+
+    // Salen las muestras que ya no estan en (t-duracion, t]
+    double limite=t-v.duracion;
+    while (v.muestras.front().t<=limite)
+    {
+        const MuestraVentana &s=v.muestras.front();
+        double st=s.t-v.origen;
+        v.sumaT-=st;
+        v.sumaV-=s.v;
+        v.sumaTT-=st*st;
+        v.sumaTV-=st*s.v;
+        v.muestras.pop_front();
+    }
+    while (!v.minimos.empty()&&(v.minimos.front().t<=limite)) v.minimos.pop_front();
+    while (!v.maximos.empty()&&(v.maximos.front().t<=limite)) v.maximos.pop_front();
+
+    if (t-v.origen>FACTOR_REAJUSTE*std::max(v.duracion,1.0)) reajustar(v);
+}
+
+// Nuevo origen en la muestra mas antigua y sumas recalculadas (tambien elimina el error acumulado)
+void MotorAlarmas::reajustar(Ventana &v)
+{
+    v.origen=v.muestras.front().t;
+    v.sumaT=v.sumaV=v.sumaTT=v.sumaTV=0;
+    for (const MuestraVentana &s : v.muestras)
+    {
+        double st=s.t-v.origen;
+        v.sumaT+=st;
+        v.sumaV+=s.v;
+        v.sumaTT+=st*st;
+        v.sumaTV+=st*s.v;
+    }
+}
+
+double MotorAlarmas::evaluar(const Ventana &v, uint8_t funcion)
+{
+    double n=(double)v.muestras.size();
+
+    switch (funcion)
+    {
+    case FUNCION_MEDIA:
+        return v.sumaV/n;
+    case FUNCION_MINIMO:
+        return v.minimos.front().v;
+    case FUNCION_MAXIMO:
+        return v.maximos.front().v;
+    case FUNCION_TASA:
+    {
+        // Pendiente de la recta de minimos cuadrados; sin definir con menos de dos instantes distintos
+        double varianza=v.sumaTT-v.sumaT*v.sumaT/n;
+        if ((n<2)||(varianza<=1e-12)) return NAN;
+        return (v.sumaTV-v.sumaT*v.sumaV/n)/varianza;
+    }
+    default:
+        return NAN;
+    }
+}
@@ -0,0 +1,165 @@
+// Motor de reglas de alarma sobre la telemetria. Cada regla compara con un umbral el valor de un canal o un
+// agregado sobre una ventana de tiempo:
+//
+//   # nombre: termino op umbral [histeresis h] [-> accion, accion...]
+//   sin_combustible: combustible <= 0 -> bloquear_velocidad, picado
+//   descenso_rapido: tasa(altura, 2) < -20 histeresis 5 -> aviso
+//
+// Terminos: canal (ultimo valor), tasa(canal, s) (pendiente por minimos cuadrados, unidades/s), media(canal, s),
+// minimo(canal, s) y maximo(canal, s). Operadores: < <= > >=. Canales: altura, combustible, velocidad, roll,
+// pitch, yaw y colision (1 al recibir MENSAJE_COLISION). Una regla se activa al cumplirse la condicion y se
+// desactiva cuando deja de cumplirse por mas de la histeresis; las acciones las interpreta quien usa el motor.
+//
+// Las reglas se compilan a tablas planas agrupadas por canal: cada ventana (canal y duracion) se guarda una sola
+// vez aunque la usen varias reglas, y se actualiza de forma incremental con cada muestra (sumas acumuladas para
+// media y tasa, colas monotonas para minimo y maximo). El coste de una muestra depende del numero de reglas de su
+// canal, no de la longitud de las ventanas.
+// No depende de Qt.
+
+#ifndef MOTORALARMAS_H
+#define MOTORALARMAS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+enum CanalAlarma {
+    CANAL_ALTURA,
+    CANAL_COMBUSTIBLE,
+    CANAL_VELOCIDAD,
+    CANAL_ROLL,
+    CANAL_PITCH,
+    CANAL_YAW,
+    CANAL_COLISION,
+    NUM_CANALES_ALARMA
+};
+
+struct EventoAlarma {
+    int regla;
+    bool activa;               // true al activarse, false al desactivarse
+    double t;                  // Instante de la muestra que la ha cambiado (s)
+    double valor;              // Valor del termino en ese instante
+};
+
+class MotorAlarmas
+{
+public:
+    // Reglas que reproducen el comportamiento de siempre del panel, mas algunos avisos
+    static const char *const REGLAS_POR_DEFECTO;
+
+    MotorAlarmas();
+
+    // Añade las reglas de 'texto' (una por linea, '#' para comentarios). Si hay algun error no se añade
+    // ninguna y en 'error' queda la linea y el motivo
+    bool cargar(const std::string &texto, std::string *error=nullptr);
+    void vaciar();
+
+    // Olvida las muestras y el estado de las reglas (al empezar un vuelo o al saltar en una reproduccion)
+    void reiniciar();
+
+    // Nueva muestra de un canal; los instantes de cada canal deben ser crecientes. Las reglas que cambian de
+    // estado se entregan a 'alCambiar(const EventoAlarma &)'
+    template <class Funcion>
+    void muestra(CanalAlarma canal, double t, double valor, Funcion &&alCambiar);
+
+    int numReglas() const { return (int)reglas.size(); }
+    const std::string &nombre(int regla) const { return reglas[regla].nombre; }
+    const std::vector<std::string> &acciones(int regla) const { return reglas[regla].acciones; }
+    bool activa(int regla) const { return condiciones[regla].activa; }
+
+    // true si alguna regla depende de las muestras del canal
+    bool usaCanal(int canal) const { return inicioCondiciones[canal+1]>inicioCondiciones[canal]; }
+    // Duracion de la ventana mas corta de las reglas del canal (s), o 0 si ninguna usa ventana
+    double ventanaMinima(int canal) const;
+
+    static const char *nombreCanal(int canal);
+
+private:
+    enum TipoTermino { FUNCION_VALOR, FUNCION_TASA, FUNCION_MEDIA, FUNCION_MINIMO, FUNCION_MAXIMO };
+    enum Operador { MENOR, MENOR_IGUAL, MAYOR, MAYOR_IGUAL };
+
+    struct Regla {
+        std::string nombre;
+        std::vector<std::string> acciones;
+    };
+
+    struct MuestraVentana {
+        double t;
+        double v;
+    };
+
+    // Muestras de un canal en los ultimos 'duracion' segundos, con los acumulados de los agregados
+    struct Ventana {
+        int canal;
+        double duracion;
+        bool extremos;         // Alguna regla usa minimo o maximo
+        std::deque<MuestraVentana> muestras;
+        std::deque<MuestraVentana> minimos;   // Valores crecientes: el primero es el minimo
+        std::deque<MuestraVentana> maximos;   // Valores decrecientes: el primero es el maximo
+        double origen;         // Las sumas usan t-origen, para no perder precision en vuelos largos
+        double sumaT, sumaV, sumaTT, sumaTV;
+    };
+
+    // Condicion compilada: agregado de una ventana (o el valor de la muestra) comparado con el umbral
+    struct Condicion {
+        int canal;
+        uint8_t funcion;
+        uint8_t operador;
+        int ventana;           // -1 para FUNCION_VALOR
+        double umbral;
+        double histeresis;
+        bool activa;
+    };
+
+    static bool cumple(uint8_t operador, double valor, double umbral);
+    static void anadirMuestra(Ventana &v, double t, double valor);
+    static void reajustar(Ventana &v);
+    static double evaluar(const Ventana &v, uint8_t funcion);
+
+    bool compilarLinea(const std::string &linea, Regla &regla, Condicion &condicion, std::string &error);
+    int buscarVentana(int canal, double duracion, bool extremos);
+    void indexar();
+
+    std::vector<Regla> reglas;
+    std::vector<Condicion> condiciones;            // Una por regla, en el mismo orden
+    std::vector<Ventana> ventanas;
+    // Tablas planas por canal: [inicio[c], inicio[c+1]) en los vectores de indices
+    int inicioVentanas[NUM_CANALES_ALARMA+1];
+    int inicioCondiciones[NUM_CANALES_ALARMA+1];
+    std::vector<int> ventanasPorCanal;
+    std::vector<int> condicionesPorCanal;
+};
+
+template <class Funcion>
+void MotorAlarmas::muestra(CanalAlarma canal, double t, double valor, Funcion &&alCambiar)
+{
+    for (int i=inicioVentanas[canal];i<inicioVentanas[canal+1];i++)
+        anadirMuestra(ventanas[ventanasPorCanal[i]],t,valor);
+
+    for (int i=inicioCondiciones[canal];i<inicioCondiciones[canal+1];i++)
+    {
+        int regla=condicionesPorCanal[i];
+        Condicion &c=condiciones[regla];
+        double x=(c.funcion==FUNCION_VALOR) ? valor : evaluar(ventanas[c.ventana],c.funcion);
+        if (x!=x) continue;    // Agregado sin definir todavia (NaN)
+
+        // Para desactivarse la condicion tiene que dejar de cumplirse con el umbral desplazado por la histeresis
+        bool activa;
+        if (!c.activa) activa=cumple(c.operador,x,c.umbral);
+        else activa=cumple(c.operador,x,(c.operador<=MENOR_IGUAL) ? c.umbral+c.histeresis : c.umbral-c.histeresis);
+        if (activa==c.activa) continue;
+
+        c.activa=activa;
+        EventoAlarma evento;
+        evento.regla=regla;
+        evento.activa=activa;
+        evento.t=t;
+        evento.valor=x;
+        alCambiar(evento);
+    }
+}
+
+#endif // MOTORALARMAS_H
@@ -0,0 +1,229 @@
+#include "motorvuelo.h"
+
+extern "C" {
+#include "serial2USBprotocol.h"
+}
+#include "usb_messages_table.h"
+#include "empaquetado.h"
+
+#define PI_F 3.14159265f
+
+// Generador xorshift32: una multiplicacion menos que un LCG y vectorizable (solo desplazamientos y xor)
+static inline uint32_t xorshift32(uint32_t x)
+{
+    x^=x<<13;
+    x^=x>>17;
+    x^=x<<5;
+    return x;
+}
+
+// Numero uniforme en [-1,1) a partir de los 24 bits altos
+static inline float uniforme(uint32_t x)
+{
+    return (float)(x>>8)*(2.0f/16777216.0f)-1.0f;
+}
+
+// Seno de un angulo en grados dentro de [-90,90], por polinomio de Taylor de grado 7 (error < 2e-4). Se usa en
+// lugar de sinf() para que el bucle se vectorice y el resultado no dependa de la libm de cada maquina
+static inline float seno_grados(float grados)
+{
+    float x=grados*(PI_F/180.0f);
+    float x2=x*x;
+    return x*(1.0f-x2*(1.0f/6.0f-x2*(1.0f/120.0f-x2*(1.0f/5040.0f))));
+}
+
+static inline float limitar(float v, float minimo, float maximo)
+{
+    return v<minimo ? minimo : (v>maximo ? maximo : v);
+}
+
+// Equivalente a fmaxf(0,v) sin el tratamiento de NaN de la libm, que impide vectorizar el bucle
+static inline float no_negativo(float v)
+{
+    return v>0.0f ? v : 0.0f;
+}
+
+// Mezcla de la semilla comun con el indice del avion (splitmix64), para que cada avion tenga una secuencia
+// distinta y reproducible
+static uint32_t semilla_avion(uint64_t semilla, int avion)
+{
+    uint64_t z=semilla+0x9E3779B97F4A7C15ULL*(uint64_t)(avion+1);
+    z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z^(z>>27))*0x94D049BB133111EBULL;
+    z^=z>>31;
+    return (uint32_t)z ? (uint32_t)z : 1u;    // xorshift no admite estado 0
+}
+
+MotorVuelo::MotorVuelo(int aviones, uint64_t semilla, float paso)
+    : numAviones(aviones), paso(paso), contadorPasos(0), compacta(false)
+    , roll(aviones), pitch(aviones), yaw(aviones)
+    , velocidad(aviones), combustible(aviones), altura(aviones)
+    , mandoRoll(aviones), mandoPitch(aviones), mandoGases(aviones)
+    , aleatorio(aviones), colision(aviones), colisionEmitida(aviones)
+{
+    // Por defecto, con paso de 10ms: actitud a 20Hz, altura a 5Hz, combustible y reloj a 1Hz
+    periodos.potenciometro=5;
+    periodos.velocidad=0;
+    periodos.altura=20;
+    periodos.combustible=100;
+    periodos.reloj=100;
+
+    for (int i=0;i<aviones;i++)
+    {
+        uint32_t r=semilla_avion(semilla,i);
+        r=xorshift32(r);
+        yaw[i]=180.0f*uniforme(r);
+        r=xorshift32(r);
+        mandoGases[i]=140.0f+60.0f*uniforme(r);   // Entre 80 y 200 km/h
+        velocidad[i]=mandoGases[i];
+        aleatorio[i]=r;
+        altura[i]=3000.0f;                        // Mismo valor inicial que el panel de altitud del GUI
+        combustible[i]=100.0f;
+    }
+}
+
+// Paso de integracion de todos los aviones. Es una funcion aparte para que los punteros sean parametros
+// __restrict (GCC solo los tiene en cuenta en parametros) y el compilador no tenga que comprobar solapamientos
+// entre los once arrays
+static void integrar(int n, float dt, float *__restrict r, float *__restrict p, float *__restrict y,
+                     float *__restrict v, float *__restrict c, float *__restrict h,
+                     float *__restrict mr, float *__restrict mp, float *__restrict mg,
+                     uint32_t *__restrict a, uint32_t *__restrict col)
+{
+    // Bucle sin saltos (las condiciones se convierten en selecciones) para que se vectorice
+    for (int i=0;i<n;i++)
+    {
+        uint32_t s1=xorshift32(a[i]);
+        uint32_t s2=xorshift32(s1);
+        uint32_t s3=xorshift32(s2);
+        a[i]=s3;
+
+        float vivo=col[i] ? 0.0f : 1.0f;
+        float sinCombustible=(c[i]<=0.0f) ? 1.0f : 0.0f;
+
+        // Ordenes del piloto: paseo aleatorio acotado
+        mr[i]=limitar(mr[i]+40.0f*dt*uniforme(s1),-60.0f,60.0f);
+        mp[i]=limitar(mp[i]+20.0f*dt*uniforme(s2),-15.0f,20.0f);
+        mg[i]=limitar(mg[i]+30.0f*dt*uniforme(s3),0.0f,200.0f);
+
+        // Sin combustible el avion pica hacia -45 grados y pierde velocidad (como hace el GUI)
+        float objetivoPitch=sinCombustible*(-45.0f)+(1.0f-sinCombustible)*mp[i];
+        float objetivoVelocidad=(1.0f-sinCombustible)*mg[i];
+
+        // Respuesta de primer orden de la actitud y la velocidad a las ordenes
+        r[i]+=(mr[i]-r[i])*2.0f*dt*vivo;
+        p[i]+=(objetivoPitch-p[i])*1.0f*dt*vivo;
+        y[i]+=r[i]*0.5f*dt*vivo;                                  // Viraje coordinado
+        // Rumbo en [-180,180). En un paso el rumbo se sale como mucho una vuelta, asi que la parte entera se
+        // obtiene truncando (floorf necesita SSE4.1 para vectorizarse)
+        y[i]-=360.0f*((float)(int)((y[i]+180.0f)*(1.0f/360.0f)+1.0f)-1.0f);
+        v[i]+=(objetivoVelocidad-v[i])*0.5f*dt*vivo;
+
+        // Consumo proporcional a la velocidad y ascenso segun el angulo de ataque
+        c[i]=no_negativo(c[i]-(0.02f+0.0005f*v[i])*dt*vivo);
+        h[i]=no_negativo(h[i]+(v[i]*(1.0f/3.6f))*seno_grados(p[i])*dt*vivo);
+        col[i]=(h[i]<=0.0f) ? 1u : col[i];
+    }
+}
+
+void MotorVuelo::avanzar()
+{
+    integrar(numAviones,paso,roll.data(),pitch.data(),yaw.data(),velocidad.data(),combustible.data(),
+             altura.data(),mandoRoll.data(),mandoPitch.data(),mandoGases.data(),aleatorio.data(),colision.data());
+    contadorPasos++;
+}
+
+// Cuentas del ADC (12 bits) que daria el potenciometro para un angulo en [-rango/2, rango/2]
+static uint16_t a_cuentas(float grados, float rango)
+{
+    float cuentas=(grados+rango/2)*(4096.0f/rango);
+    return (uint16_t)limitar(cuentas,0.0f,4095.0f);
+}
+
+static size_t anadir_trama(std::vector<uint8_t> &salida, uint8_t tipo, void *parametro, int32_t tam)
+{
+    uint8_t trama[MAX_FRAME_SIZE];
+    int32_t size=create_frame(trama,tipo,parametro,tam,MAX_FRAME_SIZE);
+
+    if (size<=0) return 0;
+    salida.insert(salida.end(),trama,trama+size);
+    return (size_t)size;
+}
+
+// Cada canal se emite cuando el numero de paso es multiplo de su periodo, desplazado segun el avion para que
+// no coincidan todas las tramas de la flota en el mismo paso
+static bool toca(uint64_t paso, int periodo, int avion)
+{
+    return (periodo>0) && (((paso+(uint64_t)avion)%(uint64_t)periodo)==0);
+}
+
+size_t MotorVuelo::emitirTramas(int avion, std::vector<uint8_t> &salida)
+{
+    size_t bytes=0;
+    uint64_t k=contadorPasos;
+
+    if (colisionEmitida[avion]) return 0;    // Tras estrellarse el avion deja de emitir
+    if (colision[avion])
+    {
+        colisionEmitida[avion]=1;
+        return anadir_trama(salida,MENSAJE_COLISION,nullptr,0);
+    }
+
+    if (toca(k,periodos.reloj,avion))
+    {
+        PARAM_MENSAJE_RELOJ reloj;
+        reloj.reloj=(uint32_t)(tiempo());
+        bytes+=anadir_trama(salida,MENSAJE_RELOJ,&reloj,sizeof(reloj));
+    }
+    if (toca(k,periodos.potenciometro,avion))
+    {
+        PARAM_MENSAJE_POTENCIOMETRO giro;
+        giro.roll=a_cuentas(roll[avion],360.0f);
+        giro.pitch=a_cuentas(pitch[avion],180.0f);
+        giro.yaw=a_cuentas(yaw[avion],360.0f);
+        if (compacta)
+        {
+            PARAM_MENSAJE_POTENCIOMETRO_COMPACTO c;
+            empaquetar_angulos(c.angulos,giro.roll,giro.pitch,giro.yaw);
+            bytes+=anadir_trama(salida,MENSAJE_POTENCIOMETRO_COMPACTO,&c,sizeof(c));
+        }
+        else bytes+=anadir_trama(salida,MENSAJE_POTENCIOMETRO,&giro,sizeof(giro));
+    }
+    if (toca(k,periodos.velocidad,avion))
+    {
+        PARAM_MENSAJE_VELOCIDAD vel;
+        vel.bIntensity=velocidad[avion];
+        if (compacta)
+        {
+            uint8_t c[sizeof(PARAM_MENSAJE_VELOCIDAD_COMPACTO)];
+            escribir_u16_le(c,(uint16_t)a_fijo_s16(vel.bIntensity,ESCALA_VELOCIDAD_COMPACTA));
+            bytes+=anadir_trama(salida,MENSAJE_VELOCIDAD_COMPACTO,c,sizeof(c));
+        }
+        else bytes+=anadir_trama(salida,MENSAJE_VELOCIDAD,&vel,sizeof(vel));
+    }
+    if (toca(k,periodos.altura,avion))
+    {
+        PARAM_MENSAJE_ALTURA alt;
+        alt.altura=altura[avion];
+        if (compacta)
+        {
+            uint8_t c[sizeof(PARAM_MENSAJE_ALTURA_COMPACTO)];
+            escribir_u16_le(c,a_fijo_u16(alt.altura,ESCALA_ALTURA_COMPACTA));
+            bytes+=anadir_trama(salida,MENSAJE_ALTURA_COMPACTO,c,sizeof(c));
+        }
+        else bytes+=anadir_trama(salida,MENSAJE_ALTURA,&alt,sizeof(alt));
+    }
+    if (toca(k,periodos.combustible,avion))
+    {
+        PARAM_MENSAJE_COMBUSTIBLE comb;
+        comb.combustible=combustible[avion];
+        if (compacta)
+        {
+            uint8_t c[sizeof(PARAM_MENSAJE_COMBUSTIBLE_COMPACTO)];
+            escribir_u16_le(c,(uint16_t)a_fijo_combustible(comb.combustible));
+            bytes+=anadir_trama(salida,MENSAJE_COMBUSTIBLE_COMPACTO,c,sizeof(c));
+        }
+        else bytes+=anadir_trama(salida,MENSAJE_COMBUSTIBLE,&comb,sizeof(comb));
+    }
+    return bytes;
+}
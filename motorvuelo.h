@@ -0,0 +1,65 @@
+// Motor de dinamica de vuelo para generar telemetria sintetica de muchos aviones a la vez (pruebas de carga del
+// GUI y del decodificador sin hardware). El estado se guarda como estructura de arrays (un vector por variable)
+// y cada paso de integracion es un bucle sin saltos sobre todos los aviones, que el compilador vectoriza.
+// El paso de tiempo es fijo y el generador aleatorio de cada avion se siembra a partir de una semilla comun,
+// asi que dos ejecuciones con la misma semilla producen exactamente los mismos bytes.
+//
+// Los canales generados son los de usb_messages_table.h (potenciometros en cuentas del ADC, velocidad,
+// combustible, altura, reloj y colision) y se emiten como tramas reales de serial2USBprotocol.
+
+#ifndef MOTORVUELO_H
+#define MOTORVUELO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Periodos de emision de cada canal, en pasos de integracion (0 = no se emite). La velocidad va desactivada por
+// defecto, ya que el GUI la obtiene de su propia palanca y no espera recibirla
+struct PeriodosCanales {
+    int potenciometro;
+    int velocidad;
+    int altura;
+    int combustible;
+    int reloj;
+};
+
+class MotorVuelo
+{
+public:
+    MotorVuelo(int aviones, uint64_t semilla, float paso=0.01f);
+
+    void setPeriodos(const PeriodosCanales &p) { periodos=p; }
+
+    // Emite los mensajes de telemetria con la codificacion compacta (empaquetado.h), como una TIVA que la ha
+    // negociado
+    void setCompacta(bool c) { compacta=c; }
+
+    // Integra un paso de 'paso' segundos para todos los aviones
+    void avanzar();
+
+    // Añade a 'salida' las tramas que le tocan a 'avion' en el paso actual. Devuelve los bytes añadidos
+    size_t emitirTramas(int avion, std::vector<uint8_t> &salida);
+
+    int aviones() const { return numAviones; }
+    uint64_t pasos() const { return contadorPasos; }
+    double tiempo() const { return (double)contadorPasos*paso; }
+    bool estrellado(int avion) const { return colision[avion]!=0; }
+
+private:
+    int numAviones;
+    float paso;
+    uint64_t contadorPasos;
+    PeriodosCanales periodos;
+    bool compacta;
+
+    // Estado (estructura de arrays). Angulos en grados, velocidad en km/h, altura en m
+    std::vector<float> roll, pitch, yaw;
+    std::vector<float> velocidad, combustible, altura;
+    std::vector<float> mandoRoll, mandoPitch, mandoGases;   // Ordenes del "piloto" (paseo aleatorio)
+    std::vector<uint32_t> aleatorio;                        // Estado xorshift32 de cada avion
+    std::vector<uint32_t> colision;                         // 1 desde el paso en que la altura llega a 0 (32 bits, como los float, para vectorizar)
+    std::vector<uint8_t> colisionEmitida;
+};
+
+#endif // MOTORVUELO_H
@@ -0,0 +1,219 @@
+#include "panelreproduccion.h"
+#include "guipanel.h"
+
+#include <QPushButton>
+#include <QSlider>
+#include <QComboBox>
+#include <QLabel>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QFileDialog>
+#include <QFile>
+#include <QCloseEvent>
+
+#include <math.h>
+
+#include <algorithm>
+
+#define PERIODO_TICK_MS 10         // Periodo del temporizador de reproduccion
+#define PRESUPUESTO_MAX_MS 20      // Tiempo por tick entregando registros a velocidad maxima
+#define US_POR_DECIMA 100000
+
+// Factores de la lista de velocidades, en el mismo orden; 0 es "Max"
+static const double velocidades[]={0.25, 0.5, 1, 2, 4, 8, 16, 0};
+static const int NUM_VELOCIDADES=sizeof(velocidades)/sizeof(velocidades[0]);
+
+// mm:ss.d
+static QString formatoTiempo(uint64_t us)
+{
+    uint64_t decimas=us/US_POR_DECIMA;
+    return QString("%1:%2.%3").arg(decimas/600).arg((decimas/10)%60,2,10,QChar('0')).arg(decimas%10);
+}
+
+PanelReproduccion::PanelReproduccion(GUIPanel *panel, QWidget *parent)
+    : QWidget(parent, Qt::Window)
+    , panel(panel)
+    , abierto(false)
+    , posicion(0)
+    , velocidad(1)
+{
+    setWindowTitle(tr("Reproduccion"));
+    resize(600, 90);
+
+    botonAbrir = new QPushButton(tr("Abrir..."), this);
+    botonReproducir = new QPushButton(tr("Reproducir"), this);
+    botonReproducir->setEnabled(false);
+    selectorVelocidad = new QComboBox(this);
+    for (int i=0;i<NUM_VELOCIDADES;i++)
+        selectorVelocidad->addItem(velocidades[i]>0 ? QString("%1x").arg(velocidades[i]) : tr("Max"));
+    selectorVelocidad->setCurrentIndex(2);
+    etiquetaTiempo = new QLabel(this);
+    barraPosicion = new QSlider(Qt::Horizontal, this);
+    barraPosicion->setEnabled(false);
+
+    QHBoxLayout *controles = new QHBoxLayout;
+    controles->addWidget(botonAbrir);
+    controles->addWidget(botonReproducir);
+    controles->addWidget(selectorVelocidad);
+    controles->addStretch();
+    controles->addWidget(etiquetaTiempo);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(controles);
+    layout->addWidget(barraPosicion);
+
+    temporizador = new QTimer(this);
+    temporizador->setInterval(PERIODO_TICK_MS);
+    connect(temporizador, SIGNAL(timeout()), this, SLOT(avanzar()));
+    connect(botonAbrir, SIGNAL(clicked()), this, SLOT(abrirFichero()));
+    connect(botonReproducir, SIGNAL(clicked()), this, SLOT(alternarReproduccion()));
+    connect(barraPosicion, SIGNAL(valueChanged(int)), this, SLOT(moverPosicion(int)));
+    connect(selectorVelocidad, SIGNAL(currentIndexChanged(int)), this, SLOT(cambiarVelocidad(int)));
+}
+
+bool PanelReproduccion::abrir(const QString &fichero)
+{
+    pausar();
+    abierto=lector.abrir(QFile::encodeName(fichero).toStdString());
+    botonReproducir->setEnabled(abierto);
+    barraPosicion->setEnabled(abierto);
+    if (!abierto)
+    {
+        etiquetaTiempo->setText(tr("No se puede abrir %1").arg(fichero));
+        return false;
+    }
+
+    setWindowTitle(tr("Reproduccion - %1").arg(fichero));
+    barraPosicion->blockSignals(true);
+    barraPosicion->setRange(0, (int)((lector.fin()-lector.inicio())/US_POR_DECIMA));
+    barraPosicion->setPageStep(100);   // 10 s
+    barraPosicion->blockSignals(false);
+
+    panel->iniciarReproduccion();
+    saltar(lector.inicio());
+    return true;
+}
+
+void PanelReproduccion::setVelocidad(double factor)
+{
+    // Se elige la entrada de la lista mas parecida (en proporcion)
+    int mejor=NUM_VELOCIDADES-1;
+    if (factor>0)
+    {
+        mejor=0;
+        for (int i=1;i<NUM_VELOCIDADES-1;i++)
+            if (fabs(log(velocidades[i]/factor))<fabs(log(velocidades[mejor]/factor))) mejor=i;
+    }
+    selectorVelocidad->setCurrentIndex(mejor);
+}
+
+void PanelReproduccion::reproducir()
+{
+    if (!abierto) return;
+    if (posicion>=lector.fin()) saltar(lector.inicio());
+    panel->iniciarReproduccion();
+    reloj.start();
+    temporizador->start();
+    botonReproducir->setText(tr("Pausa"));
+}
+
+void PanelReproduccion::pausar()
+{
+    temporizador->stop();
+    botonReproducir->setText(tr("Reproducir"));
+}
+
+void PanelReproduccion::closeEvent(QCloseEvent *event)
+{
+    pausar();
+    if (abierto) panel->terminarReproduccion();
+    QWidget::closeEvent(event);
+}
+
+void PanelReproduccion::abrirFichero()
+{
+    QString fichero=QFileDialog::getOpenFileName(this, tr("Abrir vuelo grabado"), QString(),
+                                                 tr("Vuelos grabados (*.gpv);;Todos los ficheros (*)"));
+    if (!fichero.isEmpty()) abrir(fichero);
+}
+
+void PanelReproduccion::alternarReproduccion()
+{
+    if (temporizador->isActive()) pausar();
+    else reproducir();
+}
+
+void PanelReproduccion::moverPosicion(int decimas)
+{
+    if (abierto) saltar(lector.inicio()+(uint64_t)decimas*US_POR_DECIMA);
+}
+
+void PanelReproduccion::cambiarVelocidad(int indice)
+{
+    if ((indice>=0) && (indice<NUM_VELOCIDADES)) velocidad=velocidades[indice];
+}
+
+// Tick del temporizador: se avanza lo que corresponde al tiempo real transcurrido por la velocidad, o a velocidad
+// maxima todo lo que de tiempo a entregar en el presupuesto del tick
+void PanelReproduccion::avanzar()
+{
+    qint64 transcurrido=reloj.nsecsElapsed();
+    reloj.start();
+
+    if (velocidad>0)
+    {
+        uint64_t avance=(uint64_t)((double)transcurrido/1000.0*velocidad);
+        entregarHasta(std::min(posicion+avance, lector.fin()));
+        if (posicion>=lector.fin()) pausar();
+    }
+    else
+    {
+        QElapsedTimer presupuesto;
+        presupuesto.start();
+        RegistroVuelo registro;
+        bool quedan=true;
+        while (quedan && (presupuesto.elapsed()<PRESUPUESTO_MAX_MS))
+        {
+            quedan=lector.siguiente(registro);
+            if (quedan)
+            {
+                panel->reproducirRegistro(registro);
+                posicion=std::max(posicion, registro.instante);
+            }
+        }
+        if (!quedan)
+        {
+            posicion=lector.fin();
+            pausar();
+        }
+    }
+    mostrarPosicion();
+}
+
+// Salto a cualquier instante: fotograma anterior mas los datos desde el hasta 'instante'
+void PanelReproduccion::saltar(uint64_t instante)
+{
+    instante=std::max(lector.inicio(), std::min(instante, lector.fin()));
+
+    EstadoInstrumentos estado;
+    uint64_t desde=lector.buscar(instante, estado);
+    panel->aplicarFotograma(estado, desde);
+    posicion=desde;
+    entregarHasta(instante);
+    mostrarPosicion();
+}
+
+void PanelReproduccion::entregarHasta(uint64_t instante)
+{
+    RegistroVuelo registro;
+    while (lector.siguienteHasta(instante, registro)) panel->reproducirRegistro(registro);
+    posicion=instante;
+}
+
+void PanelReproduccion::mostrarPosicion()
+{
+    barraPosicion->blockSignals(true);   // El cambio no es un salto pedido por el usuario
+    barraPosicion->setValue((int)((posicion-lector.inicio())/US_POR_DECIMA));
+    barraPosicion->blockSignals(false);
+    etiquetaTiempo->setText(QString("%1 / %2").arg(formatoTiempo(posicion-lector.inicio()))
+                                              .arg(formatoTiempo(lector.fin()-lector.inicio())));
+}
@@ -0,0 +1,67 @@
+// Ventana de reproduccion de vuelos grabados (ver grabacion.h). Los datos grabados se entregan al GUIPanel por el
+// mismo camino que los del puerto serie, al ritmo de la grabacion multiplicado por la velocidad elegida (0.25x a
+// 16x) o tan rapido como se pueda ("Max", con un presupuesto de tiempo por tick para no bloquear el GUI).
+//
+// Al mover la barra de posicion no se reproduce desde el principio: se busca en el indice el ultimo fotograma
+// anterior, se aplica el estado completo de los instrumentos y solo se reproducen los datos hasta el punto pedido
+// (como mucho un segundo de grabacion).
+
+#ifndef PANELREPRODUCCION_H
+#define PANELREPRODUCCION_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "grabacion.h"
+
+class GUIPanel;
+class QPushButton;
+class QSlider;
+class QComboBox;
+class QLabel;
+
+class PanelReproduccion : public QWidget
+{
+    Q_OBJECT
+
+public:
+    PanelReproduccion(GUIPanel *panel, QWidget *parent = 0);
+
+    bool abrir(const QString &fichero);
+    void setVelocidad(double factor);      // 0 = lo mas rapido posible
+
+public slots:
+    void reproducir();
+    void pausar();
+
+protected:
+    void closeEvent(QCloseEvent *event);
+
+private slots:
+    void abrirFichero();
+    void alternarReproduccion();
+    void moverPosicion(int decimas);
+    void cambiarVelocidad(int indice);
+    void avanzar();
+
+private:
+    void saltar(uint64_t instante);
+    void entregarHasta(uint64_t instante);
+    void mostrarPosicion();
+
+    GUIPanel *panel;
+    LectorVuelo lector;
+    bool abierto;
+    uint64_t posicion;         // Instante de la grabacion (us) hasta el que se ha reproducido
+    double velocidad;          // Factor sobre el tiempo real; 0 = maximo
+    QTimer *temporizador;
+    QElapsedTimer reloj;       // Tiempo real entre ticks
+    QPushButton *botonAbrir;
+    QPushButton *botonReproducir;
+    QSlider *barraPosicion;    // Decimas de segundo desde el inicio de la grabacion
+    QComboBox *selectorVelocidad;
+    QLabel *etiquetaTiempo;
+};
+
+#endif // PANELREPRODUCCION_H
@@ -0,0 +1,295 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "pruebaenlace.h"
+
+static const uint8_t especiales[] = { START_FRAME_CHAR, STOP_FRAME_CHAR, ESCAPE_CHAR };
+
+static bool es_especial(uint8_t b)
+{
+    return (b==START_FRAME_CHAR)||(b==STOP_FRAME_CHAR)||(b==ESCAPE_CHAR);
+}
+
+// Carga de la trama 'secuencia': pseudoaleatoria (xorshift) y reproducible, para poder comprobar los ecos sin
+// guardarla. De cada 65536 bytes, 'umbral' son especiales; el resto se apartan de los especiales
+static void rellenar(uint8_t *carga, int n, uint32_t secuencia, uint32_t umbral)
+{
+    uint32_t x=secuencia*2654435761u+0x9E3779B9u;
+    for (int i=0;i<n;i++)
+    {
+        x^=x<<13;
+        x^=x>>17;
+        x^=x<<5;
+        uint8_t b=(uint8_t)(x>>24);
+        if ((x&0xFFFF)<umbral) b=especiales[((x>>16)&0xFF)%3];
+        else if (es_especial(b)) b^=0x01;
+        carga[i]=b;
+    }
+}
+
+PruebaEnlace::PruebaEnlace(const ConfigPrueba &c)
+    : config(c), fase(FASE_INICIO), rechazada(false), sinResumen(false), inicio(0), finEnvio(0),
+      ultimaRecepcion(0), resumenPedido(0), hayResumenInicial(false), tramasTiva0(0), bytesTiva0(0),
+      erroresTiva0(0), tramasTiva(0), bytesTiva(0), erroresTiva(0), masAntigua(0), enVuelo(0), recibidas(0),
+      corruptas(0), bytesLinea(0), bytesSinEscapar(0)
+{
+    config.carga=std::max(0,std::min(config.carga,(int)MAX_CARGA_PRUEBA));
+    config.ventana=std::max(1,config.ventana);
+    double d=std::max(0.0,std::min(config.densidadEscape,1.0));
+    config.densidadEscape=d;
+    umbralEscape=(uint32_t)(d*65536.0+0.5);
+    memset(histograma,0,sizeof(histograma));
+}
+
+int32_t PruebaEnlace::generar(uint8_t *trama, uint64_t ahora)
+{
+    switch (fase)
+    {
+    case FASE_INICIO:
+        // El sumidero necesita los contadores de la TIVA antes de empezar; si no los da, se prueba igual
+        if (config.modo==PRUEBA_SUMIDERO && !hayResumenInicial && !sinResumen && !rechazada)
+        {
+            if (!resumenPedido) return pedirResumen(trama,ahora);
+            if (ahora-resumenPedido<config.plazoUs) return 0;
+            sinResumen=true;
+            resumenPedido=0;
+        }
+        if (rechazada)
+        {
+            fase=FASE_TERMINADA;
+            return 0;
+        }
+        fase=FASE_ENVIO;
+        inicio=ahora;
+        // fall through
+    case FASE_ENVIO:
+        if (config.modo==PRUEBA_ECO) vencerEcos(ahora);
+        if (rechazada || (ahora-inicio>=config.duracionUs))
+        {
+            fase=FASE_VACIADO;
+            finEnvio=ahora;
+            return generar(trama,ahora);
+        }
+        if ((config.modo==PRUEBA_ECO)&&(enVuelo>=config.ventana)) return 0;
+        return crearTrama(trama,ahora);
+
+    case FASE_VACIADO:
+        if (config.modo==PRUEBA_ECO)
+        {
+            vencerEcos(ahora);
+            if (enVuelo==0) fase=FASE_TERMINADA;
+            return 0;
+        }
+        if (sinResumen || rechazada)
+        {
+            fase=FASE_TERMINADA;
+            return 0;
+        }
+        if (!resumenPedido) return pedirResumen(trama,ahora);
+        if (ahora-resumenPedido>=config.plazoUs)
+        {
+            sinResumen=true;
+            fase=FASE_TERMINADA;
+        }
+        return 0;
+
+    case FASE_TERMINADA:
+        break;
+    }
+    return 0;
+}
+
+int32_t PruebaEnlace::crearTrama(uint8_t *trama, uint64_t ahora)
+{
+    uint8_t parametro[VistaPrueba::TAM+VistaPrueba::MAX_CARGA];
+    uint32_t secuencia=(uint32_t)enviadaEn.size();
+
+    vistas::escribir_le<uint32_t>(parametro,secuencia);
+    vistas::escribir_le<uint32_t>(parametro+4,(uint32_t)ahora);
+    rellenar(parametro+VistaPrueba::TAM,config.carga,secuencia,umbralEscape);
+
+    uint8_t tipo=(config.modo==PRUEBA_ECO) ? MENSAJE_PRUEBA_ECO : MENSAJE_PRUEBA_SUMIDERO;
+    int32_t tam=create_frame(trama,tipo,parametro,VistaPrueba::TAM+config.carga,MAX_FRAME_SIZE);
+    if (tam<=0) return 0;
+
+    enviadaEn.push_back(ahora);
+    if (config.modo==PRUEBA_ECO)
+    {
+        estados.push_back(TRAMA_EN_VUELO);
+        enVuelo++;
+    }
+    bytesLinea+=(uint64_t)tam;
+    bytesSinEscapar+=(uint64_t)(MINIMUM_FRAME_SIZE+VistaPrueba::TAM+config.carga);
+    return tam;
+}
+
+int32_t PruebaEnlace::pedirResumen(uint8_t *trama, uint64_t ahora)
+{
+    int32_t tam=create_frame(trama,MENSAJE_PRUEBA_RESUMEN,nullptr,0,MAX_FRAME_SIZE);
+    resumenPedido=ahora ? ahora : 1;
+    return (tam>0) ? tam : 0;
+}
+
+// Da por perdidos los ecos que no han llegado en el plazo, para que no ocupen la ventana para siempre
+void PruebaEnlace::vencerEcos(uint64_t ahora)
+{
+    while (masAntigua<estados.size())
+    {
+        if (estados[masAntigua]==TRAMA_EN_VUELO)
+        {
+            if (ahora-enviadaEn[masAntigua]<config.plazoUs) break;
+            estados[masAntigua]=TRAMA_VENCIDA;
+            enVuelo--;
+        }
+        masAntigua++;
+    }
+}
+
+bool PruebaEnlace::recibir(const MensajeDecodificado &mensaje, uint64_t ahora)
+{
+    if (mensaje.error) return false;
+
+    switch (mensaje.tipo)
+    {
+    case MENSAJE_PRUEBA_ECO:
+    {
+        if (!mensaje.parametroValido) return true;
+        VistaPrueba eco=mensaje.vista<VistaPrueba>();
+        uint32_t secuencia=eco.secuencia();
+        if ((secuencia>=estados.size())||(estados[secuencia]==TRAMA_RECIBIDA)) return true;   // Ajeno o repetido
+
+        // Uno vencido que llega tarde se cuenta como recibido, pero ya no ocupaba la ventana
+        if (estados[secuencia]==TRAMA_EN_VUELO) enVuelo--;
+        estados[secuencia]=TRAMA_RECIBIDA;
+
+        uint8_t esperada[VistaPrueba::MAX_CARGA];
+        rellenar(esperada,config.carga,secuencia,umbralEscape);
+        if ((mensaje.tamParametro!=VistaPrueba::TAM+config.carga)||memcmp(eco.carga(),esperada,(size_t)config.carga))
+        {
+            corruptas++;
+            return true;
+        }
+
+        uint64_t latencia=ahora-enviadaEn[secuencia];
+        latencias.push_back((uint32_t)std::min<uint64_t>(latencia,UINT32_MAX));
+        int cubeta=0;
+        while ((cubeta<NUM_CUBETAS_LATENCIA-1)&&(latencia>=(2ull<<cubeta))) cubeta++;
+        histograma[cubeta]++;
+        recibidas++;
+        ultimaRecepcion=ahora;
+    }
+        return true;
+
+    case MENSAJE_PRUEBA_RESUMEN:
+    {
+        if (!mensaje.parametroValido || !resumenPedido) return true;
+        VistaPruebaResumen r=mensaje.vista<VistaPruebaResumen>();
+        resumenPedido=0;
+        if (fase==FASE_INICIO)
+        {
+            tramasTiva0=r.tramas();
+            bytesTiva0=r.bytes();
+            erroresTiva0=r.errores();
+            hayResumenInicial=true;
+        }
+        else
+        {
+            tramasTiva=r.tramas();
+            bytesTiva=r.bytes();
+            erroresTiva=r.errores();
+            ultimaRecepcion=ahora;
+            fase=FASE_TERMINADA;
+        }
+    }
+        return true;
+
+    case MENSAJE_NO_IMPLEMENTADO:
+    {
+        if (!mensaje.parametroValido) return false;
+        uint8_t tipo=mensaje.vista<VistaNoImplementado>().mensaje();
+        if ((tipo!=MENSAJE_PRUEBA_ECO)&&(tipo!=MENSAJE_PRUEBA_SUMIDERO)&&(tipo!=MENSAJE_PRUEBA_RESUMEN)) return false;
+        rechazada=true;
+        if (fase==FASE_ENVIO || fase==FASE_VACIADO) fase=FASE_TERMINADA;
+    }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+ResultadoPrueba PruebaEnlace::resultado() const
+{
+    ResultadoPrueba r;
+    memset(&r,0,sizeof(r));
+    r.rechazada=rechazada;
+    r.sinResumen=(config.modo==PRUEBA_SUMIDERO)&&(sinResumen||!hayResumenInicial);
+    r.enviadas=enviadaEn.size();
+    r.corruptas=corruptas;
+    r.bytesLinea=bytesLinea;
+    r.bytesSinEscapar=bytesSinEscapar;
+
+    if (config.modo==PRUEBA_ECO) r.recibidas=recibidas;
+    else if (!r.sinResumen)
+    {
+        // Los contadores de la TIVA son de 32 bits: las diferencias se hacen en 32 bits por si han dado la vuelta
+        r.recibidas=(uint32_t)(tramasTiva-tramasTiva0);
+        r.erroresTiva=(uint32_t)(erroresTiva-erroresTiva0);
+    }
+
+    uint64_t fin=(ultimaRecepcion>inicio) ? ultimaRecepcion : finEnvio;
+    r.segundos=(fin>inicio) ? (double)(fin-inicio)/1e6 : 0.0;
+    if (r.segundos>0)
+    {
+        double bytesCarga=(config.modo==PRUEBA_ECO) ? (double)recibidas*config.carga
+                         : (double)(uint32_t)(bytesTiva-bytesTiva0)-(double)r.recibidas*VistaPrueba::TAM;
+        r.caudalUtil=r.sinResumen ? 0.0 : bytesCarga/r.segundos;
+        r.tramasPorSegundo=(double)r.recibidas/r.segundos;
+    }
+    return r;
+}
+
+uint64_t PruebaEnlace::percentilLatencia(double p) const
+{
+    if (latencias.empty()) return 0;
+    std::vector<uint32_t> orden(latencias);
+    size_t i=(size_t)(p*(double)(orden.size()-1)+0.5);
+    if (i>=orden.size()) i=orden.size()-1;
+    std::nth_element(orden.begin(),orden.begin()+(ptrdiff_t)i,orden.end());
+    return orden[i];
+}
+
+int32_t RespondedorPrueba::atender(const MensajeDecodificado &mensaje, uint8_t *trama)
+{
+    if (mensaje.error)
+    {
+        errores++;
+        return 0;
+    }
+
+    switch (mensaje.tipo)
+    {
+    case MENSAJE_PRUEBA_ECO:
+        if (!mensaje.parametroValido) return 0;
+        return std::max<int32_t>(0,create_frame(trama,MENSAJE_PRUEBA_ECO,(void *)mensaje.parametro,
+                                                mensaje.tamParametro,MAX_FRAME_SIZE));
+    case MENSAJE_PRUEBA_SUMIDERO:
+        if (!mensaje.parametroValido) return 0;
+        tramas++;
+        bytes+=(uint32_t)mensaje.tamParametro;
+        secuencia=mensaje.vista<VistaPrueba>().secuencia();
+        return 0;
+    case MENSAJE_PRUEBA_RESUMEN:
+    {
+        PARAM_MENSAJE_PRUEBA_RESUMEN r;
+        r.tramas=tramas;
+        r.bytes=bytes;
+        r.errores=errores;
+        r.secuencia=secuencia;
+        return std::max<int32_t>(0,create_frame(trama,MENSAJE_PRUEBA_RESUMEN,&r,sizeof(r),MAX_FRAME_SIZE));
+    }
+    default:
+        return 0;
+    }
+}
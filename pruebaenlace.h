@@ -0,0 +1,133 @@
+// Prueba de rendimiento del enlace serie, al estilo de iperf, para saber que tasas de telemetria admite cada
+// instalacion. El PC satura el enlace con tramas de relleno con la carga y la densidad de bytes especiales (los que
+// hay que escapar) que se pidan, en uno de dos modos:
+//  - ECO: la TIVA devuelve cada trama. Se mide el caudal util de las que vuelven, las perdidas y la distribucion
+//    de la latencia de ida y vuelta. Las tramas en vuelo se limitan a una ventana para no desbordar la TIVA.
+//  - SUMIDERO: la TIVA solo cuenta lo que le llega, y se le piden los contadores antes y despues
+//    (MENSAJE_PRUEBA_RESUMEN). Se mide el caudal util en un solo sentido y las perdidas.
+// En los dos se mide tambien el coste del stuffing: bytes en la linea frente a bytes de las tramas sin escapar.
+//
+// No depende de Qt: quien la usa le pide tramas mientras pueda escribir (generar, que tambien hace avanzar la
+// prueba y hay que llamar periodicamente aunque no se pueda escribir) y le entrega los mensajes de prueba que
+// recibe (recibir). RespondedorPrueba es el otro extremo, lo que hace la TIVA; lo usa el simulador de vuelo.
+
+#ifndef PRUEBAENLACE_H
+#define PRUEBAENLACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "telemetria.h"
+
+enum ModoPrueba {
+    PRUEBA_ECO,
+    PRUEBA_SUMIDERO
+};
+
+// Cubetas del histograma de latencia: la i tiene las de [2^i, 2^(i+1)) us (la ultima, todas las mayores)
+#define NUM_CUBETAS_LATENCIA 24
+
+struct ConfigPrueba {
+    int modo;                  // ModoPrueba
+    int carga;                 // Bytes de relleno por trama (de 0 a MAX_CARGA_PRUEBA)
+    double densidadEscape;     // Fraccion de los bytes de relleno que son caracteres especiales (de 0 a 1)
+    int ventana;               // Tramas de eco en vuelo como maximo
+    uint64_t duracionUs;       // Tiempo enviando
+    uint64_t plazoUs;          // Espera maxima de un eco o de un resumen
+
+    ConfigPrueba() : modo(PRUEBA_ECO), carga(MAX_CARGA_PRUEBA), densidadEscape(0), ventana(8),
+        duracionUs(5000000), plazoUs(1000000) {}
+};
+
+struct ResultadoPrueba {
+    bool rechazada;            // La TIVA ha respondido MENSAJE_NO_IMPLEMENTADO
+    bool sinResumen;           // Sumidero: la TIVA no ha dado sus contadores (perdidas y caudal sin medir)
+    uint64_t enviadas;
+    uint64_t recibidas;        // Ecos recibidos, o tramas que dice haber recibido la TIVA
+    uint64_t corruptas;        // Ecos con la carga cambiada (con el CRC bien)
+    uint64_t erroresTiva;      // Sumidero: tramas descartadas por la TIVA por el CRC
+    uint64_t bytesLinea;       // Enviados, con delimitadores y stuffing
+    uint64_t bytesSinEscapar;  // Los mismos sin stuffing
+    double segundos;           // Desde la primera trama hasta el ultimo eco o el resumen final
+    double caudalUtil;         // Bytes de carga entregados por segundo
+    double tramasPorSegundo;   // Tramas entregadas por segundo
+
+    double perdidas() const { return enviadas ? 1.0-(double)(recibidas+corruptas)/(double)enviadas : 0.0; }
+    double sobrecosteStuffing() const { return bytesSinEscapar ? (double)bytesLinea/(double)bytesSinEscapar-1.0 : 0.0; }
+};
+
+class PruebaEnlace
+{
+public:
+    explicit PruebaEnlace(const ConfigPrueba &config);
+
+    // Si toca enviar algo en el instante 'ahora' (us), deja la trama en 'trama' (MAX_FRAME_SIZE bytes) y devuelve
+    // su tamaño; si no, devuelve 0. Hay que llamarla hasta que devuelva 0 cada vez que se pueda escribir
+    int32_t generar(uint8_t *trama, uint64_t ahora);
+
+    // Mensaje recibido. Devuelve true si era de la prueba
+    bool recibir(const MensajeDecodificado &mensaje, uint64_t ahora);
+
+    bool terminada() const { return fase==FASE_TERMINADA; }
+    const ConfigPrueba &configuracion() const { return config; }
+
+    ResultadoPrueba resultado() const;
+
+    // Latencia de ida y vuelta de los ecos (us) por debajo de la que queda la fraccion 'p' (0-1); 0 sin ecos
+    uint64_t percentilLatencia(double p) const;
+    const uint64_t *histogramaLatencia() const { return histograma; }
+
+private:
+    enum Fase { FASE_INICIO, FASE_ENVIO, FASE_VACIADO, FASE_TERMINADA };
+    enum EstadoTrama : uint8_t { TRAMA_EN_VUELO, TRAMA_RECIBIDA, TRAMA_VENCIDA };
+
+    int32_t crearTrama(uint8_t *trama, uint64_t ahora);
+    int32_t pedirResumen(uint8_t *trama, uint64_t ahora);
+    void vencerEcos(uint64_t ahora);
+
+    ConfigPrueba config;
+    uint32_t umbralEscape;                 // densidadEscape sobre 65536
+    Fase fase;
+    bool rechazada;
+    bool sinResumen;
+
+    uint64_t inicio;                       // Primera trama de datos
+    uint64_t finEnvio;
+    uint64_t ultimaRecepcion;
+    uint64_t resumenPedido;                // Instante de la peticion de resumen en curso (0 si no hay)
+    bool hayResumenInicial;
+    uint32_t tramasTiva0, bytesTiva0, erroresTiva0;   // Contadores de la TIVA al empezar
+    uint32_t tramasTiva, bytesTiva, erroresTiva;      // Y al terminar
+
+    std::vector<uint64_t> enviadaEn;       // Por numero de secuencia
+    std::vector<uint8_t> estados;          // EstadoTrama, por numero de secuencia (solo en modo eco)
+    size_t masAntigua;                     // Primera trama que puede seguir en vuelo
+    int enVuelo;
+    uint64_t recibidas;
+    uint64_t corruptas;
+    uint64_t bytesLinea;
+    uint64_t bytesSinEscapar;
+    std::vector<uint32_t> latencias;       // us
+    uint64_t histograma[NUM_CUBETAS_LATENCIA];
+};
+
+// Extremo de la TIVA: devuelve los ecos y lleva los contadores del sumidero
+class RespondedorPrueba
+{
+public:
+    RespondedorPrueba() : tramas(0), bytes(0), errores(0), secuencia(0) {}
+
+    // Atiende un mensaje recibido. Si hay que responder deja la trama en 'trama' (MAX_FRAME_SIZE bytes) y devuelve
+    // su tamaño; si no, devuelve 0. Las tramas erroneas se cuentan
+    int32_t atender(const MensajeDecodificado &mensaje, uint8_t *trama);
+
+private:
+    uint32_t tramas;
+    uint32_t bytes;
+    uint32_t errores;
+    uint32_t secuencia;
+};
+
+#endif // PRUEBAENLACE_H
@@ -0,0 +1,263 @@
+#include "publicadormqtt.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostInfo>
+#include <QList>
+#include <QTimer>
+#include <QtEndian>
+
+#include <qmqtt.h>
+
+#include <string.h>
+
+#define VERSION_PAYLOAD 1
+#define TAM_CABECERA (1+1+2+8)
+#define MAX_BYTES_LOTE 4096           // Un lote mas grande se descarta (el trabajador no da abasto)
+#define MAX_PUBLICACIONES_PENDIENTES 256
+#define PERIODO_REVISION_MS 20
+
+static const char *nombresCanales[PublicadorMqtt::NUM_CANALES] = {
+    "actitud", "altura", "combustible", "reloj", "eventos"
+};
+
+// Parte del publicador que vive en el hilo de red: cliente MQTT, temporizador de revision de los lotes y cola
+// de publicaciones pendientes mientras no hay conexion
+class TrabajadorMqtt : public QObject
+{
+    Q_OBJECT
+
+public:
+    TrabajadorMqtt(PublicadorMqtt *publicador, const QString &servidor, quint16 puerto, const QString &prefijo)
+        : publicador(publicador), servidor(servidor), puerto(puerto), prefijo(prefijo)
+        , cliente(nullptr), temporizador(nullptr), siguienteId(1)
+    {
+        // Tasas por defecto: la actitud llega a ~20Hz y se agrupa de 4 en 4; el resto de canales son lentos
+        intervalo[PublicadorMqtt::CANAL_ACTITUD]=200;
+        intervalo[PublicadorMqtt::CANAL_ALTURA]=500;
+        intervalo[PublicadorMqtt::CANAL_COMBUSTIBLE]=1000;
+        intervalo[PublicadorMqtt::CANAL_RELOJ]=1000;
+        intervalo[PublicadorMqtt::CANAL_EVENTOS]=0;
+        for (int i=0;i<PublicadorMqtt::NUM_CANALES;i++) ultimaPublicacion[i]=-intervalo[i];
+    }
+
+public slots:
+    // Se ejecuta ya en el hilo de red, para que el socket y los temporizadores pertenezcan a el
+    void iniciar()
+    {
+        QHostAddress direccion(servidor);
+        if (direccion.isNull())
+        {
+            // La resolucion de nombres es bloqueante, pero aqui no afecta al GUI
+            QHostInfo info=QHostInfo::fromName(servidor);
+            if (!info.addresses().isEmpty()) direccion=info.addresses().first();
+        }
+
+        cliente = new QMQTT::Client(direccion, puerto, this);
+        cliente->setClientId(QStringLiteral("GUIPanel-%1").arg(QCoreApplication::applicationPid()));
+        cliente->setAutoReconnect(true);
+        cliente->setAutoReconnectInterval(2000);
+        cliente->setKeepAlive(30);
+        cliente->connectToHost();
+
+        reloj.start();
+        temporizador = new QTimer(this);
+        connect(temporizador, SIGNAL(timeout()), this, SLOT(revisar()));
+        temporizador->start(PERIODO_REVISION_MS);
+    }
+
+    void setIntervalo(int canal, int ms)
+    {
+        intervalo[canal]=ms;
+    }
+
+    void revisar()
+    {
+        qint64 ahora=reloj.elapsed();
+        QByteArray payload;
+
+        // Se cierran los lotes de los canales cuyo intervalo minimo ya ha pasado
+        for (int c=0;c<PublicadorMqtt::NUM_CANALES;c++)
+        {
+            if (ahora-ultimaPublicacion[c]<intervalo[c]) continue;
+            if (!publicador->extraerLote((PublicadorMqtt::Canal)c,payload)) continue;
+
+            ultimaPublicacion[c]=ahora;
+            quint8 qos=(c==PublicadorMqtt::CANAL_EVENTOS) ? 1 : 0;
+            pendientes.append(QMQTT::Message(0, prefijo+QLatin1Char('/')+QLatin1String(nombresCanales[c]), payload, qos));
+            if (pendientes.size()>MAX_PUBLICACIONES_PENDIENTES)
+            {
+                pendientes.removeFirst();     // Sin conexion se conservan solo las mas recientes
+                publicador->numDescartados++;
+            }
+        }
+
+        if (!cliente->isConnectedToHost()) return;
+        while (!pendientes.isEmpty())
+        {
+            QMQTT::Message m=pendientes.takeFirst();
+            if (m.qos()>0)
+            {
+                m.setId(siguienteId++);
+                if (!siguienteId) siguienteId=1;
+            }
+            cliente->publish(m);
+            publicador->numPublicados++;
+        }
+    }
+
+private:
+    PublicadorMqtt *publicador;
+    QString servidor;
+    quint16 puerto;
+    QString prefijo;
+    QMQTT::Client *cliente;
+    QTimer *temporizador;
+    QElapsedTimer reloj;
+    int intervalo[PublicadorMqtt::NUM_CANALES];
+    qint64 ultimaPublicacion[PublicadorMqtt::NUM_CANALES];
+    QList<QMQTT::Message> pendientes;
+    quint16 siguienteId;
+};
+
+PublicadorMqtt::PublicadorMqtt(const QString &servidor, quint16 puerto, const QString &prefijo, QObject *parent) :
+    QObject(parent)
+  , numPublicados(0)
+  , numDescartados(0)
+{
+    for (int c=0;c<NUM_CANALES;c++)
+    {
+        lotes[c].cuenta=0;
+        lotes[c].inicio=0;
+    }
+
+    trabajador = new TrabajadorMqtt(this, servidor, puerto, prefijo);
+    trabajador->moveToThread(&hilo);
+    connect(&hilo, SIGNAL(finished()), trabajador, SLOT(deleteLater()));
+    hilo.start();
+    QMetaObject::invokeMethod(trabajador, "iniciar", Qt::QueuedConnection);
+}
+
+PublicadorMqtt::~PublicadorMqtt()
+{
+    hilo.quit();
+    hilo.wait();
+}
+
+void PublicadorMqtt::setTasaMaxima(Canal canal, double hz)
+{
+    if (canal==CANAL_EVENTOS) return;     // Los eventos no se limitan (ver anadirEvento)
+    int ms=(hz>0) ? (int)(1000.0/hz) : 0;
+    QMetaObject::invokeMethod(trabajador, "setIntervalo", Qt::QueuedConnection, Q_ARG(int, (int)canal), Q_ARG(int, ms));
+}
+
+quint64 PublicadorMqtt::publicados() const
+{
+    return numPublicados;
+}
+
+quint64 PublicadorMqtt::descartados() const
+{
+    return numDescartados;
+}
+
+void PublicadorMqtt::anadirMuestra(Canal canal, qint64 msUtc, const void *valor, int tam)
+{
+    QMutexLocker bloqueo(&cerrojo);
+    Lote &lote=lotes[canal];
+
+    if (!lote.cuenta) lote.inicio=msUtc;
+    qint64 desplazamiento=msUtc-lote.inicio;
+    if ((desplazamiento>0xFFFF)||(lote.muestras.size()+2+tam>MAX_BYTES_LOTE))
+    {
+        numDescartados++;
+        return;
+    }
+
+    uchar ms[2];
+    qToLittleEndian<quint16>((quint16)desplazamiento, ms);
+    lote.muestras.append((const char *)ms, 2);
+    lote.muestras.append((const char *)valor, tam);
+    lote.cuenta++;
+}
+
+// Los eventos no esperan a la siguiente revision: se despierta al trabajador para que los publique en seguida. Si
+// llegan varios antes de que se ejecute, salen en la misma publicacion
+void PublicadorMqtt::anadirEvento(qint64 msUtc, const void *valor, int tam)
+{
+    anadirMuestra(CANAL_EVENTOS, msUtc, valor, tam);
+    QMetaObject::invokeMethod(trabajador, "revisar", Qt::QueuedConnection);
+}
+
+// Saca el lote del canal con su cabecera y lo deja vacio. Devuelve false si no habia muestras
+bool PublicadorMqtt::extraerLote(Canal canal, QByteArray &payload)
+{
+    QMutexLocker bloqueo(&cerrojo);
+    Lote &lote=lotes[canal];
+
+    if (!lote.cuenta) return false;
+
+    uchar cabecera[TAM_CABECERA];
+    cabecera[0]=VERSION_PAYLOAD;
+    cabecera[1]=(uchar)canal;
+    qToLittleEndian<quint16>(lote.cuenta, cabecera+2);
+    qToLittleEndian<qint64>(lote.inicio, cabecera+4);
+
+    payload.clear();
+    payload.reserve(TAM_CABECERA+lote.muestras.size());
+    payload.append((const char *)cabecera, TAM_CABECERA);
+    payload.append(lote.muestras);
+
+    lote.muestras.clear();    // Conserva la capacidad reservada
+    lote.cuenta=0;
+    return true;
+}
+
+void PublicadorMqtt::publicar(const MensajeDecodificado &mensaje, qint64 msUtc)
+{
+    uchar valor[2+VistaRadio::MAX_CARACTERES];
+
+    if (mensaje.error || !mensaje.parametroValido) return;
+
+    switch (mensaje.tipo)
+    {
+    case MENSAJE_POTENCIOMETRO:
+    {
+        VistaPotenciometro giro=mensaje.vista<VistaPotenciometro>();
+        qToLittleEndian<quint16>(giro.roll() & 0xFFF, valor);
+        qToLittleEndian<quint16>(giro.pitch() & 0xFFF, valor+2);
+        qToLittleEndian<quint16>(giro.yaw() & 0xFFF, valor+4);
+        anadirMuestra(CANAL_ACTITUD, msUtc, valor, 6);
+    }
+        break;
+    case MENSAJE_ALTURA:
+        // El valor ya viene en little endian en la trama: se copia tal cual
+        anadirMuestra(CANAL_ALTURA, msUtc, mensaje.parametro+VistaAltura::Altura::desplazamiento, VistaAltura::TAM);
+        break;
+    case MENSAJE_COMBUSTIBLE:
+        anadirMuestra(CANAL_COMBUSTIBLE, msUtc, mensaje.parametro+VistaCombustible::Combustible::desplazamiento, VistaCombustible::TAM);
+        break;
+    case MENSAJE_RELOJ:
+        anadirMuestra(CANAL_RELOJ, msUtc, mensaje.parametro+VistaReloj::Reloj::desplazamiento, VistaReloj::TAM);
+        break;
+    case MENSAJE_COLISION:
+        valor[0]=mensaje.tipo;
+        valor[1]=0;
+        anadirEvento(msUtc, valor, 2);
+        break;
+    case MENSAJE_MSG_RADIO:
+    {
+        VistaRadio radio=mensaje.vista<VistaRadio>();
+        uchar longitud=(uchar)radio.longitud();
+        valor[0]=mensaje.tipo;
+        valor[1]=longitud;
+        memcpy(valor+2, radio.texto(), longitud);
+        anadirEvento(msUtc, valor, 2+longitud);
+    }
+        break;
+    default:
+        break;
+    }
+}
+
+#include "publicadormqtt.moc"
@@ -0,0 +1,82 @@
+// Publicacion de la telemetria decodificada en un broker MQTT (libreria qmqtt).
+// El hilo del GUI solo copia cada muestra al lote de su canal (seccion critica de unos pocos bytes); un hilo
+// aparte cierra los lotes respetando la tasa maxima de publicacion de cada canal y los envia, de forma que ni las
+// reconexiones ni la red bloquean la decodificacion. Cada publicacion lleva varias muestras en binario:
+//
+//   cabecera:  u8 version (1) | u8 canal | u16 numero de muestras | u64 instante de la primera muestra (ms UTC)
+//   muestra:   u16 ms desde la primera muestra | valor (tamaño fijo segun el canal, little endian)
+//
+//   canal actitud:      u16 roll, u16 pitch, u16 yaw (cuentas del ADC, 12 bits)
+//   canal altura:       float (m)
+//   canal combustible:  float
+//   canal reloj:        u32 (s)
+//   canal eventos:      u8 tipo de mensaje (colision, radio...) + u8 longitud + texto (solo radio)
+//
+// Los eventos no se limitan ni esperan a la revision periodica: cada uno despierta al hilo de red, que lo publica
+// en seguida con QoS 1 (solo van juntos los que lleguen antes de que se ejecute).
+
+#ifndef PUBLICADORMQTT_H
+#define PUBLICADORMQTT_H
+
+#include <QObject>
+#include <QMutex>
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+
+#include "telemetria.h"
+
+class TrabajadorMqtt;
+
+class PublicadorMqtt : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Canal {
+        CANAL_ACTITUD,
+        CANAL_ALTURA,
+        CANAL_COMBUSTIBLE,
+        CANAL_RELOJ,
+        CANAL_EVENTOS,
+        NUM_CANALES
+    };
+
+    PublicadorMqtt(const QString &servidor, quint16 puerto, const QString &prefijo, QObject *parent = 0);
+    ~PublicadorMqtt();
+
+    // Tasa maxima de publicaciones por segundo del canal (las muestras intermedias van en el mismo lote). No se
+    // aplica a CANAL_EVENTOS
+    void setTasaMaxima(Canal canal, double hz);
+
+    // Añade un mensaje decodificado al lote de su canal. Se llama desde el hilo del GUI y no bloquea
+    void publicar(const MensajeDecodificado &mensaje, qint64 msUtc);
+
+    // Contadores (solo informativos)
+    quint64 publicados() const;
+    quint64 descartados() const;
+
+private:
+    friend class TrabajadorMqtt;
+
+    struct Lote {
+        QByteArray muestras;       // Muestras ya serializadas (sin cabecera)
+        quint16 cuenta;
+        qint64 inicio;             // ms UTC de la primera muestra del lote
+    };
+
+    void anadirMuestra(Canal canal, qint64 msUtc, const void *valor, int tam);
+    void anadirEvento(qint64 msUtc, const void *valor, int tam);
+    bool extraerLote(Canal canal, QByteArray &payload);
+
+    QMutex cerrojo;                // Protege 'lotes' (GUI escribe, trabajador extrae)
+    Lote lotes[NUM_CANALES];
+    std::atomic<quint64> numPublicados;
+    std::atomic<quint64> numDescartados;
+    QThread hilo;
+    TrabajadorMqtt *trabajador;
+};
+
+#endif // PUBLICADORMQTT_H
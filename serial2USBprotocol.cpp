@@ -0,0 +1,77 @@
+﻿// Fichero con funciones para la gestion y creacion de tramas segun el protocolo de transmision de datos serializados
+// explicado en clase. El stuffing y el checksum los hace el codec generico (codectramas.h) instanciado con los
+// rasgos de la TIVA; estas funciones son la API en C de siempre sobre esa instanciacion
+#include<stdint.h>
+#include<stdbool.h>
+
+#include "codectramas.h"
+#include <string.h>
+
+//Funcion que crea un mensaje y lo introduce en una trama
+int32_t create_frame(uint8_t *frame,uint8_t message_type, void * param, int32_t param_size, int32_t max_size)
+{
+    return codec::CodecTiva::crear(frame,message_type,param,param_size,max_size);
+}
+
+//Destuffing y chequeo del checksum en un paquete recibido
+int32_t destuff_and_check_checksum (uint8_t *frame, int32_t max_size)
+{
+    return codec::CodecTiva::desempaquetar(frame,max_size);
+}
+
+//Destuffing sin chequeo del checksum (se comprueba despues con check_checksum_batch)
+int32_t destuff_frame (uint8_t *frame, int32_t max_size)
+{
+    return codec::CodecTiva::quitarStuffing(frame,max_size);
+}
+
+//Chequeo del checksum de muchas tramas ya sin stuffing, con los CRC calculados a la vez
+int32_t check_checksum_batch (uint8_t *const *frames, const int32_t *sizes, int32_t count, uint64_t *ok_bitmap)
+{
+    if (count<=0) return 0;
+    return (int32_t)codec::CodecTiva::verificarLote(frames,sizes,(size_t)count,ok_bitmap);
+}
+
+
+//Esta función obtiene el campo "tipo mensaje" de la trama
+uint8_t decode_message_type(uint8_t * buffer)
+{
+    return buffer[0];
+}
+
+//Esta función extrae el parametro de la trama y comprueba que el tamaño sea correcto
+//ptrtoparam es el puntero a la zona de memoria donde esta el parametro
+//param_size es su tamaño
+//param es una estructura por REFERENCIA
+//payload es el tamaño de la estructura que se pasa por REFERENCIA
+//Devuelve: Tamaño del parametro recibido o un valor negativo si hay error
+int32_t check_and_extract_message_param(void *ptrtoparam, int32_t param_size, uint32_t payload,void *param)
+{
+    if ((int32_t)payload==param_size)
+    {
+        memcpy(param,ptrtoparam,payload);
+        return payload;
+    }
+    else
+    {
+        return PROT_ERROR_INCORRECT_PARAM_SIZE;
+    }
+}
+
+
+//Esta función obtiene un puntero a la zona de memoria donde está el parámetro dentro de la trama
+//buffer es la zona de memoria donde esta almacenada la trama "Desestufada"
+//frame_size es su tamaño
+//campo es un puntero a void que se pasa por REFERENCIA. Quedará apuntando a la zona de memoria donde está el parametro
+//Devuelve: Tamaño del parametro recibido o un valor negativo si hay error
+int32_t get_message_param_pointer(uint8_t * buffer, int32_t frame_size, void **campo)
+{
+    int32_t param_size=frame_size-MESSAGE_SIZE-CHECKSUM_SIZE;
+
+    *campo=buffer+MESSAGE_SIZE;
+    if (param_size<0)
+        return PROT_ERROR_BAD_SIZE; //Devuelve un codigo de error
+    else
+        return param_size;
+}
+
@@ -47,5 +47,11 @@ int32_t get_message_param_pointer(uint8_t * buffer, int32_t frame_size, void **c
 int32_t create_frame(uint8_t *frame, uint8_t message_type, void * param, int32_t param_size, int32_t max_size);
 int32_t destuff_and_check_checksum (uint8_t *frame, int32_t max_size);
 
+//Verificacion en lote (muchas tramas a la vez): destuff_frame quita el stuffing sin comprobar el checksum, y
+//check_checksum_batch comprueba el de 'count' tramas ya sin stuffing. Deja en ok_bitmap un bit por trama (el de la
+//trama i es el i%64 de ok_bitmap[i/64]) y devuelve cuantas son correctas
+int32_t destuff_frame (uint8_t *frame, int32_t max_size);
+int32_t check_checksum_batch (uint8_t *const *frames, const int32_t *sizes, int32_t count, uint64_t *ok_bitmap);
+
 
 #endif
@@ -0,0 +1,141 @@
+#include "sincronizacion.h"
+
+#include <math.h>
+
+#define MARGEN_RETARDO_US 500.0    // Se usan las medidas con retardo hasta el minimo*1.5 mas este margen
+#define MAX_DERIVA 500e-6           // Deriva maxima creible entre los dos cristales (500 ppm)
+
+SincronizacionReloj::SincronizacionReloj()
+{
+    reiniciar();
+}
+
+void SincronizacionReloj::reiniciar()
+{
+    numMedidas=0;
+    siguiente=0;
+    secuencia=0;
+    t1Pendiente=0;
+    esperandoRespuesta=false;
+    origen=0;
+    base=0;
+    pendiente=0;
+    retardoMinimo=0;
+}
+
+PARAM_MENSAJE_SINCRONIZACION SincronizacionReloj::peticion(uint64_t ahora)
+{
+    PARAM_MENSAJE_SINCRONIZACION p;
+
+    // Una peticion sin respuesta se da por perdida al enviar la siguiente
+    secuencia++;
+    t1Pendiente=ahora;
+    esperandoRespuesta=true;
+
+    p.secuencia=secuencia;
+    p.t1=ahora;
+    p.t2=0;
+    p.t3=0;
+    return p;
+}
+
+void SincronizacionReloj::peticionGrabada(uint32_t numero, uint64_t t1)
+{
+    secuencia=numero;
+    t1Pendiente=t1;
+    esperandoRespuesta=true;
+}
+
+bool SincronizacionReloj::respuesta(const VistaSincronizacion &vista, uint64_t t4)
+{
+    if (!esperandoRespuesta || (vista.secuencia()!=secuencia) || (vista.t1()!=t1Pendiente)) return false;
+    esperandoRespuesta=false;
+
+    double t1=(double)vista.t1(), t2=(double)vista.t2(), t3=(double)vista.t3(), t=(double)t4;
+    Medida &m=historia[siguiente];
+    m.t=t;
+    m.desfase=((t2-t1)+(t3-t))/2;
+    m.retardo=(t-t1)-(t3-t2);
+    if (m.retardo<0) m.retardo=0;     // Redondeos del reloj de la TIVA
+
+    siguiente=(siguiente+1)%MAX_MEDIDAS;
+    if (numMedidas<MAX_MEDIDAS) numMedidas++;
+    ajustar();
+    return true;
+}
+
+// Ajuste por minimos cuadrados de la recta desfase(t) con las medidas de menor retardo
+void SincronizacionReloj::ajustar()
+{
+    double minimo=HUGE_VAL;
+    for (int i=0;i<numMedidas;i++)
+        if (historia[i].retardo<minimo) minimo=historia[i].retardo;
+    retardoMinimo=minimo;
+
+    double limite=minimo*1.5+MARGEN_RETARDO_US;
+    double st=0, sd=0;
+    int n=0;
+    for (int i=0;i<numMedidas;i++)
+    {
+        if (historia[i].retardo>limite) continue;
+        st+=historia[i].t;
+        sd+=historia[i].desfase;
+        n++;
+    }
+    origen=st/n;
+    base=sd/n;
+
+    double stt=0, std=0;
+    for (int i=0;i<numMedidas;i++)
+    {
+        if (historia[i].retardo>limite) continue;
+        double dt=historia[i].t-origen;
+        stt+=dt*dt;
+        std+=dt*(historia[i].desfase-base);
+    }
+    // Con las medidas muy juntas en el tiempo la pendiente no es fiable: se conserva la anterior
+    if ((n>=3)&&(stt>1e12))
+    {
+        pendiente=std/stt;
+        if (pendiente>MAX_DERIVA) pendiente=MAX_DERIVA;
+        if (pendiente<-MAX_DERIVA) pendiente=-MAX_DERIVA;
+    }
+}
+
+double SincronizacionReloj::desfase(uint64_t ahora) const
+{
+    return base+pendiente*((double)ahora-origen);
+}
+
+int64_t SincronizacionReloj::aHost(uint64_t tDispositivo) const
+{
+    // desfase(t) se evalua en el instante del PC; la diferencia entre hacerlo en t o en tDispositivo es la
+    // deriva por el desfase, despreciable
+    double tDisp=(double)tDispositivo;
+    double d=base+pendiente*(tDisp-base-origen);
+    return (int64_t)llround(tDisp-d);
+}
+
+uint64_t SincronizacionReloj::desenrollar(uint32_t marca, uint64_t ahora) const
+{
+    double esperado=(double)ahora+desfase(ahora);
+    if (esperado<0) esperado=0;
+    uint64_t e=(uint64_t)esperado;
+
+    // Candidato en la misma vuelta del contador de 32 bits que el instante esperado, y los de las vueltas vecinas
+    uint64_t c=(e&~(uint64_t)0xFFFFFFFF)|marca;
+    uint64_t mejor=c;
+    uint64_t distancia=(c>e) ? c-e : e-c;
+    if (c>=((uint64_t)1<<32))
+    {
+        uint64_t anterior=c-((uint64_t)1<<32);
+        if (e-anterior<distancia)
+        {
+            mejor=anterior;
+            distancia=e-anterior;
+        }
+    }
+    uint64_t posterior=c+((uint64_t)1<<32);
+    if (posterior-e<distancia) mejor=posterior;
+    return mejor;
+}
@@ -0,0 +1,78 @@
+// Sincronizacion del reloj del microcontrolador con el del PC, al estilo NTP, sobre el propio enlace serie.
+// El PC envia periodicamente MENSAJE_SINCRONIZACION con su instante t1; la TIVA responde con t2 (recepcion) y t3
+// (envio) medidos con su reloj, y el PC anota t4 al recibir la respuesta. De cada intercambio sale una medida
+//
+//   desfase = ((t2-t1)+(t3-t4))/2     (reloj de la TIVA menos reloj del PC)
+//   retardo = (t4-t1)-(t3-t2)         (ida y vuelta por el enlace)
+//
+// Se guardan las ultimas medidas y solo se usan las de menor retardo (las que menos han esperado en colas, y por
+// tanto las mas fiables); con ellas se ajusta por minimos cuadrados una recta desfase(t), cuya pendiente es la
+// deriva entre los dos relojes. Con esa recta las marcas de tiempo de la TIVA se llevan a la base de tiempos del
+// PC, lo que separa el retardo del enlace de la irregularidad del propio microcontrolador.
+// No depende de Qt: todos los instantes son microsegundos de un reloj monotono del PC que elige quien la usa.
+
+#ifndef SINCRONIZACION_H
+#define SINCRONIZACION_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "usb_messages_table.h"
+#include "vistasmensajes.h"
+
+class SincronizacionReloj
+{
+public:
+    static const int MAX_MEDIDAS=16;
+
+    SincronizacionReloj();
+
+    void reiniciar();
+
+    // Parametro de una nueva peticion (el PC la envia en el instante 'ahora')
+    PARAM_MENSAJE_SINCRONIZACION peticion(uint64_t ahora);
+
+    // Peticion ya enviada, leida de una grabacion: al reproducir, la respuesta grabada se empareja con ella
+    void peticionGrabada(uint32_t secuencia, uint64_t t1);
+
+    // Respuesta de la TIVA recibida en el instante 't4'. Devuelve false si no corresponde a la ultima peticion
+    bool respuesta(const VistaSincronizacion &vista, uint64_t t4);
+
+    bool sincronizado() const { return numMedidas>0; }
+
+    // Instante del PC que corresponde a un instante del reloj de la TIVA
+    int64_t aHost(uint64_t tDispositivo) const;
+
+    // Reconstruye un instante completo de la TIVA a partir de sus 32 bits bajos (marca de tiempo de un mensaje),
+    // eligiendo la vuelta del contador mas cercana a lo que se espera segun el instante del PC 'ahora'
+    uint64_t desenrollar(uint32_t marca, uint64_t ahora) const;
+
+    // Estimacion actual
+    double desfase(uint64_t ahora) const;       // us (TIVA - PC)
+    double deriva() const { return pendiente*1e6; }   // ppm
+    double retardo() const { return retardoMinimo; }  // Ida y vuelta de la mejor medida (us)
+    uint32_t medidas() const { return numMedidas; }
+
+private:
+    struct Medida {
+        double t;              // Instante del PC (us)
+        double desfase;
+        double retardo;
+    };
+
+    void ajustar();
+
+    Medida historia[MAX_MEDIDAS];
+    int numMedidas;
+    int siguiente;
+    uint32_t secuencia;
+    uint64_t t1Pendiente;      // t1 de la peticion que espera respuesta
+    bool esperandoRespuesta;
+    // Recta desfase(t)=base+pendiente*(t-origen)
+    double origen;
+    double base;
+    double pendiente;
+    double retardoMinimo;
+};
+
+#endif // SINCRONIZACION_H
@@ -0,0 +1,61 @@
+#include <string.h>
+
+#include "suscripciones.h"
+
+static const char *nombresCanales[] = { "actitud", "velocidad", "reloj", "combustible", "altura", "radio" };
+static_assert(sizeof(nombresCanales)/sizeof(nombresCanales[0])==NUM_CANALES_SUSCRIPCION, "Faltan nombres de canales");
+
+Suscripciones::Suscripciones()
+{
+    for (int c=0;c<NUM_CANALES_SUSCRIPCION;c++) pedidos[c]=PERIODO_TASA_NORMAL;
+    reiniciar();
+}
+
+void Suscripciones::reiniciar()
+{
+    for (int c=0;c<NUM_CANALES_SUSCRIPCION;c++)
+    {
+        enviados[c]=PERIODO_TASA_NORMAL;
+        aplicados[c]=-1;
+    }
+    fEnviado=false;
+    fSoportada=true;
+}
+
+bool Suscripciones::pendiente() const
+{
+    if (!fSoportada) return false;
+    return !fEnviado || memcmp(pedidos,enviados,sizeof(pedidos))!=0;
+}
+
+PARAM_MENSAJE_SUSCRIPCION Suscripciones::mensaje()
+{
+    PARAM_MENSAJE_SUSCRIPCION m;
+    for (int c=0;c<NUM_CANALES_SUSCRIPCION;c++)
+    {
+        m.periodo_ms[c]=pedidos[c];
+        enviados[c]=pedidos[c];
+    }
+    fEnviado=true;
+    return m;
+}
+
+void Suscripciones::confirmar(const VistaSuscripcion &v)
+{
+    for (int c=0;c<NUM_CANALES_SUSCRIPCION;c++) aplicados[c]=v.periodo(c);
+}
+
+uint16_t Suscripciones::periodoSoloAlarmas(double ventanaMinima)
+{
+    double periodo=ventanaMinima*1000.0/MUESTRAS_POR_VENTANA;
+
+    if (!(periodo>0)||(periodo>=PERIODO_SOLO_ALARMAS_MAXIMO)) return PERIODO_SOLO_ALARMAS_MAXIMO;
+    if (periodo<=PERIODO_SOLO_ALARMAS_MINIMO) return PERIODO_SOLO_ALARMAS_MINIMO;
+    return (uint16_t)periodo;
+}
+
+const char *Suscripciones::nombreCanal(int canal)
+{
+    if ((canal<0)||(canal>=NUM_CANALES_SUSCRIPCION)) return "?";
+    return nombresCanales[canal];
+}
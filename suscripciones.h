@@ -0,0 +1,65 @@
+// Suscripcion a los canales de telemetria (MENSAJE_SUSCRIPCION). Sin ella la TIVA envia todos los canales a su tasa
+// normal, aunque el GUI no los muestre (p.ej. con los indicadores deshabilitados). Con ella el GUI pide cada canal
+// a la tasa que necesita segun lo que se esta mostrando, grabando o vigilando, y deja de recibir el resto.
+// Esta clase guarda los periodos pedidos, los ultimos enviados y los que ha confirmado la TIVA, y decide cuando hay
+// que volver a enviar el mensaje: solo cuando cambia algo o se ha perdido la respuesta.
+// No depende de Qt: el GUI le pasa los periodos que quiere y envia el mensaje cuando hay cambios pendientes.
+
+#ifndef SUSCRIPCIONES_H
+#define SUSCRIPCIONES_H
+
+#include <stdint.h>
+
+#include "usb_messages_table.h"
+#include "vistasmensajes.h"
+
+// Periodo de los canales que no se muestran pero vigilan las alarmas (ms): el que da MUESTRAS_POR_VENTANA muestras
+// en la ventana mas corta de sus reglas, entre el minimo y el maximo. El maximo da 4 muestras en las ventanas de las
+// reglas por defecto (tasa(altura, 2)) y detecta el fin del combustible con medio segundo de retraso como mucho
+#define PERIODO_SOLO_ALARMAS_MAXIMO 500
+#define PERIODO_SOLO_ALARMAS_MINIMO 20
+#define MUESTRAS_POR_VENTANA 4
+
+class Suscripciones
+{
+public:
+    Suscripciones();
+
+    // Periodo que se quiere para un canal: PERIODO_TASA_NORMAL, un periodo en ms o PERIODO_DESACTIVADO
+    void pedir(int canal, uint16_t periodoMs) { pedidos[canal]=periodoMs; }
+    uint16_t pedido(int canal) const { return pedidos[canal]; }
+
+    // true si lo pedido no coincide con lo ultimo enviado (y la TIVA entiende el mensaje)
+    bool pendiente() const;
+
+    // Parametro del mensaje MENSAJE_SUSCRIPCION con lo pedido; lo da por enviado
+    PARAM_MENSAJE_SUSCRIPCION mensaje();
+
+    // Respuesta de la TIVA con los periodos que aplica
+    void confirmar(const VistaSuscripcion &v);
+    // Sin respuesta: se vuelve a enviar en la siguiente revision
+    void sinRespuesta() { fEnviado=false; }
+    // La TIVA no conoce el mensaje (firmware antiguo): lo envia todo y no tiene sentido insistir
+    void rechazar() { fSoportada=false; }
+    bool soportada() const { return fSoportada; }
+
+    // Periodo que ha confirmado la TIVA para un canal (-1 mientras no ha respondido)
+    int aplicado(int canal) const { return aplicados[canal]; }
+
+    // Al empezar un vuelo: no se sabe lo que tiene la TIVA, asi que la primera revision envia siempre
+    void reiniciar();
+
+    static const char *nombreCanal(int canal);
+
+    // Periodo para un canal que solo vigilan las alarmas, segun su ventana mas corta en segundos (0 si no hay)
+    static uint16_t periodoSoloAlarmas(double ventanaMinima);
+
+private:
+    uint16_t pedidos[NUM_CANALES_SUSCRIPCION];
+    uint16_t enviados[NUM_CANALES_SUSCRIPCION];
+    int aplicados[NUM_CANALES_SUSCRIPCION];
+    bool fEnviado;
+    bool fSoportada;
+};
+
+#endif // SUSCRIPCIONES_H
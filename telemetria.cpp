@@ -0,0 +1,253 @@
+#include "telemetria.h"
+#include "traza.h"
+
+#include <string.h>
+
+DecodificadorTramas::DecodificadorTramas()
+    : inicio(0)
+{
+    memset(&contadores,0,sizeof(contadores));
+    buffer.reserve(4*MAX_FRAME_SIZE);
+}
+
+void DecodificadorTramas::vaciar()
+{
+    buffer.clear();
+    inicio=0;
+}
+
+void DecodificadorTramas::separar(const uint8_t *datos, size_t longitud)
+{
+    size_t busqueda;           // A partir de aqui no hay STOP_FRAME_CHAR en el buffer
+
+    contadores.bytes+=longitud;
+    busqueda=buffer.size();
+    buffer.insert(buffer.end(),datos,datos+longitud);
+    mensajes.clear();
+    lote.clear();
+    tamLote.clear();
+    posicionLote.clear();
+
+    // Paso 1: reensamblado y destuffing de todas las tramas completas; el checksum se deja para el final
+    {
+        TRAZA_SPAN("decodificacion","separar_tramas");
+        for (size_t fin=busqueda;fin<buffer.size();fin++)
+        {
+            if (buffer[fin]!=STOP_FRAME_CHAR) continue;
+
+            // Busca hacia atras el caracter de inicio que va delante del de fin
+            size_t comienzo=fin;
+            while ((comienzo>inicio)&&(buffer[comienzo]!=START_FRAME_CHAR)) comienzo--;
+
+            MensajeDecodificado mensaje=MensajeDecodificado();
+            if (buffer[comienzo]!=START_FRAME_CHAR)
+            {
+                // No hay inicio: se tiran los bytes hasta el caracter de fin (inclusive)
+                contadores.fragmentos++;
+                mensaje.error=ERROR_TRAMA_SIN_INICIO;
+            }
+            else if ((fin-comienzo+1)>=MINIMUM_FRAME_SIZE)
+            {
+                // Se descuentan los bytes de inicio y fin del tamaño del paquete
+                int32_t tam=destuff_frame(&buffer[comienzo+1],(int32_t)(fin-comienzo-1));
+                if (tam<0)
+                {
+                    contadores.erroresCrc++;
+                    mensaje.error=tam;
+                }
+                else
+                {
+                    lote.push_back(&buffer[comienzo+1]);
+                    tamLote.push_back(tam);
+                    posicionLote.push_back(mensajes.size());
+                }
+            }
+            else
+            {
+                // La trama no está completa o no tiene el tamaño adecuado... no se procesa
+                contadores.fragmentos++;
+                mensaje.error=PROT_ERROR_BAD_SIZE;
+            }
+            mensajes.push_back(mensaje);
+            inicio=fin+1;          // Se elimina el trozo ya procesado
+        }
+    }
+    if (lote.empty()) return;
+
+    // Paso 2: el checksum de todas a la vez
+    correctas.resize((lote.size()+63)/64);
+    {
+        TRAZA_SPAN("decodificacion","check_checksum_batch");
+        check_checksum_batch(lote.data(),tamLote.data(),(int32_t)lote.size(),correctas.data());
+    }
+
+    // Paso 3: tipo y parametro de las correctas
+    for (size_t i=0;i<lote.size();i++)
+    {
+        MensajeDecodificado &mensaje=mensajes[posicionLote[i]];
+        if ((correctas[i/64]>>(i%64))&1)
+        {
+            decodificar_verificada(lote[i],tamLote[i],mensaje);
+            contadores.tramas++;
+        }
+        else
+        {
+            mensaje.error=PROT_ERROR_BAD_CHECKSUM;
+            contadores.erroresCrc++;
+        }
+    }
+}
+
+void DecodificadorTramas::compactar()
+{
+    if (inicio==buffer.size())
+    {
+        buffer.clear();
+        inicio=0;
+    }
+    else if (inicio>4096)
+    {
+        buffer.erase(buffer.begin(),buffer.begin()+(ptrdiff_t)inicio);
+        inicio=0;
+    }
+}
+
+// Tamaño esperado del parametro de cada tipo de mensaje (-1 si el mensaje no es conocido)
+static int32_t tam_parametro(uint8_t tipo)
+{
+    switch (tipo)
+    {
+    case MENSAJE_NO_IMPLEMENTADO: return VistaNoImplementado::TAM;
+    case MENSAJE_PING: return 0;
+    case MENSAJE_POTENCIOMETRO: return VistaPotenciometro::TAM;
+    case MENSAJE_VELOCIDAD: return VistaVelocidad::TAM;
+    case MENSAJE_RELOJ: return VistaReloj::TAM;
+    case MENSAJE_COMBUSTIBLE: return VistaCombustible::TAM;
+    case MENSAJE_ALTURA: return VistaAltura::TAM;
+    case MENSAJE_COLISION: return 0;
+    case MENSAJE_INICIO: return 0;
+    case MENSAJE_MSG_RADIO: return VistaRadio::TAM;
+    case MENSAJE_CONTROL_FLUJO: return VistaControlFlujo::TAM;
+    case MENSAJE_SINCRONIZACION: return VistaSincronizacion::TAM;
+    case MENSAJE_CODIFICACION: return VistaCodificacion::TAM;
+    case MENSAJE_POTENCIOMETRO_COMPACTO: return VistaPotenciometroCompacto::TAM;
+    case MENSAJE_VELOCIDAD_COMPACTO: return VistaVelocidadCompacto::TAM;
+    case MENSAJE_COMBUSTIBLE_COMPACTO: return VistaCombustibleCompacto::TAM;
+    case MENSAJE_ALTURA_COMPACTO: return VistaAlturaCompacto::TAM;
+    case MENSAJE_SUSCRIPCION: return VistaSuscripcion::TAM;
+    case MENSAJE_PRUEBA_ECO: return VistaPrueba::TAM;          // Minimo: ver tam_variable
+    case MENSAJE_PRUEBA_SUMIDERO: return VistaPrueba::TAM;
+    case MENSAJE_PRUEBA_RESUMEN: return VistaPruebaResumen::TAM;
+    default: return -1;
+    }
+}
+
+// Mensajes cuyo parametro puede llevar hasta 'tam_variable' bytes detras de los 'tam_parametro' fijos (no llevan
+// marca de tiempo: no se podria distinguir del resto del parametro)
+static int32_t tam_variable(uint8_t tipo)
+{
+    switch (tipo)
+    {
+    case MENSAJE_PRUEBA_ECO:
+    case MENSAJE_PRUEBA_SUMIDERO:
+        return VistaPrueba::MAX_CARGA;
+    default:
+        return 0;
+    }
+}
+
+// La expansion de un mensaje compacto escribe el parametro normal encima del compacto y de lo que le sigue en la
+// trama (la marca de tiempo, ya leida, y el checksum, ya comprobado)
+static_assert(VistaPotenciometro::TAM-VistaPotenciometroCompacto::TAM<=(int32_t)CHECKSUM_SIZE, "Expansion mayor que el checksum");
+static_assert(VistaVelocidad::TAM-VistaVelocidadCompacto::TAM<=(int32_t)CHECKSUM_SIZE, "Expansion mayor que el checksum");
+static_assert(VistaCombustible::TAM-VistaCombustibleCompacto::TAM<=(int32_t)CHECKSUM_SIZE, "Expansion mayor que el checksum");
+static_assert(VistaAltura::TAM-VistaAlturaCompacto::TAM<=(int32_t)CHECKSUM_SIZE, "Expansion mayor que el checksum");
+
+// Convierte en su sitio un mensaje compacto (empaquetado.h) en el normal equivalente, para que el resto del
+// programa no tenga que distinguirlos
+static void expandir_compacto(uint8_t *parametro, MensajeDecodificado &mensaje)
+{
+    switch (mensaje.tipo)
+    {
+    case MENSAJE_POTENCIOMETRO_COMPACTO:
+    {
+        uint16_t roll, pitch, yaw;
+        VistaPotenciometroCompacto(parametro).angulos(roll,pitch,yaw);
+        VistaPotenciometro::Roll::escribir(parametro,roll);
+        VistaPotenciometro::Pitch::escribir(parametro,pitch);
+        VistaPotenciometro::Yaw::escribir(parametro,yaw);
+        mensaje.tipo=MENSAJE_POTENCIOMETRO;
+        mensaje.tamParametro=VistaPotenciometro::TAM;
+    }
+        break;
+    case MENSAJE_VELOCIDAD_COMPACTO:
+        VistaVelocidad::Intensidad::escribir(parametro,VistaVelocidadCompacto(parametro).velocidad());
+        mensaje.tipo=MENSAJE_VELOCIDAD;
+        mensaje.tamParametro=VistaVelocidad::TAM;
+        break;
+    case MENSAJE_COMBUSTIBLE_COMPACTO:
+        VistaCombustible::Combustible::escribir(parametro,VistaCombustibleCompacto(parametro).combustible());
+        mensaje.tipo=MENSAJE_COMBUSTIBLE;
+        mensaje.tamParametro=VistaCombustible::TAM;
+        break;
+    case MENSAJE_ALTURA_COMPACTO:
+        VistaAltura::Altura::escribir(parametro,VistaAlturaCompacto(parametro).altura());
+        mensaje.tipo=MENSAJE_ALTURA;
+        mensaje.tamParametro=VistaAltura::TAM;
+        break;
+    default:
+        break;
+    }
+}
+
+void decodificar_trama(uint8_t *trama, int32_t tam, MensajeDecodificado &mensaje)
+{
+    // Paso 1: Destuffing y cálculo del CRC. Si todo va bien, obtengo la trama con valores actualizados
+    {
+        TRAZA_SPAN("decodificacion","destuff_and_check_checksum");
+        tam=destuff_and_check_checksum(trama,tam);
+    }
+    if (tam<0)
+    {
+        mensaje.error=tam;
+        return;
+    }
+
+    // Paso 2: tipo de mensaje y parametro
+    decodificar_verificada(trama,tam,mensaje);
+}
+
+void decodificar_verificada(uint8_t *trama, int32_t tam, MensajeDecodificado &mensaje)
+{
+    void *ptrtoparam;
+    int32_t esperado;
+
+    // El parametro se deja en la trama; las vistas lo leen en su sitio
+    mensaje.error=0;
+    mensaje.tipo=decode_message_type(trama);
+    mensaje.tamParametro=get_message_param_pointer(trama,tam,&ptrtoparam);
+    mensaje.parametro=(const uint8_t *)ptrtoparam;
+    mensaje.tieneMarca=false;
+    mensaje.marcaDispositivo=0;
+    mensaje.instante=-1;
+    esperado=tam_parametro(mensaje.tipo);
+
+    if (tam_variable(mensaje.tipo)>0)
+        mensaje.parametroValido=(mensaje.tamParametro>=esperado)&&(mensaje.tamParametro<=esperado+tam_variable(mensaje.tipo));
+    else if ((esperado>=0)&&(mensaje.tamParametro==esperado+VistaMarcaTiempo::TAM))
+    {
+        // Parametro seguido de la marca de tiempo del microcontrolador
+        mensaje.parametroValido=true;
+        mensaje.tieneMarca=true;
+        mensaje.marcaDispositivo=VistaMarcaTiempo(mensaje.parametro+esperado).t();
+        mensaje.tamParametro=esperado;
+    }
+    else if (esperado==0)
+        mensaje.parametroValido=true;    // Mensajes sin parametros
+    else if (esperado>0)
+        mensaje.parametroValido=(mensaje.tamParametro==esperado);
+    else
+        mensaje.parametroValido=false;
+
+    if (mensaje.parametroValido) expandir_compacto((uint8_t *)ptrtoparam,mensaje);
+}
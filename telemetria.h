@@ -0,0 +1,101 @@
+// Capa de decodificacion de la telemetria, independiente de Qt: reensamblado de tramas a partir del flujo de
+// bytes del puerto serie, destuffing/CRC y extraccion del parametro de cada mensaje. La usan tanto el GUI
+// (GUIPanel::readRequest) como las herramientas de linea de comandos, para que todos decodifiquen igual.
+
+#ifndef TELEMETRIA_H
+#define TELEMETRIA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+extern "C" {
+#include "serial2USBprotocol.h"
+}
+#include "usb_messages_table.h"
+#include "vistasmensajes.h"
+
+// Bytes hasta un caracter de fin sin caracter de inicio delante: el resto de una trama cuyo principio se ha perdido
+// (p.ej. al conectar a mitad de una). Se cuenta en EstadisticasEnlace::fragmentos como las tramas cortas
+#define ERROR_TRAMA_SIN_INICIO (-100)
+
+// Mensaje ya decodificado. 'error' vale 0 si la trama es correcta, o uno de los codigos PROT_ERROR_* (o
+// ERROR_TRAMA_SIN_INICIO) si no lo es (en ese caso el resto de campos no son validos)
+//
+// El parametro no se copia: 'parametro' apunta a la trama dentro del buffer del decodificador y solo es valido
+// durante la llamada a 'procesar'. Los campos se leen con las vistas de vistasmensajes.h, p.ej.
+// mensaje.vista<VistaAltura>().altura(). Quien necesite guardar el mensaje debe copiar los valores que use.
+struct MensajeDecodificado {
+    int32_t error;
+    uint8_t tipo;              // messageTypes
+    bool parametroValido;      // El tamaño del parametro coincide con el esperado para el tipo
+    int32_t tamParametro;      // Sin contar la marca de tiempo
+    const uint8_t *parametro;
+    bool tieneMarca;           // El parametro va seguido de la marca de tiempo del microcontrolador
+    uint32_t marcaDispositivo; // 32 bits bajos del reloj del microcontrolador (us)
+    int64_t instante;          // Instante de la muestra en la base de tiempos del PC (us). Lo rellena el receptor
+                               // (ver SincronizacionReloj); el decodificador lo deja a -1
+
+    template <class Vista>
+    Vista vista() const { return Vista(parametro); }
+};
+
+// Contadores del enlace, acumulados desde la creacion del decodificador
+struct EstadisticasEnlace {
+    uint64_t bytes;            // Bytes recibidos
+    uint64_t tramas;           // Tramas correctas
+    uint64_t erroresCrc;       // Tramas descartadas por stuffing o CRC
+    uint64_t fragmentos;       // Trozos de trama incompletos descartados
+};
+
+// Decodifica una trama ya sin los caracteres de inicio y fin (se modifica en el sitio al hacer el destuffing)
+void decodificar_trama(uint8_t *trama, int32_t tam, MensajeDecodificado &mensaje);
+
+// Lo mismo con una trama a la que ya se le ha quitado el stuffing y comprobado el checksum ('tam' lo incluye)
+void decodificar_verificada(uint8_t *trama, int32_t tam, MensajeDecodificado &mensaje);
+
+// Reensamblador de tramas. Se le van pasando los bytes segun llegan (pueden venir varias tramas juntas o una
+// trama partida) y llama a 'procesar' con cada mensaje completo, correcto o erroneo.
+// Las tramas que se completan en una misma llamada se verifican juntas (check_checksum_batch): al ponerse al dia
+// tras una rafaga o al leer una captura entera, los CRC se calculan intercalados en vez de uno tras otro.
+// No es reentrante: 'procesar' no puede llamar a anadir ni a vaciar del mismo decodificador, porque los mensajes
+// pendientes de entregar y sus parametros estan en sus buffers.
+class DecodificadorTramas
+{
+public:
+    DecodificadorTramas();
+
+    template <class Funcion>
+    int anadir(const uint8_t *datos, size_t longitud, Funcion &&procesar);
+
+    void vaciar();
+    size_t pendientes() const { return buffer.size()-inicio; }   // Bytes a la espera de completar trama
+    const EstadisticasEnlace &estadisticas() const { return contadores; }
+
+private:
+    // Reensambla y decodifica en 'mensajes' las tramas que completan los datos nuevos
+    void separar(const uint8_t *datos, size_t longitud);
+    // Descarta lo ya procesado del buffer
+    void compactar();
+
+    std::vector<uint8_t> buffer;
+    size_t inicio;             // Primer byte sin procesar de 'buffer' (se compacta al vaciarse)
+    EstadisticasEnlace contadores;
+
+    std::vector<MensajeDecodificado> mensajes;   // Los de la llamada en curso, en orden (apuntan a 'buffer')
+    std::vector<uint8_t *> lote;                 // Tramas sin stuffing pendientes del checksum
+    std::vector<int32_t> tamLote;
+    std::vector<size_t> posicionLote;            // Su mensaje en 'mensajes'
+    std::vector<uint64_t> correctas;             // Mapa de bits del checksum
+};
+
+template <class Funcion>
+int DecodificadorTramas::anadir(const uint8_t *datos, size_t longitud, Funcion &&procesar)
+{
+    separar(datos,longitud);
+    for (const MensajeDecodificado &mensaje : mensajes) procesar(mensaje);
+    compactar();
+    return (int)mensajes.size();
+}
+
+#endif // TELEMETRIA_H
@@ -0,0 +1,245 @@
+// Segmento de memoria compartida con la telemetria (ver telemetria_shm.h)
+#include "telemetria_shm.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHM_MAGIA 0x4D454C54u     // "TLEM"
+#define SHM_VERSION 1u
+#define MASCARA_EVENTOS (SHM_TELEMETRIA_EVENTOS-1)
+
+// Cada hueco del anillo tiene su propio seqlock: vale 2*n+1 mientras se escribe el evento n y 2*n+2 cuando esta
+// completo. Asi el lector sabe si el hueco contiene el evento que busca o ya ha sido sobrescrito
+typedef struct {
+    _Atomic uint64_t secuencia;
+    evento_telemetria_t evento;
+} hueco_evento_t;
+
+// Disposicion del segmento. Las variables del seqlock van en lineas de cache distintas de los datos
+typedef struct {
+    uint32_t magia;
+    uint32_t version;
+    uint32_t tam;
+    uint32_t reservado;
+    _Alignas(64) _Atomic uint32_t secuencia;   // Seqlock de la instantanea: impar mientras se escribe
+    _Alignas(64) estado_telemetria_t estado;
+    _Alignas(64) _Atomic uint64_t eventos_escritos;
+    _Alignas(64) hueco_evento_t eventos[SHM_TELEMETRIA_EVENTOS];
+} segmento_t;
+
+struct shm_telemetria {
+    segmento_t *segmento;
+    int escritor;
+    int fd;                    // Escritor: abierto mientras dura, para mantener el cerrojo
+    char *nombre;              // Escritor: para borrar el segmento al cerrar
+};
+
+static uint64_t instante_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+(uint64_t)t.tv_nsec;
+}
+
+shm_telemetria_t *shm_telemetria_crear(const char *nombre)
+{
+    shm_telemetria_t *shm;
+    segmento_t *seg;
+    int fd;
+
+    fd=shm_open(nombre,O_RDWR|O_CREAT,0644);
+    if (fd<0) return NULL;
+
+    // Un solo escritor: el cerrojo dura lo que el descriptor, asi que si el escritor anterior ha muerto esta libre
+    // y el segmento se reutiliza
+    if ((flock(fd,LOCK_EX|LOCK_NB)<0)||(ftruncate(fd,sizeof(segmento_t))<0))
+    {
+        close(fd);
+        return NULL;
+    }
+    seg=(segmento_t *)mmap(NULL,sizeof(segmento_t),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    if (seg==MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    shm=(shm_telemetria_t *)malloc(sizeof(shm_telemetria_t));
+    if (shm) shm->nombre=strdup(nombre);
+    if (!shm || !shm->nombre)
+    {
+        free(shm);
+        munmap(seg,sizeof(segmento_t));
+        close(fd);
+        return NULL;
+    }
+
+    // Se reinicia el contenido; la magia se escribe la ultima para que ningun lector valide un segmento a medias
+    atomic_store_explicit(&seg->secuencia,0,memory_order_relaxed);
+    atomic_store_explicit(&seg->eventos_escritos,0,memory_order_relaxed);
+    memset(&seg->estado,0,sizeof(seg->estado));
+    for (int i=0;i<SHM_TELEMETRIA_EVENTOS;i++)
+        atomic_store_explicit(&seg->eventos[i].secuencia,0,memory_order_relaxed);
+    seg->version=SHM_VERSION;
+    seg->tam=sizeof(segmento_t);
+    atomic_thread_fence(memory_order_release);
+    seg->magia=SHM_MAGIA;
+
+    shm->segmento=seg;
+    shm->escritor=1;
+    shm->fd=fd;
+    return shm;
+}
+
+shm_telemetria_t *shm_telemetria_abrir(const char *nombre)
+{
+    shm_telemetria_t *shm;
+    segmento_t *seg;
+    struct stat info;
+    int fd;
+
+    fd=shm_open(nombre,O_RDONLY,0);
+    if (fd<0) return NULL;
+    if ((fstat(fd,&info)<0)||(info.st_size<(off_t)sizeof(segmento_t)))
+    {
+        close(fd);
+        return NULL;
+    }
+    seg=(segmento_t *)mmap(NULL,sizeof(segmento_t),PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (seg==MAP_FAILED) return NULL;
+
+    if ((seg->magia!=SHM_MAGIA)||(seg->version!=SHM_VERSION)||(seg->tam!=sizeof(segmento_t)))
+    {
+        munmap(seg,sizeof(segmento_t));
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    shm=(shm_telemetria_t *)malloc(sizeof(shm_telemetria_t));
+    if (!shm)
+    {
+        munmap(seg,sizeof(segmento_t));
+        return NULL;
+    }
+    shm->segmento=seg;
+    shm->escritor=0;
+    shm->fd=-1;
+    shm->nombre=NULL;
+    return shm;
+}
+
+void shm_telemetria_cerrar(shm_telemetria_t *shm)
+{
+    if (!shm) return;
+    munmap(shm->segmento,sizeof(segmento_t));
+    if (shm->escritor)
+    {
+        // Se borra antes de soltar el cerrojo, para no borrar el de un escritor nuevo
+        shm_unlink(shm->nombre);
+        close(shm->fd);
+        free(shm->nombre);
+    }
+    free(shm);
+}
+
+// Escritura con seqlock: secuencia impar, datos, secuencia par. Solo hay un escritor, asi que no hace falta
+// ninguna operacion atomica de lectura-modificacion-escritura
+void shm_telemetria_publicar(shm_telemetria_t *shm, const estado_telemetria_t *estado)
+{
+    segmento_t *seg=shm->segmento;
+    uint32_t s=atomic_load_explicit(&seg->secuencia,memory_order_relaxed);
+
+    atomic_store_explicit(&seg->secuencia,s+1,memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&seg->estado,estado,sizeof(*estado));
+    seg->estado.instante_ns=instante_ns();
+    atomic_store_explicit(&seg->secuencia,s+2,memory_order_release);
+}
+
+int shm_telemetria_leer(const shm_telemetria_t *shm, estado_telemetria_t *estado)
+{
+    segmento_t *seg=shm->segmento;
+    uint32_t s1,s2;
+
+    // Si el escritor muere con la secuencia impar no se va a completar nunca: se acaba dando por vencido
+    for (int i=0;i<SHM_TELEMETRIA_REINTENTOS;i++)
+    {
+        s1=atomic_load_explicit(&seg->secuencia,memory_order_acquire);
+        if (s1&1) continue;              // El escritor esta a mitad de actualizacion
+        memcpy(estado,&seg->estado,sizeof(*estado));
+        atomic_thread_fence(memory_order_acquire);
+        s2=atomic_load_explicit(&seg->secuencia,memory_order_relaxed);
+        if (s1==s2) return s1 ? 0 : -1;
+    }
+    return -2;
+}
+
+void shm_telemetria_evento(shm_telemetria_t *shm, uint8_t tipo, const void *datos, uint8_t longitud)
+{
+    segmento_t *seg=shm->segmento;
+    uint64_t n=atomic_load_explicit(&seg->eventos_escritos,memory_order_relaxed);
+    hueco_evento_t *hueco=&seg->eventos[n&MASCARA_EVENTOS];
+
+    if (longitud>sizeof(hueco->evento.datos)) longitud=sizeof(hueco->evento.datos);
+
+    atomic_store_explicit(&hueco->secuencia,2*n+1,memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    hueco->evento.secuencia=n;
+    hueco->evento.instante_ns=instante_ns();
+    hueco->evento.tipo=tipo;
+    hueco->evento.longitud=longitud;
+    if (longitud) memcpy(hueco->evento.datos,datos,longitud);
+    atomic_store_explicit(&hueco->secuencia,2*n+2,memory_order_release);
+    atomic_store_explicit(&seg->eventos_escritos,n+1,memory_order_release);
+}
+
+uint64_t shm_telemetria_eventos_escritos(const shm_telemetria_t *shm)
+{
+    return atomic_load_explicit(&shm->segmento->eventos_escritos,memory_order_acquire);
+}
+
+int shm_telemetria_siguiente_evento(const shm_telemetria_t *shm, uint64_t *cursor, evento_telemetria_t *evento,
+                                    uint64_t *perdidos)
+{
+    segmento_t *seg=shm->segmento;
+
+    for (;;)
+    {
+        uint64_t escritos=atomic_load_explicit(&seg->eventos_escritos,memory_order_acquire);
+        uint64_t n=*cursor;
+
+        if (n>=escritos) return 0;
+        if (escritos-n>SHM_TELEMETRIA_EVENTOS)
+        {
+            // El anillo ya ha dado la vuelta: se salta al evento mas antiguo que sigue disponible
+            if (perdidos) *perdidos+=escritos-SHM_TELEMETRIA_EVENTOS-n;
+            n=escritos-SHM_TELEMETRIA_EVENTOS;
+            *cursor=n;
+        }
+
+        const hueco_evento_t *hueco=&seg->eventos[n&MASCARA_EVENTOS];
+        uint64_t s1=atomic_load_explicit(&hueco->secuencia,memory_order_acquire);
+        if (s1==2*n+2)
+        {
+            memcpy(evento,&hueco->evento,sizeof(*evento));
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&hueco->secuencia,memory_order_relaxed)==s1)
+            {
+                *cursor=n+1;
+                return 1;
+            }
+        }
+        // El hueco se ha sobrescrito mientras se leia (el escritor va una vuelta por delante): se pierde el
+        // evento y se vuelve a intentar con el siguiente
+        if (perdidos) (*perdidos)++;
+        *cursor=n+1;
+    }
+}
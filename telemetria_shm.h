@@ -0,0 +1,82 @@
+// Publicacion del estado del avion en memoria compartida POSIX, para que otros procesos locales (grabadores,
+// alarmas, paneles...) lo lean sin tocar el puerto serie.
+//
+// El segmento contiene una "instantanea" del ultimo estado decodificado, protegida por un seqlock (el escritor
+// nunca espera a los lectores y los lectores reintentan si la leen a medias), y un anillo de los ultimos eventos
+// (colision, mensajes de radio, fin de combustible). Una vez abierto el segmento, leer no necesita llamadas al
+// sistema: son solo lecturas de memoria. Hay un unico escritor (el GUI) y cualquier numero de lectores: el escritor
+// tiene un cerrojo (flock) sobre el segmento y otro GUI no puede crearlo mientras tanto. Al cerrarse el escritor el
+// segmento se borra; los lectores que lo tengan abierto siguen viendo el ultimo estado y tienen que volver a
+// abrirlo para seguir al siguiente escritor.
+//
+// Esta cabecera y telemetria_shm.c son toda la libreria del lector; se pueden copiar tal cual a otro proyecto C.
+
+#ifndef TELEMETRIA_SHM_H
+#define TELEMETRIA_SHM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHM_TELEMETRIA_NOMBRE "/guipanel_telemetria"   // Nombre por defecto del segmento (shm_open)
+#define SHM_TELEMETRIA_EVENTOS 256                     // Capacidad del anillo de eventos (potencia de 2)
+#define SHM_TELEMETRIA_REINTENTOS 100000               // Lecturas de la instantanea antes de darse por vencido
+
+// Ultimo estado conocido del avion
+typedef struct {
+    uint64_t instante_ns;      // CLOCK_MONOTONIC de la ultima actualizacion (comun a todos los procesos)
+    uint64_t mensajes;         // Mensajes decodificados desde el arranque
+    uint64_t errores_crc;
+    uint16_t roll;             // Cuentas del ADC (12 bits), como llegan de la TIVA
+    uint16_t pitch;
+    uint16_t yaw;
+    uint16_t reservado;
+    float velocidad;           // km/h mostrados en el GUI
+    float combustible;
+    float altura;              // m
+    uint32_t reloj;            // s
+    uint8_t colision;          // 1 desde que se recibe MENSAJE_COLISION
+    uint8_t sin_combustible;
+    char radio[41];            // Ultimo mensaje de radio, terminado en '\0'
+} estado_telemetria_t;
+
+// Evento del anillo
+typedef struct {
+    uint64_t secuencia;        // Numero de evento desde el arranque (empieza en 0)
+    uint64_t instante_ns;      // CLOCK_MONOTONIC
+    uint8_t tipo;              // messageTypes (MENSAJE_COLISION, MENSAJE_MSG_RADIO, MENSAJE_COMBUSTIBLE)
+    uint8_t longitud;          // Bytes validos en 'datos'
+    uint8_t datos[40];
+} evento_telemetria_t;
+
+typedef struct shm_telemetria shm_telemetria_t;
+
+// Escritor (GUI). Crea (o reutiliza, si lo dejo un escritor que ya no existe) el segmento; devuelve NULL si no se
+// puede o si ya tiene otro escritor
+shm_telemetria_t *shm_telemetria_crear(const char *nombre);
+void shm_telemetria_publicar(shm_telemetria_t *shm, const estado_telemetria_t *estado);
+void shm_telemetria_evento(shm_telemetria_t *shm, uint8_t tipo, const void *datos, uint8_t longitud);
+
+// Lector. Abre un segmento existente en solo lectura; devuelve NULL si no existe o no es compatible
+shm_telemetria_t *shm_telemetria_abrir(const char *nombre);
+// Copia la ultima instantanea coherente. Devuelve 0, -1 si el escritor todavia no ha publicado nada, o -2 si tras
+// SHM_TELEMETRIA_REINTENTOS intentos no la ha podido leer entera (el escritor ha muerto a mitad de una publicacion)
+int shm_telemetria_leer(const shm_telemetria_t *shm, estado_telemetria_t *estado);
+// Lee el evento numero '*cursor' y avanza el cursor. Devuelve 1 si hay evento, 0 si no hay eventos nuevos.
+// Si el lector se ha quedado atras y el anillo ha sobrescrito eventos, el cursor salta al mas antiguo que
+// queda y en '*perdidos' (si no es NULL) se suman los que se han perdido
+int shm_telemetria_siguiente_evento(const shm_telemetria_t *shm, uint64_t *cursor, evento_telemetria_t *evento,
+                                    uint64_t *perdidos);
+// Numero del proximo evento que se escribira (para empezar a leer solo los eventos nuevos)
+uint64_t shm_telemetria_eventos_escritos(const shm_telemetria_t *shm);
+
+// El escritor borra ademas el segmento (shm_unlink)
+void shm_telemetria_cerrar(shm_telemetria_t *shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRIA_SHM_H
@@ -0,0 +1,155 @@
+#include "traza.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#define MASCARA_EVENTOS (Traza::EVENTOS_POR_HILO-1)
+
+struct EventoTraza {
+    const char *categoria;
+    const char *nombre;
+    uint64_t inicio;           // ns
+    uint64_t fin;
+};
+
+// Buffer de un hilo. Solo escribe el hilo propietario; 'escritos' se publica con release despues de cada evento
+// para que el volcado sepa hasta donde leer
+struct BufferTraza {
+    EventoTraza eventos[Traza::EVENTOS_POR_HILO];
+    std::atomic<uint64_t> escritos;
+    int tid;
+    const char *nombre;
+};
+
+std::atomic<bool> Traza::activa(false);
+
+// Los buffers se registran al crearse (una vez por hilo) y no se liberan nunca, para poder volcar tambien los de
+// hilos que ya han terminado
+static std::mutex cerrojoRegistro;
+static std::vector<BufferTraza *> buffers;
+static std::set<std::string> nombresInternados;
+static thread_local BufferTraza *bufferHilo=nullptr;
+
+static BufferTraza *buffer_hilo()
+{
+    if (!bufferHilo)
+    {
+        BufferTraza *b=new BufferTraza;
+        b->escritos.store(0,std::memory_order_relaxed);
+        b->nombre=nullptr;
+        std::lock_guard<std::mutex> bloqueo(cerrojoRegistro);
+        b->tid=(int)buffers.size()+1;
+        buffers.push_back(b);
+        bufferHilo=b;
+    }
+    return bufferHilo;
+}
+
+void Traza::activar(bool si)
+{
+    activa.store(si,std::memory_order_relaxed);
+}
+
+uint64_t Traza::ahora()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC,&t);
+    return (uint64_t)t.tv_sec*1000000000ull+(uint64_t)t.tv_nsec;
+}
+
+void Traza::registrar(const char *categoria, const char *nombre, uint64_t inicio, uint64_t fin)
+{
+    BufferTraza *b=buffer_hilo();
+    uint64_t n=b->escritos.load(std::memory_order_relaxed);
+    EventoTraza &e=b->eventos[n&MASCARA_EVENTOS];
+
+    e.categoria=categoria;
+    e.nombre=nombre;
+    e.inicio=inicio;
+    e.fin=fin;
+    b->escritos.store(n+1,std::memory_order_release);
+}
+
+void Traza::nombrarHilo(const char *nombre)
+{
+    buffer_hilo()->nombre=internar(nombre);
+}
+
+const char *Traza::internar(const char *texto)
+{
+    std::lock_guard<std::mutex> bloqueo(cerrojoRegistro);
+    return nombresInternados.insert(texto).first->c_str();
+}
+
+// Escribe una cadena JSON escapando comillas, barras y caracteres de control
+static void escribir_cadena(FILE *f, const char *s)
+{
+    fputc('"',f);
+    for (;*s;s++)
+    {
+        unsigned char c=(unsigned char)*s;
+        if ((c=='"')||(c=='\\')) fprintf(f,"\\%c",c);
+        else if (c<0x20) fprintf(f,"\\u%04x",c);
+        else fputc(c,f);
+    }
+    fputc('"',f);
+}
+
+bool Traza::volcar(const char *fichero)
+{
+    FILE *f=fopen(fichero,"w");
+    if (!f) return false;
+
+    std::vector<BufferTraza *> copia;
+    {
+        std::lock_guard<std::mutex> bloqueo(cerrojoRegistro);
+        copia=buffers;
+    }
+
+    int pid=(int)getpid();
+    std::vector<EventoTraza> eventos;
+    bool primero=true;
+
+    fprintf(f,"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (BufferTraza *b : copia)
+    {
+        // Copia de los eventos disponibles; despues se descartan los que el hilo haya podido sobrescribir mientras
+        uint64_t n1=b->escritos.load(std::memory_order_acquire);
+        uint64_t desde=(n1>EVENTOS_POR_HILO) ? n1-EVENTOS_POR_HILO : 0;
+        eventos.resize((size_t)(n1-desde));
+        for (uint64_t i=desde;i<n1;i++) eventos[(size_t)(i-desde)]=b->eventos[i&MASCARA_EVENTOS];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t n2=b->escritos.load(std::memory_order_relaxed);
+        // 'escritos' se incrementa despues de escribir el hueco, asi que el del evento n2 puede estar a medias
+        uint64_t validoDesde=(n2>=EVENTOS_POR_HILO) ? n2-EVENTOS_POR_HILO+1 : 0;
+
+        if (b->nombre)
+        {
+            fprintf(f,"%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                    primero ? "" : ",\n",pid,b->tid);
+            escribir_cadena(f,b->nombre);
+            fprintf(f,"}}");
+            primero=false;
+        }
+        for (uint64_t i=(validoDesde>desde ? validoDesde : desde);i<n1;i++)
+        {
+            const EventoTraza &e=eventos[(size_t)(i-desde)];
+            fprintf(f,"%s{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"cat\":",primero ? "" : ",\n",
+                    pid,b->tid,(double)e.inicio/1000.0,(double)(e.fin-e.inicio)/1000.0);
+            escribir_cadena(f,e.categoria);
+            fprintf(f,",\"name\":");
+            escribir_cadena(f,e.nombre);
+            fputc('}',f);
+            primero=false;
+        }
+    }
+    fprintf(f,"\n]}\n");
+    return fclose(f)==0;
+}
@@ -0,0 +1,79 @@
+// Instrumentacion del camino de datos con intervalos ("spans") que se vuelcan en formato Chrome trace-event JSON
+// (se abre con chrome://tracing o https://ui.perfetto.dev). Los contadores dicen que algo va lento; la linea de
+// tiempos dice en que frame y en que etapa.
+//
+// Cada hilo escribe en su propio buffer circular, sin cerrojos ni reservas de memoria: registrar un intervalo son
+// dos lecturas del reloj y una escritura en el buffer. Con la traza desactivada un SpanTraza solo comprueba un
+// flag atomico; compilando con SIN_TRAZAS la macro TRAZA_SPAN desaparece del todo.
+//
+// Los nombres tienen que ser cadenas que vivan mientras dure el programa (literales, o internar()).
+// No depende de Qt.
+
+#ifndef TRAZA_H
+#define TRAZA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+class Traza
+{
+public:
+    static const size_t EVENTOS_POR_HILO=1<<16;    // Se conservan los mas recientes
+
+    static void activar(bool si);
+    static bool activada() { return activa.load(std::memory_order_relaxed); }
+
+    static uint64_t ahora();                       // ns, reloj monotono
+
+    // Anota un intervalo ya medido en el buffer del hilo que llama
+    static void registrar(const char *categoria, const char *nombre, uint64_t inicio, uint64_t fin);
+
+    // Nombre con el que aparece el hilo que llama en la traza
+    static void nombrarHilo(const char *nombre);
+
+    // Copia 'texto' a un almacen que no se libera nunca y devuelve la copia (la misma para el mismo texto).
+    // Usa un cerrojo: es para preparar nombres, no para el camino caliente
+    static const char *internar(const char *texto);
+
+    // Escribe todos los buffers en 'fichero' como JSON. Se puede llamar con los hilos escribiendo: los eventos
+    // que se sobrescriben mientras se copian se descartan. Devuelve false si no se puede escribir el fichero
+    static bool volcar(const char *fichero);
+
+private:
+    static std::atomic<bool> activa;
+};
+
+class SpanTraza
+{
+public:
+    SpanTraza(const char *categoria, const char *nombre)
+        : categoria(categoria), nombre(nombre), inicio(Traza::activada() ? Traza::ahora() : 0)
+    {
+    }
+
+    ~SpanTraza()
+    {
+        if (inicio) Traza::registrar(categoria, nombre, inicio, Traza::ahora());
+    }
+
+private:
+    SpanTraza(const SpanTraza &);
+    SpanTraza &operator=(const SpanTraza &);
+
+    const char *categoria;
+    const char *nombre;
+    uint64_t inicio;           // 0 si la traza estaba desactivada al empezar
+};
+
+#define TRAZA_CONCATENAR2(a, b) a##b
+#define TRAZA_CONCATENAR(a, b) TRAZA_CONCATENAR2(a, b)
+
+#ifdef SIN_TRAZAS
+#define TRAZA_SPAN(categoria, nombre) do {} while (0)
+#else
+// Intervalo que dura hasta el final del bloque
+#define TRAZA_SPAN(categoria, nombre) SpanTraza TRAZA_CONCATENAR(spanTraza, __LINE__)(categoria, nombre)
+#endif
+
+#endif // TRAZA_H
@@ -21,6 +21,17 @@ typedef enum {
     MENSAJE_COLISION,
     MENSAJE_INICIO,
     MENSAJE_MSG_RADIO,
+    MENSAJE_CONTROL_FLUJO,
+    MENSAJE_SINCRONIZACION,
+    MENSAJE_CODIFICACION,
+    MENSAJE_POTENCIOMETRO_COMPACTO,
+    MENSAJE_VELOCIDAD_COMPACTO,
+    MENSAJE_COMBUSTIBLE_COMPACTO,
+    MENSAJE_ALTURA_COMPACTO,
+    MENSAJE_SUSCRIPCION,
+    MENSAJE_PRUEBA_ECO,
+    MENSAJE_PRUEBA_SUMIDERO,
+    MENSAJE_PRUEBA_RESUMEN,
     //etc, etc...
 } messageTypes;
 
@@ -62,6 +73,102 @@ typedef struct {
     char caracteres[40]; // 40 mas el terminador de string
 } PACKED PARAM_MENSAJE_MSG_RADIO;
 
+//Control de flujo: el PC pide al microcontrolador que reduzca la telemetria cuando no da abasto, y el
+//microcontrolador responde con el mismo mensaje indicando el nivel que ha aplicado
+typedef enum {
+    FLUJO_NORMAL,       // Todas las muestras
+    FLUJO_REDUCIDO,     // Los canales periodicos a la tasa indicada en periodo_ms
+    FLUJO_RESUMEN,      // Solo el ultimo valor de cada canal cada periodo_ms (los eventos se envian siempre)
+} nivelesFlujo;
+
+typedef struct {
+    uint8_t nivel;          // nivelesFlujo
+    uint16_t periodo_ms;    // Periodo minimo entre mensajes de un mismo canal (0 en FLUJO_NORMAL)
+} PACKED PARAM_MENSAJE_CONTROL_FLUJO;
+
+//Sincronizacion de relojes (al estilo NTP): el PC envia el mensaje con t1 (su reloj) y el microcontrolador
+//responde con el mismo mensaje rellenando t2 (instante de recepcion) y t3 (instante de envio) con el suyo.
+//Todos los tiempos en microsegundos
+typedef struct {
+    uint32_t secuencia;
+    uint64_t t1;
+    uint64_t t2;
+    uint64_t t3;
+} PACKED PARAM_MENSAJE_SINCRONIZACION;
+
+//Codificacion de la telemetria: el PC pide la que quiere y el microcontrolador responde con el mismo mensaje
+//indicando la que ha aplicado. Con CODIFICACION_COMPACTA se envian los MENSAJE_*_COMPACTO en lugar de los
+//normales (ver empaquetado.h)
+typedef enum {
+    CODIFICACION_NORMAL,
+    CODIFICACION_COMPACTA,
+} codificaciones;
+
+typedef struct {
+    uint8_t codificacion;   // codificaciones
+} PACKED PARAM_MENSAJE_CODIFICACION;
+
+typedef struct {
+    uint8_t angulos[5];     // roll, pitch y yaw a 12 bits (empaquetar_angulos)
+} PACKED PARAM_MENSAJE_POTENCIOMETRO_COMPACTO;
+
+typedef struct {
+    int16_t velocidad;      // En unidades de ESCALA_VELOCIDAD_COMPACTA
+} PACKED PARAM_MENSAJE_VELOCIDAD_COMPACTO;
+
+typedef struct {
+    int16_t combustible;    // En unidades de ESCALA_COMBUSTIBLE_COMPACTO
+} PACKED PARAM_MENSAJE_COMBUSTIBLE_COMPACTO;
+
+typedef struct {
+    uint16_t altura;        // En unidades de ESCALA_ALTURA_COMPACTA
+} PACKED PARAM_MENSAJE_ALTURA_COMPACTO;
+
+//Suscripcion a los canales de telemetria: el PC indica el periodo minimo entre mensajes de cada canal (o que no
+//lo quiere) y el microcontrolador responde con el mismo mensaje indicando los periodos que aplica. Sin suscripcion
+//se envian todos los canales a su tasa normal. Los eventos (colision) no son canales: se envian siempre. Si ademas
+//hay control de flujo, cada canal va al mas lento de los dos periodos
+typedef enum {
+    SUSCRIPCION_ACTITUD,        // MENSAJE_POTENCIOMETRO
+    SUSCRIPCION_VELOCIDAD,      // MENSAJE_VELOCIDAD
+    SUSCRIPCION_RELOJ,          // MENSAJE_RELOJ
+    SUSCRIPCION_COMBUSTIBLE,    // MENSAJE_COMBUSTIBLE
+    SUSCRIPCION_ALTURA,         // MENSAJE_ALTURA
+    SUSCRIPCION_RADIO,          // MENSAJE_MSG_RADIO
+    NUM_CANALES_SUSCRIPCION,
+} canalesSuscripcion;
+
+#define PERIODO_TASA_NORMAL 0       // El canal se envia a su tasa de siempre
+#define PERIODO_DESACTIVADO 0xFFFF  // El canal no se envia
+
+typedef struct {
+    uint16_t periodo_ms[NUM_CANALES_SUSCRIPCION];   // Indexado por canalesSuscripcion
+} PACKED PARAM_MENSAJE_SUSCRIPCION;
+
+//Pruebas de rendimiento del enlace (ver pruebaenlace.h): el PC envia tramas de relleno tan rapido como puede. El
+//microcontrolador devuelve tal cual las de MENSAJE_PRUEBA_ECO, cuenta y descarta las de MENSAJE_PRUEBA_SUMIDERO, y
+//responde a MENSAJE_PRUEBA_RESUMEN (que el PC envia sin parametro) con sus contadores de las de sumidero
+#define MAX_CARGA_PRUEBA 24     // La cabecera y la carga caben en MAX_DATA_SIZE
+
+typedef struct {
+    uint32_t secuencia;
+    uint32_t t_envio;                   // 32 bits bajos del reloj del PC (us)
+    uint8_t carga[MAX_CARGA_PRUEBA];    // De 0 a MAX_CARGA_PRUEBA bytes: el tamaño del parametro es variable
+} PACKED PARAM_MENSAJE_PRUEBA;
+
+typedef struct {
+    uint32_t tramas;        // Tramas de sumidero recibidas desde el arranque
+    uint32_t bytes;         // Bytes de parametro de esas tramas
+    uint32_t errores;       // Tramas descartadas por el CRC
+    uint32_t secuencia;     // Numero de la ultima recibida
+} PACKED PARAM_MENSAJE_PRUEBA_RESUMEN;
+
+//Marca de tiempo opcional: cualquier mensaje puede llevar detras de su parametro los 32 bits bajos del reloj
+//del microcontrolador en microsegundos (el parametro tiene entonces 4 bytes mas de lo normal)
+typedef struct {
+    uint32_t t;
+} PACKED MARCA_TIEMPO_DISPOSITIVO;
+
 #pragma pack()    //...Pero solo para los mensajes que voy a intercambiar, no para el resto
 
 
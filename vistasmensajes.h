@@ -0,0 +1,371 @@
+// Vistas tipadas sobre el parametro de los mensajes, leidas directamente de la trama ya sin stuffing.
+// Sustituyen a la copia con check_and_extract_message_param() a una estructura empaquetada (#pragma pack(1)):
+// cada campo se lee en su sitio, con una carga no alineada segura (memcpy a un entero del mismo tamaño, que el
+// compilador convierte en una sola instruccion) y en little endian, que es el orden de bytes de la TIVA.
+//
+// La disposicion de cada vista se comprueba en tiempo de compilacion contra las estructuras de
+// usb_messages_table.h (que siguen siendo el contrato con el microcontrolador): mismo tamaño, mismos
+// desplazamientos y mismos tipos de campo.
+
+#ifndef VISTASMENSAJES_H
+#define VISTASMENSAJES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <limits>
+#include <type_traits>
+
+#include "usb_messages_table.h"
+#include "empaquetado.h"
+
+namespace vistas {
+
+template <size_t Tam> struct EnteroDeTam;
+template <> struct EnteroDeTam<1> { typedef uint8_t tipo; };
+template <> struct EnteroDeTam<2> { typedef uint16_t tipo; };
+template <> struct EnteroDeTam<4> { typedef uint32_t tipo; };
+template <> struct EnteroDeTam<8> { typedef uint64_t tipo; };
+
+template <typename E>
+inline E invertir_bytes(E v)
+{
+    E r=0;
+    for (size_t i=0;i<sizeof(E);i++)
+    {
+        r=(E)((r<<8)|(v&0xFF));
+        v=(E)(v>>8);
+    }
+    return r;
+}
+
+// Lectura de un valor little endian en una direccion cualquiera (equivalente a std::bit_cast de los bytes)
+template <typename T>
+inline T leer_le(const uint8_t *p)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Solo se pueden leer tipos triviales");
+    typedef typename EnteroDeTam<sizeof(T)>::tipo Entero;
+
+    Entero bits;
+    memcpy(&bits,p,sizeof(bits));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__==__ORDER_BIG_ENDIAN__)
+    bits=invertir_bytes(bits);
+#endif
+    T valor;
+    memcpy(&valor,&bits,sizeof(valor));
+    return valor;
+}
+
+// Escritura de un valor little endian en una direccion cualquiera (la usa la expansion de los mensajes compactos)
+template <typename T>
+inline void escribir_le(uint8_t *p, T valor)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Solo se pueden escribir tipos triviales");
+    typedef typename EnteroDeTam<sizeof(T)>::tipo Entero;
+
+    Entero bits;
+    memcpy(&bits,&valor,sizeof(bits));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__==__ORDER_BIG_ENDIAN__)
+    bits=invertir_bytes(bits);
+#endif
+    memcpy(p,&bits,sizeof(bits));
+}
+
+// Campo de tipo T en el desplazamiento D del parametro
+template <typename T, size_t D>
+struct Campo {
+    typedef T tipo;
+    static constexpr size_t desplazamiento=D;
+    static constexpr size_t fin=D+sizeof(T);
+    static T leer(const uint8_t *p) { return leer_le<T>(p+D); }
+    static void escribir(uint8_t *p, T valor) { escribir_le<T>(p+D,valor); }
+};
+
+// Los float viajan como IEEE-754 de 32 bits
+static_assert(std::numeric_limits<float>::is_iec559 && sizeof(float)==4, "Se necesita float IEEE-754 de 32 bits");
+
+} // namespace vistas
+
+// Comprueba que un campo de la vista coincide con el de la estructura empaquetada
+#define VISTA_COMPRUEBA_CAMPO(Vista, Campo, Estructura, miembro) \
+    static_assert(Vista::Campo::desplazamiento==offsetof(Estructura, miembro), #Vista "::" #Campo ": desplazamiento distinto"); \
+    static_assert(std::is_same<Vista::Campo::tipo, decltype(Estructura::miembro)>::value, #Vista "::" #Campo ": tipo distinto")
+
+#define VISTA_COMPRUEBA_TAM(Vista, Estructura) \
+    static_assert(Vista::TAM==sizeof(Estructura), #Vista ": tamaño distinto de " #Estructura)
+
+struct VistaNoImplementado {
+    typedef vistas::Campo<uint8_t, 0> Mensaje;
+    static constexpr uint8_t TIPO=MENSAJE_NO_IMPLEMENTADO;
+    static constexpr int32_t TAM=Mensaje::fin;
+
+    explicit VistaNoImplementado(const uint8_t *p) : p(p) {}
+    uint8_t mensaje() const { return Mensaje::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaNoImplementado, PARAM_MENSAJE_NO_IMPLEMENTADO);
+VISTA_COMPRUEBA_CAMPO(VistaNoImplementado, Mensaje, PARAM_MENSAJE_NO_IMPLEMENTADO, message);
+
+struct VistaPotenciometro {
+    typedef vistas::Campo<uint16_t, 0> Roll;
+    typedef vistas::Campo<uint16_t, 2> Pitch;
+    typedef vistas::Campo<uint16_t, 4> Yaw;
+    static constexpr uint8_t TIPO=MENSAJE_POTENCIOMETRO;
+    static constexpr int32_t TAM=Yaw::fin;
+
+    explicit VistaPotenciometro(const uint8_t *p) : p(p) {}
+    uint16_t roll() const { return Roll::leer(p); }
+    uint16_t pitch() const { return Pitch::leer(p); }
+    uint16_t yaw() const { return Yaw::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaPotenciometro, PARAM_MENSAJE_POTENCIOMETRO);
+VISTA_COMPRUEBA_CAMPO(VistaPotenciometro, Roll, PARAM_MENSAJE_POTENCIOMETRO, roll);
+VISTA_COMPRUEBA_CAMPO(VistaPotenciometro, Pitch, PARAM_MENSAJE_POTENCIOMETRO, pitch);
+VISTA_COMPRUEBA_CAMPO(VistaPotenciometro, Yaw, PARAM_MENSAJE_POTENCIOMETRO, yaw);
+
+struct VistaVelocidad {
+    typedef vistas::Campo<float, 0> Intensidad;
+    static constexpr uint8_t TIPO=MENSAJE_VELOCIDAD;
+    static constexpr int32_t TAM=Intensidad::fin;
+
+    explicit VistaVelocidad(const uint8_t *p) : p(p) {}
+    float velocidad() const { return Intensidad::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaVelocidad, PARAM_MENSAJE_VELOCIDAD);
+VISTA_COMPRUEBA_CAMPO(VistaVelocidad, Intensidad, PARAM_MENSAJE_VELOCIDAD, bIntensity);
+
+struct VistaReloj {
+    typedef vistas::Campo<uint32_t, 0> Reloj;
+    static constexpr uint8_t TIPO=MENSAJE_RELOJ;
+    static constexpr int32_t TAM=Reloj::fin;
+
+    explicit VistaReloj(const uint8_t *p) : p(p) {}
+    uint32_t reloj() const { return Reloj::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaReloj, PARAM_MENSAJE_RELOJ);
+VISTA_COMPRUEBA_CAMPO(VistaReloj, Reloj, PARAM_MENSAJE_RELOJ, reloj);
+
+struct VistaCombustible {
+    typedef vistas::Campo<float, 0> Combustible;
+    static constexpr uint8_t TIPO=MENSAJE_COMBUSTIBLE;
+    static constexpr int32_t TAM=Combustible::fin;
+
+    explicit VistaCombustible(const uint8_t *p) : p(p) {}
+    float combustible() const { return Combustible::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaCombustible, PARAM_MENSAJE_COMBUSTIBLE);
+VISTA_COMPRUEBA_CAMPO(VistaCombustible, Combustible, PARAM_MENSAJE_COMBUSTIBLE, combustible);
+
+struct VistaAltura {
+    typedef vistas::Campo<float, 0> Altura;
+    static constexpr uint8_t TIPO=MENSAJE_ALTURA;
+    static constexpr int32_t TAM=Altura::fin;
+
+    explicit VistaAltura(const uint8_t *p) : p(p) {}
+    float altura() const { return Altura::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaAltura, PARAM_MENSAJE_ALTURA);
+VISTA_COMPRUEBA_CAMPO(VistaAltura, Altura, PARAM_MENSAJE_ALTURA, altura);
+
+// El texto de radio ocupa 40 bytes y no tiene por que llevar terminador
+struct VistaRadio {
+    static constexpr size_t MAX_CARACTERES=sizeof(((PARAM_MENSAJE_MSG_RADIO *)0)->caracteres);
+    static constexpr uint8_t TIPO=MENSAJE_MSG_RADIO;
+    static constexpr int32_t TAM=(int32_t)MAX_CARACTERES;
+
+    explicit VistaRadio(const uint8_t *p) : p(p) {}
+    const char *texto() const { return (const char *)p; }
+    size_t longitud() const
+    {
+        const void *fin=memchr(p,'\0',MAX_CARACTERES);
+        return fin ? (size_t)((const uint8_t *)fin-p) : MAX_CARACTERES;
+    }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaRadio, PARAM_MENSAJE_MSG_RADIO);
+static_assert(offsetof(PARAM_MENSAJE_MSG_RADIO, caracteres)==0, "VistaRadio: desplazamiento distinto");
+
+struct VistaControlFlujo {
+    typedef vistas::Campo<uint8_t, 0> Nivel;
+    typedef vistas::Campo<uint16_t, 1> Periodo;
+    static constexpr uint8_t TIPO=MENSAJE_CONTROL_FLUJO;
+    static constexpr int32_t TAM=Periodo::fin;
+
+    explicit VistaControlFlujo(const uint8_t *p) : p(p) {}
+    uint8_t nivel() const { return Nivel::leer(p); }
+    uint16_t periodo() const { return Periodo::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaControlFlujo, PARAM_MENSAJE_CONTROL_FLUJO);
+VISTA_COMPRUEBA_CAMPO(VistaControlFlujo, Nivel, PARAM_MENSAJE_CONTROL_FLUJO, nivel);
+VISTA_COMPRUEBA_CAMPO(VistaControlFlujo, Periodo, PARAM_MENSAJE_CONTROL_FLUJO, periodo_ms);
+
+struct VistaSincronizacion {
+    typedef vistas::Campo<uint32_t, 0> Secuencia;
+    typedef vistas::Campo<uint64_t, 4> T1;
+    typedef vistas::Campo<uint64_t, 12> T2;
+    typedef vistas::Campo<uint64_t, 20> T3;
+    static constexpr uint8_t TIPO=MENSAJE_SINCRONIZACION;
+    static constexpr int32_t TAM=T3::fin;
+
+    explicit VistaSincronizacion(const uint8_t *p) : p(p) {}
+    uint32_t secuencia() const { return Secuencia::leer(p); }
+    uint64_t t1() const { return T1::leer(p); }
+    uint64_t t2() const { return T2::leer(p); }
+    uint64_t t3() const { return T3::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaSincronizacion, PARAM_MENSAJE_SINCRONIZACION);
+VISTA_COMPRUEBA_CAMPO(VistaSincronizacion, Secuencia, PARAM_MENSAJE_SINCRONIZACION, secuencia);
+VISTA_COMPRUEBA_CAMPO(VistaSincronizacion, T1, PARAM_MENSAJE_SINCRONIZACION, t1);
+VISTA_COMPRUEBA_CAMPO(VistaSincronizacion, T2, PARAM_MENSAJE_SINCRONIZACION, t2);
+VISTA_COMPRUEBA_CAMPO(VistaSincronizacion, T3, PARAM_MENSAJE_SINCRONIZACION, t3);
+
+struct VistaCodificacion {
+    typedef vistas::Campo<uint8_t, 0> Codificacion;
+    static constexpr uint8_t TIPO=MENSAJE_CODIFICACION;
+    static constexpr int32_t TAM=Codificacion::fin;
+
+    explicit VistaCodificacion(const uint8_t *p) : p(p) {}
+    uint8_t codificacion() const { return Codificacion::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaCodificacion, PARAM_MENSAJE_CODIFICACION);
+VISTA_COMPRUEBA_CAMPO(VistaCodificacion, Codificacion, PARAM_MENSAJE_CODIFICACION, codificacion);
+
+struct VistaSuscripcion {
+    static constexpr uint8_t TIPO=MENSAJE_SUSCRIPCION;
+    static constexpr int32_t TAM=(int32_t)(NUM_CANALES_SUSCRIPCION*sizeof(uint16_t));
+
+    explicit VistaSuscripcion(const uint8_t *p) : p(p) {}
+    uint16_t periodo(int canal) const { return vistas::leer_le<uint16_t>(p+canal*sizeof(uint16_t)); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaSuscripcion, PARAM_MENSAJE_SUSCRIPCION);
+static_assert(offsetof(PARAM_MENSAJE_SUSCRIPCION, periodo_ms)==0, "VistaSuscripcion: desplazamiento distinto");
+
+// Tramas de las pruebas del enlace. Solo la cabecera tiene tamaño fijo: la carga va detras y ocupa el resto del
+// parametro (de 0 a MAX_CARGA_PRUEBA bytes)
+struct VistaPrueba {
+    typedef vistas::Campo<uint32_t, 0> Secuencia;
+    typedef vistas::Campo<uint32_t, 4> Envio;
+    static constexpr int32_t TAM=Envio::fin;
+    static constexpr int32_t MAX_CARGA=MAX_CARGA_PRUEBA;
+
+    explicit VistaPrueba(const uint8_t *p) : p(p) {}
+    uint32_t secuencia() const { return Secuencia::leer(p); }
+    uint32_t envio() const { return Envio::leer(p); }
+    const uint8_t *carga() const { return p+TAM; }
+
+    const uint8_t *p;
+};
+static_assert(sizeof(PARAM_MENSAJE_PRUEBA)==VistaPrueba::TAM+VistaPrueba::MAX_CARGA, "VistaPrueba: tamaño distinto de PARAM_MENSAJE_PRUEBA");
+VISTA_COMPRUEBA_CAMPO(VistaPrueba, Secuencia, PARAM_MENSAJE_PRUEBA, secuencia);
+VISTA_COMPRUEBA_CAMPO(VistaPrueba, Envio, PARAM_MENSAJE_PRUEBA, t_envio);
+static_assert(offsetof(PARAM_MENSAJE_PRUEBA, carga)==VistaPrueba::TAM, "VistaPrueba: desplazamiento distinto");
+
+struct VistaPruebaResumen {
+    typedef vistas::Campo<uint32_t, 0> Tramas;
+    typedef vistas::Campo<uint32_t, 4> Bytes;
+    typedef vistas::Campo<uint32_t, 8> Errores;
+    typedef vistas::Campo<uint32_t, 12> Secuencia;
+    static constexpr uint8_t TIPO=MENSAJE_PRUEBA_RESUMEN;
+    static constexpr int32_t TAM=Secuencia::fin;
+
+    explicit VistaPruebaResumen(const uint8_t *p) : p(p) {}
+    uint32_t tramas() const { return Tramas::leer(p); }
+    uint32_t bytes() const { return Bytes::leer(p); }
+    uint32_t errores() const { return Errores::leer(p); }
+    uint32_t secuencia() const { return Secuencia::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaPruebaResumen, PARAM_MENSAJE_PRUEBA_RESUMEN);
+VISTA_COMPRUEBA_CAMPO(VistaPruebaResumen, Tramas, PARAM_MENSAJE_PRUEBA_RESUMEN, tramas);
+VISTA_COMPRUEBA_CAMPO(VistaPruebaResumen, Bytes, PARAM_MENSAJE_PRUEBA_RESUMEN, bytes);
+VISTA_COMPRUEBA_CAMPO(VistaPruebaResumen, Errores, PARAM_MENSAJE_PRUEBA_RESUMEN, errores);
+VISTA_COMPRUEBA_CAMPO(VistaPruebaResumen, Secuencia, PARAM_MENSAJE_PRUEBA_RESUMEN, secuencia);
+
+// Mensajes compactos (empaquetado.h). El decodificador los convierte en los normales antes de entregarlos, asi
+// que estas vistas solo las usa el propio decodificador
+struct VistaPotenciometroCompacto {
+    static constexpr uint8_t TIPO=MENSAJE_POTENCIOMETRO_COMPACTO;
+    static constexpr int32_t TAM=TAM_ANGULOS_COMPACTOS;
+
+    explicit VistaPotenciometroCompacto(const uint8_t *p) : p(p) {}
+    void angulos(uint16_t &roll, uint16_t &pitch, uint16_t &yaw) const { desempaquetar_angulos(p,&roll,&pitch,&yaw); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaPotenciometroCompacto, PARAM_MENSAJE_POTENCIOMETRO_COMPACTO);
+
+struct VistaVelocidadCompacto {
+    typedef vistas::Campo<int16_t, 0> Velocidad;
+    static constexpr uint8_t TIPO=MENSAJE_VELOCIDAD_COMPACTO;
+    static constexpr int32_t TAM=Velocidad::fin;
+
+    explicit VistaVelocidadCompacto(const uint8_t *p) : p(p) {}
+    float velocidad() const { return desde_fijo(Velocidad::leer(p),ESCALA_VELOCIDAD_COMPACTA); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaVelocidadCompacto, PARAM_MENSAJE_VELOCIDAD_COMPACTO);
+VISTA_COMPRUEBA_CAMPO(VistaVelocidadCompacto, Velocidad, PARAM_MENSAJE_VELOCIDAD_COMPACTO, velocidad);
+
+struct VistaCombustibleCompacto {
+    typedef vistas::Campo<int16_t, 0> Combustible;
+    static constexpr uint8_t TIPO=MENSAJE_COMBUSTIBLE_COMPACTO;
+    static constexpr int32_t TAM=Combustible::fin;
+
+    explicit VistaCombustibleCompacto(const uint8_t *p) : p(p) {}
+    float combustible() const { return desde_fijo(Combustible::leer(p),ESCALA_COMBUSTIBLE_COMPACTO); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaCombustibleCompacto, PARAM_MENSAJE_COMBUSTIBLE_COMPACTO);
+VISTA_COMPRUEBA_CAMPO(VistaCombustibleCompacto, Combustible, PARAM_MENSAJE_COMBUSTIBLE_COMPACTO, combustible);
+
+struct VistaAlturaCompacto {
+    typedef vistas::Campo<uint16_t, 0> Altura;
+    static constexpr uint8_t TIPO=MENSAJE_ALTURA_COMPACTO;
+    static constexpr int32_t TAM=Altura::fin;
+
+    explicit VistaAlturaCompacto(const uint8_t *p) : p(p) {}
+    float altura() const { return desde_fijo(Altura::leer(p),ESCALA_ALTURA_COMPACTA); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaAlturaCompacto, PARAM_MENSAJE_ALTURA_COMPACTO);
+VISTA_COMPRUEBA_CAMPO(VistaAlturaCompacto, Altura, PARAM_MENSAJE_ALTURA_COMPACTO, altura);
+
+// Marca de tiempo que puede ir detras de cualquier parametro
+struct VistaMarcaTiempo {
+    typedef vistas::Campo<uint32_t, 0> T;
+    static constexpr int32_t TAM=T::fin;
+
+    explicit VistaMarcaTiempo(const uint8_t *p) : p(p) {}
+    uint32_t t() const { return T::leer(p); }
+
+    const uint8_t *p;
+};
+VISTA_COMPRUEBA_TAM(VistaMarcaTiempo, MARCA_TIEMPO_DISPOSITIVO);
+VISTA_COMPRUEBA_CAMPO(VistaMarcaTiempo, T, MARCA_TIEMPO_DISPOSITIVO, t);
+
+#endif // VISTASMENSAJES_H